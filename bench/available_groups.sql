@@ -0,0 +1,40 @@
+-- Benchmark cho LIST_AVAILABLE_GROUPS (db_get_available_groups).
+-- Chạy trên một CSDL trống đã nạp database.sql, KHÔNG chạy trên CSDL thật:
+--   createdb bench_groups
+--   psql -d bench_groups -f database.sql
+--   psql -d bench_groups -f bench/available_groups.sql
+-- Bảng groups được tăng dần lên 10k, 100k và 1M dòng; ở mỗi mức script in
+-- EXPLAIN ANALYZE của trang đầu và một trang giữa danh sách. Thời gian và số
+-- buffer phải gần như không đổi giữa các mức, vì truy vấn đi theo
+-- idx_groups_created và dừng sau limit + 1 dòng.
+\set ON_ERROR_STOP on
+
+-- 1000 user; user 1 là người đang tìm nhóm
+INSERT INTO users (username, password_hash)
+SELECT 'bench_user_' || i, 'x' FROM generate_series(1, 1000) AS i;
+
+-- Giống hệt STMT_GET_AVAILABLE_GROUPS trong server/db_statements.h
+PREPARE available_groups(int, bigint, int, int) AS
+SELECT g.group_id, g.group_name, g.description, g.created_at, g.member_count
+FROM groups g
+WHERE (g.created_at, g.group_id) < (TIMESTAMP '2000-01-01' + $2 * INTERVAL '1 microsecond', $3)
+AND NOT EXISTS (SELECT 1 FROM group_members gm
+    WHERE gm.group_id = g.group_id AND gm.user_id = $1 AND gm.status IN ('approved', 'pending'))
+AND NOT EXISTS (SELECT 1 FROM join_requests jr
+    WHERE jr.user_id = $1 AND jr.status = 'pending' AND jr.group_id = g.group_id)
+AND NOT EXISTS (SELECT 1 FROM group_invitations gi
+    WHERE gi.invitee_id = $1 AND gi.status = 'pending' AND gi.group_id = g.group_id)
+ORDER BY g.created_at DESC, g.group_id DESC
+LIMIT $4;
+
+\set from 1
+\set to 10000
+\ir available_groups_step.sql
+
+\set from 10001
+\set to 100000
+\ir available_groups_step.sql
+
+\set from 100001
+\set to 1000000
+\ir available_groups_step.sql
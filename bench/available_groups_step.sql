@@ -0,0 +1,38 @@
+-- Một mức của bench/available_groups.sql: thêm các nhóm :from..:to rồi đo.
+-- Nhóm mới hơn có created_at lớn hơn. User 1 là thành viên của 5% số nhóm,
+-- có yêu cầu chờ duyệt ở 3% và lời mời chờ trả lời ở 2%, rải đều từ mới đến cũ.
+INSERT INTO groups (group_name, description, owner_id, created_at)
+SELECT 'bench_group_' || i, 'benchmark group', 2 + i % 999,
+       TIMESTAMP '2020-01-01' + i * INTERVAL '1 second'
+FROM generate_series(:from, :to) AS i;
+
+INSERT INTO group_members (group_id, user_id, role, status)
+SELECT group_id, 1, 'member', 'approved' FROM groups
+WHERE group_id BETWEEN :from AND :to AND group_id % 20 = 0;
+
+INSERT INTO join_requests (group_id, user_id, status)
+SELECT group_id, 1, 'pending' FROM groups
+WHERE group_id BETWEEN :from AND :to AND group_id % 100 IN (1, 2, 3);
+
+INSERT INTO group_invitations (group_id, inviter_id, invitee_id, status)
+SELECT group_id, owner_id, 1, 'pending' FROM groups
+WHERE group_id BETWEEN :from AND :to AND group_id % 50 = 7;
+
+ANALYZE groups;
+ANALYZE group_members;
+ANALYZE join_requests;
+ANALYZE group_invitations;
+
+SELECT COUNT(*) AS groups_total FROM groups \gset
+\echo '== groups:' :groups_total
+
+-- Trang đầu (không có cursor)
+EXPLAIN (ANALYZE, BUFFERS, COSTS OFF)
+EXECUTE available_groups(1, 9000000000000000, 2147483647, 51);
+
+-- Một trang ở giữa danh sách, cursor lấy từ nhóm giữa
+SELECT (EXTRACT(EPOCH FROM created_at - TIMESTAMP '2000-01-01') * 1000000)::bigint AS mid_us,
+       group_id AS mid_id
+FROM groups ORDER BY group_id OFFSET (:groups_total / 2) LIMIT 1 \gset
+EXPLAIN (ANALYZE, BUFFERS, COSTS OFF)
+EXECUTE available_groups(1, :mid_us, :mid_id, 51);
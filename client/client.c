@@ -3,14 +3,21 @@
 #include <string.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <sys/select.h>
 #include <json-c/json.h>
 #include "../common/protocol.h"
+#include "../common/json_utils.h"
+#include "../common/commands.h"
 
 // Global session storage
 char g_session_token[MAX_TOKEN] = "";
 int g_user_id = 0;
 char g_username[MAX_USERNAME] = "";
 
+// Reassembly buffer for server responses, grown to fit the largest one seen
+static char *g_response_buf = NULL;
+static size_t g_response_cap = 0;
+
 void clear_screen() {
     printf("\033[2J\033[H");
 }
@@ -46,6 +53,7 @@ void display_notification(struct json_object *notif_obj) {
     const char *message = json_object_get_string(message_obj);
     int is_read = json_object_get_boolean(is_read_obj);
     const char *created_at = json_object_get_string(created_at_obj);
+    if (!type) type = "";
     
     // Icon based on type
     const char *icon = "📬";
@@ -55,12 +63,18 @@ void display_notification(struct json_object *notif_obj) {
     else if (strcmp(type, "INVITATION_ACCEPTED") == 0) icon = "🎉";
     else if (strcmp(type, "MEMBER_LEFT") == 0) icon = "👋";
     else if (strcmp(type, "REMOVED_FROM_GROUP") == 0) icon = "🚫";
+    else if (strcmp(type, "MEMBER_JOINED") == 0) icon = "👥";
+    
+    // Group-wide notifications have their own ids
+    struct json_object *scope_obj;
+    int group_scope = json_object_object_get_ex(notif_obj, "scope", &scope_obj) &&
+                      strcmp(json_object_get_string(scope_obj), "group") == 0;
     
     // Status indicator
     const char *status_mark = is_read ? "  " : "🔴";
     
     printf("┌─────────────────────────────────────────────────────────┐\n");
-    printf("│ %s %s [ID:%d] %s\n", status_mark, icon, id, is_read ? "" : "NEW");
+    printf("│ %s %s [%sID:%d] %s\n", status_mark, icon, group_scope ? "GROUP " : "", id, is_read ? "" : "NEW");
     printf("├─────────────────────────────────────────────────────────┤\n");
     printf("│ 📌 %s\n", title);
     printf("│ 💬 %s\n", message);
@@ -389,6 +403,46 @@ void parse_and_display_response(const char *json_str) {
                    strcmp(code, "SUCCESS_UPDATE_PERMISSIONS") == 0) {
             printf("\n✓ Permissions operation completed!\n");
             printf("  Details: %s\n", json_object_to_json_string_ext(payload_obj, JSON_C_TO_STRING_PRETTY));
+        } else if (strcmp(code, "SUCCESS_SEARCH_GROUPS") == 0) {
+            struct json_object *groups_obj;
+            json_object_object_get_ex(payload_obj, "groups", &groups_obj);
+            int count = json_object_array_length(groups_obj);
+            
+            printf("\n🔍 Matching Groups (%d):\n", count);
+            if (count == 0) {
+                printf("  📭 No groups match this keyword.\n");
+            }
+            for (int i = 0; i < count; i++) {
+                struct json_object *group = json_object_array_get_idx(groups_obj, i);
+                struct json_object *id, *name, *desc, *owner;
+                json_object_object_get_ex(group, "group_id", &id);
+                json_object_object_get_ex(group, "group_name", &name);
+                json_object_object_get_ex(group, "description", &desc);
+                json_object_object_get_ex(group, "owner_name", &owner);
+                
+                printf("\n  [ID:%d] %s (owner: %s)\n", json_object_get_int(id),
+                       json_object_get_string(name), json_object_get_string(owner));
+                printf("      %s\n", json_object_get_string(desc));
+            }
+        } else if (strcmp(code, "SUCCESS_SEARCH_USERS") == 0) {
+            struct json_object *users_obj;
+            json_object_object_get_ex(payload_obj, "users", &users_obj);
+            int count = json_object_array_length(users_obj);
+            
+            printf("\n🔍 Matching Users (%d):\n", count);
+            if (count == 0) {
+                printf("  📭 No users match this prefix.\n");
+            }
+            for (int i = 0; i < count; i++) {
+                struct json_object *found = json_object_array_get_idx(users_obj, i);
+                struct json_object *id, *username, *full_name;
+                json_object_object_get_ex(found, "user_id", &id);
+                json_object_object_get_ex(found, "username", &username);
+                json_object_object_get_ex(found, "full_name", &full_name);
+                
+                printf("  [ID:%d] %s - %s\n", json_object_get_int(id),
+                       json_object_get_string(username), json_object_get_string(full_name));
+            }
         } else if (strcmp(code, "SUCCESS_LIST_AVAILABLE_GROUPS") == 0) {
             struct json_object *groups_obj, *total_count_obj;
             json_object_object_get_ex(payload_obj, "groups", &groups_obj);
@@ -437,6 +491,40 @@ int connect_to_server() {
     return sock;
 }
 
+// Shows a pushed notification frame ({"event": "NOTIFICATION", ...}).
+// Returns 0 if json_str is an ordinary response instead.
+static int display_push(const char *json_str) {
+    struct json_object *frame = json_tokener_parse(json_str);
+    struct json_object *event_obj, *payload_obj;
+    int is_push = frame && json_object_object_get_ex(frame, "event", &event_obj);
+    
+    if (is_push && json_object_object_get_ex(frame, "payload", &payload_obj)) {
+        printf("\n🔔 New notification\n");
+        display_notification(payload_obj);
+    }
+    if (frame) json_object_put(frame);
+    return is_push;
+}
+
+static void receive_frame_or_exit(int sock) {
+    if (recv_frame(sock, &g_response_buf, &g_response_cap) < 0) {
+        print_error("Lost connection to server");
+        close(sock);
+        exit(1);
+    }
+}
+
+// Blocks until a complete response frame has arrived, showing any pushed
+// notifications that come first. The returned string is only valid until
+// the next call.
+const char *receive_response(int sock) {
+    receive_frame_or_exit(sock);
+    while (display_push(g_response_buf)) {
+        receive_frame_or_exit(sock);
+    }
+    return g_response_buf;
+}
+
 void send_register_request(int sock) {
     char username[MAX_USERNAME], password[MAX_PASSWORD];
     char email[MAX_EMAIL], full_name[MAX_FULLNAME];
@@ -465,14 +553,12 @@ void send_register_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -497,14 +583,12 @@ void send_login_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -528,14 +612,12 @@ void send_logout_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     
@@ -565,14 +647,12 @@ void send_verify_session_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -607,14 +687,12 @@ void send_update_profile_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -647,14 +725,12 @@ void send_change_password_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -684,14 +760,12 @@ void send_get_permissions_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -737,14 +811,12 @@ void send_update_permissions_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -780,14 +852,12 @@ void send_create_group_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -811,19 +881,137 @@ void send_list_my_groups_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
 }
 
+void send_search_groups_request(int sock) {
+    clear_screen();
+    printf("\n=== SEARCH GROUPS ===\n");
+    
+    if (strlen(g_session_token) == 0) {
+        print_error("Please login first!");
+        wait_for_enter();
+        return;
+    }
+    
+    char keyword[101];
+    printf("Keyword: ");
+    getchar(); // consume newline
+    fgets(keyword, sizeof(keyword), stdin);
+    keyword[strcspn(keyword, "\n")] = 0;
+    
+    // Page through results while the server says there are more
+    char cursor[32] = "";
+    while (1) {
+        struct json_object *request = json_object_new_object();
+        json_object_object_add(request, "command", json_object_new_string("SEARCH_GROUPS"));
+        
+        struct json_object *data = json_object_new_object();
+        json_object_object_add(data, "session_token", json_object_new_string(g_session_token));
+        json_object_object_add(data, "keyword", json_object_new_string(keyword));
+        if (cursor[0]) {
+            json_object_object_add(data, "after", json_object_new_string(cursor));
+        }
+        json_object_object_add(request, "data", data);
+        
+        const char *json_str = json_object_to_json_string(request);
+        send_frame(sock, json_str, strlen(json_str));
+        json_object_put(request);
+        
+        const char *buffer = receive_response(sock);
+        parse_and_display_response(buffer);
+        
+        int has_more = 0;
+        struct json_object *response = json_tokener_parse(buffer);
+        struct json_object *payload_obj, *more_obj, *next_obj;
+        if (response && json_object_object_get_ex(response, "payload", &payload_obj) &&
+            json_object_object_get_ex(payload_obj, "has_more", &more_obj) &&
+            json_object_get_boolean(more_obj) &&
+            json_object_object_get_ex(payload_obj, "next_cursor", &next_obj)) {
+            snprintf(cursor, sizeof(cursor), "%s", json_object_get_string(next_obj));
+            has_more = 1;
+        }
+        if (response) json_object_put(response);
+        
+        if (!has_more) break;
+        char answer[8];
+        printf("\nShow more results? (y/N): ");
+        fgets(answer, sizeof(answer), stdin);
+        if (answer[0] != 'y' && answer[0] != 'Y') break;
+    }
+    
+    printf("\nPress ENTER to continue...");
+    getchar();
+}
+
+void send_search_users_request(int sock) {
+    clear_screen();
+    printf("\n=== SEARCH USERS ===\n");
+    
+    if (strlen(g_session_token) == 0) {
+        print_error("Please login first!");
+        wait_for_enter();
+        return;
+    }
+    
+    char prefix[101];
+    printf("Username or name starts with: ");
+    getchar(); // consume newline
+    fgets(prefix, sizeof(prefix), stdin);
+    prefix[strcspn(prefix, "\n")] = 0;
+    
+    // Page through results while the server says there are more
+    char cursor[32] = "";
+    while (1) {
+        struct json_object *request = json_object_new_object();
+        json_object_object_add(request, "command", json_object_new_string("SEARCH_USERS"));
+        
+        struct json_object *data = json_object_new_object();
+        json_object_object_add(data, "session_token", json_object_new_string(g_session_token));
+        json_object_object_add(data, "prefix", json_object_new_string(prefix));
+        if (cursor[0]) {
+            json_object_object_add(data, "after", json_object_new_string(cursor));
+        }
+        json_object_object_add(request, "data", data);
+        
+        const char *json_str = json_object_to_json_string(request);
+        send_frame(sock, json_str, strlen(json_str));
+        json_object_put(request);
+        
+        const char *buffer = receive_response(sock);
+        parse_and_display_response(buffer);
+        
+        int has_more = 0;
+        struct json_object *response = json_tokener_parse(buffer);
+        struct json_object *payload_obj, *more_obj, *next_obj;
+        if (response && json_object_object_get_ex(response, "payload", &payload_obj) &&
+            json_object_object_get_ex(payload_obj, "has_more", &more_obj) &&
+            json_object_get_boolean(more_obj) &&
+            json_object_object_get_ex(payload_obj, "next_cursor", &next_obj)) {
+            snprintf(cursor, sizeof(cursor), "%s", json_object_get_string(next_obj));
+            has_more = 1;
+        }
+        if (response) json_object_put(response);
+        
+        if (!has_more) break;
+        char answer[8];
+        printf("\nShow more results? (y/N): ");
+        fgets(answer, sizeof(answer), stdin);
+        if (answer[0] != 'y' && answer[0] != 'Y') break;
+    }
+    
+    printf("\nPress ENTER to continue...");
+    getchar();
+}
+
 void send_list_group_members_request(int sock) {
     clear_screen();
     printf("\n=== LIST GROUP MEMBERS ===\n");
@@ -843,13 +1031,11 @@ void send_list_group_members_request(int sock) {
     json_object_object_add(list_req, "data", list_data);
     
     const char *list_json = json_object_to_json_string(list_req);
-    send(sock, list_json, strlen(list_json), 0);
+    send_frame(sock, list_json, strlen(list_json));
     json_object_put(list_req);
     
     // Nhận danh sách groups
-    char list_buffer[BUFFER_SIZE];
-    int list_bytes = recv(sock, list_buffer, BUFFER_SIZE - 1, 0);
-    list_buffer[list_bytes] = '\0';
+    const char *list_buffer = receive_response(sock);
     
     struct json_object *list_response = json_tokener_parse(list_buffer);
     if (!list_response) {
@@ -914,18 +1100,29 @@ void send_list_group_members_request(int sock) {
     struct json_object *member_data = json_object_new_object();
     json_object_object_add(member_data, "session_token", json_object_new_string(g_session_token));
     json_object_object_add(member_data, "group_id", json_object_new_int(selected_group_id));
+    json_object_object_add(member_data, "stream", json_object_new_boolean(1));
     json_object_object_add(member_req, "data", member_data);
     
     const char *member_json = json_object_to_json_string(member_req);
-    send(sock, member_json, strlen(member_json), 0);
+    send_frame(sock, member_json, strlen(member_json));
     json_object_put(member_req);
     
-    // Nhận danh sách members
-    char member_buffer[BUFFER_SIZE];
-    int member_bytes = recv(sock, member_buffer, BUFFER_SIZE - 1, 0);
-    member_buffer[member_bytes] = '\0';
-    
-    parse_and_display_response(member_buffer);
+    // Nhận danh sách members: server gửi nhiều frame, frame cuối có "done": true
+    int done = 0;
+    while (!done) {
+        const char *member_buffer = receive_response(sock);
+        parse_and_display_response(member_buffer);
+        
+        struct json_object *member_response = json_tokener_parse(member_buffer);
+        struct json_object *member_status, *member_payload, *done_obj;
+        done = !member_response ||
+               !json_object_object_get_ex(member_response, "status", &member_status) ||
+               json_object_get_int(member_status) != 200 ||
+               !json_object_object_get_ex(member_response, "payload", &member_payload) ||
+               !json_object_object_get_ex(member_payload, "done", &done_obj) ||
+               json_object_get_boolean(done_obj);
+        if (member_response) json_object_put(member_response);
+    }
     wait_for_enter();
 }
 
@@ -948,13 +1145,11 @@ void send_request_join_group_request(int sock) {
     json_object_object_add(list_req, "data", list_data);
     
     const char *list_json = json_object_to_json_string(list_req);
-    send(sock, list_json, strlen(list_json), 0);
+    send_frame(sock, list_json, strlen(list_json));
     json_object_put(list_req);
     
     // Nhận danh sách groups
-    char list_buffer[BUFFER_SIZE];
-    int list_bytes = recv(sock, list_buffer, BUFFER_SIZE - 1, 0);
-    list_buffer[list_bytes] = '\0';
+    const char *list_buffer = receive_response(sock);
     
     struct json_object *list_response = json_tokener_parse(list_buffer);
     if (!list_response) {
@@ -1033,13 +1228,11 @@ void send_request_join_group_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -1062,14 +1255,12 @@ void send_list_join_requests_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -1103,14 +1294,12 @@ void send_approve_join_request_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -1144,14 +1333,12 @@ void send_invite_to_group_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -1169,14 +1356,12 @@ void send_list_my_invitations_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -1210,14 +1395,12 @@ void send_respond_invitation_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -1247,14 +1430,12 @@ void send_leave_group_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -1287,14 +1468,12 @@ void send_remove_member_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
     // Receive response
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -1336,13 +1515,11 @@ void send_create_directory_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -1376,13 +1553,11 @@ void send_rename_directory_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -1417,13 +1592,11 @@ void send_delete_directory_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -1457,13 +1630,11 @@ void send_copy_directory_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -1497,13 +1668,11 @@ void send_move_directory_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     
     json_object_put(request);
     
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    buffer[bytes] = '\0';
+    const char *buffer = receive_response(sock);
     
     parse_and_display_response(buffer);
     wait_for_enter();
@@ -1511,6 +1680,8 @@ void send_move_directory_request(int sock) {
 
 void show_account_menu(int sock);
 void show_group_menu(int sock);
+void print_menu_entries(CommandMenu menu, int unread_count);
+int run_menu_entry(int sock, CommandMenu menu, int choice);
 
 int main() {
     int sock = connect_to_server();
@@ -1565,45 +1736,22 @@ void show_account_menu(int sock) {
         printf("║       👤 ACCOUNT MANAGEMENT           ║\n");
         printf("╚════════════════════════════════════════╝\n");
         
-        printf("\n1. 📝 Register New Account\n");
-        printf("2. 🔐 Login\n");
-        printf("3. 🚪 Logout\n");
-        // printf("4. ✓ Verify Session\n");
-        printf("5. ✏️  Update Profile\n");
-        printf("6. 🔑 Change Password\n");
-        printf("7. 🔙 Back to Main Menu\n");
+        printf("\n");
+        print_menu_entries(MENU_ACCOUNT, 0);
+        printf("0.  🔙 Back to Main Menu\n");
         printf("\nChoice: ");
         scanf("%d", &choice);
         
-        switch (choice) {
-            case 1:
-                send_register_request(sock);
-                break;
-            case 2:
-                send_login_request(sock);
-                break;
-            case 3:
-                send_logout_request(sock);
-                break;
-            case 4:
-                send_verify_session_request(sock);
-                break;
-            case 5:
-                send_update_profile_request(sock);
-                break;
-            case 6:
-                send_change_password_request(sock);
-                break;
-            case 7:
-                return;
-            default:
-                printf("\n✗ Invalid choice!\n");
-                wait_for_enter();
+        if (choice == 0) return;
+        if (!run_menu_entry(sock, MENU_ACCOUNT, choice)) {
+            printf("\n✗ Invalid choice!\n");
+            wait_for_enter();
         }
     }
 }
 
 
+
 void send_get_notifications_request(int sock) {
     if (strlen(g_session_token) == 0) {
         print_error("Please login first!");
@@ -1613,25 +1761,51 @@ void send_get_notifications_request(int sock) {
     
     print_separator();
     printf("=== GET NOTIFICATIONS ===\n");
-    printf("Session token: %s\n\n", g_session_token);
-    
-    struct json_object *request = json_object_new_object();
-    json_object_object_add(request, "command", json_object_new_string("GET_NOTIFICATIONS"));
-    
-    struct json_object *data = json_object_new_object();
-    json_object_object_add(data, "session_token", json_object_new_string(g_session_token));
-    json_object_object_add(request, "data", data);
+    printf("Session token: %s\n", g_session_token);
     
-    const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
-    json_object_put(request);
+    char answer[8];
+    printf("Unread only? (y/N): ");
+    fgets(answer, sizeof(answer), stdin);
+    int unread_only = answer[0] == 'y' || answer[0] == 'Y';
     
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    if (bytes > 0) {
-        buffer[bytes] = '\0';
+    // Page through older notifications while the server says there are more
+    char cursor[64] = "";
+    while (1) {
+        struct json_object *request = json_object_new_object();
+        json_object_object_add(request, "command", json_object_new_string("GET_NOTIFICATIONS"));
+        
+        struct json_object *data = json_object_new_object();
+        json_object_object_add(data, "session_token", json_object_new_string(g_session_token));
+        json_object_object_add(data, "unread_only", json_object_new_boolean(unread_only));
+        if (cursor[0]) {
+            json_object_object_add(data, "before", json_object_new_string(cursor));
+        }
+        json_object_object_add(request, "data", data);
+        
+        const char *json_str = json_object_to_json_string(request);
+        send_frame(sock, json_str, strlen(json_str));
+        json_object_put(request);
+        
+        const char *buffer = receive_response(sock);
         printf("\nResponse:\n");
         parse_and_display_response(buffer);
+        
+        int has_more = 0;
+        struct json_object *response = json_tokener_parse(buffer);
+        struct json_object *payload_obj, *more_obj, *next_obj;
+        if (response && json_object_object_get_ex(response, "payload", &payload_obj) &&
+            json_object_object_get_ex(payload_obj, "has_more", &more_obj) &&
+            json_object_get_boolean(more_obj) &&
+            json_object_object_get_ex(payload_obj, "next_cursor", &next_obj)) {
+            snprintf(cursor, sizeof(cursor), "%s", json_object_get_string(next_obj));
+            has_more = 1;
+        }
+        if (response) json_object_put(response);
+        
+        if (!has_more) break;
+        printf("\nLoad older notifications? (y/N): ");
+        fgets(answer, sizeof(answer), stdin);
+        if (answer[0] != 'y' && answer[0] != 'Y') break;
     }
     
     wait_for_enter();
@@ -1653,25 +1827,28 @@ void send_mark_notification_read_request(int sock) {
     scanf("%d", &notification_id);
     getchar();
     
+    char scope[8];
+    printf("Group notification? (y/N): ");
+    fgets(scope, sizeof(scope), stdin);
+    
     struct json_object *request = json_object_new_object();
     json_object_object_add(request, "command", json_object_new_string("MARK_NOTIFICATION_READ"));
     
     struct json_object *data = json_object_new_object();
     json_object_object_add(data, "session_token", json_object_new_string(g_session_token));
     json_object_object_add(data, "notification_id", json_object_new_int(notification_id));
+    if (scope[0] == 'y' || scope[0] == 'Y') {
+        json_object_object_add(data, "scope", json_object_new_string("group"));
+    }
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     json_object_put(request);
     
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    if (bytes > 0) {
-        buffer[bytes] = '\0';
-        printf("\nResponse:\n");
-        parse_and_display_response(buffer);
-    }
+    const char *buffer = receive_response(sock);
+    printf("\nResponse:\n");
+    parse_and_display_response(buffer);
     
     wait_for_enter();
 }
@@ -1695,16 +1872,12 @@ void send_get_unread_count_request(int sock) {
     json_object_object_add(request, "data", data);
     
     const char *json_str = json_object_to_json_string(request);
-    send(sock, json_str, strlen(json_str), 0);
+    send_frame(sock, json_str, strlen(json_str));
     json_object_put(request);
     
-    char buffer[BUFFER_SIZE];
-    int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-    if (bytes > 0) {
-        buffer[bytes] = '\0';
-        printf("\nResponse:\n");
-        parse_and_display_response(buffer);
-    }
+    const char *buffer = receive_response(sock);
+    printf("\nResponse:\n");
+    parse_and_display_response(buffer);
     
     wait_for_enter();
 }
@@ -1721,11 +1894,9 @@ void show_group_menu(int sock) {
         json_object_object_add(check_request, "data", check_data);
         
         const char *check_json = json_object_to_json_string(check_request);
-        send(sock, check_json, strlen(check_json), 0);
+        send_frame(sock, check_json, strlen(check_json));
         
-        char buffer[BUFFER_SIZE];
-        int bytes = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-        buffer[bytes] = '\0';
+        const char *buffer = receive_response(sock);
         
         int unread_count = 0;
         struct json_object *check_response = json_tokener_parse(buffer);
@@ -1748,20 +1919,7 @@ void show_group_menu(int sock) {
         }
         printf("\n");
         
-        printf("1.  Create Group\n");
-        printf("2.  List My Groups\n");
-        printf("3.  List Group Members\n");
-        printf("4.  Request Join Group\n");
-        printf("5.  List Join Requests (Admin)\n");
-        printf("6.  Approve/Reject Join Request (Admin)\n");
-        printf("7.  Invite to Group (Admin)\n");
-        printf("8.  List My Invitations\n");
-        printf("9.  Respond to Invitation\n");
-        printf("10. Leave Group\n");
-        printf("11. Remove Member (Admin)\n");
-        printf("12. 🔔 View All Notifications%s\n", unread_count > 0 ? " 🔴" : "");
-        printf("13. Mark Notification as Read\n");
-        printf("14. Mark All as Read\n");
+        print_menu_entries(MENU_GROUP, unread_count);
         printf("0.  Back to Main Menu\n");
         print_separator();
         
@@ -1770,45 +1928,148 @@ void show_group_menu(int sock) {
         scanf("%d", &choice);
         getchar();
         
-        switch (choice) {
-            case 1: send_create_group_request(sock); break;
-            case 2: send_list_my_groups_request(sock); break;
-            case 3: send_list_group_members_request(sock); break;
-            case 4: send_request_join_group_request(sock); break;
-            case 5: send_list_join_requests_request(sock); break;
-            case 6: send_approve_join_request_request(sock); break;
-            case 7: send_invite_to_group_request(sock); break;
-            case 8: send_list_my_invitations_request(sock); break;
-            case 9: send_respond_invitation_request(sock); break;
-            case 10: send_leave_group_request(sock); break;
-            case 11: send_remove_member_request(sock); break;
-            case 12: send_get_notifications_request(sock); break;
-            case 13: send_mark_notification_read_request(sock); break;
-            case 14: 
-                // Mark all as read
-                {
-                    struct json_object *mark_all = json_object_new_object();
-                    json_object_object_add(mark_all, "command", json_object_new_string("MARK_ALL_NOTIFICATIONS_READ"));
-                    struct json_object *mark_data = json_object_new_object();
-                    json_object_object_add(mark_data, "session_token", json_object_new_string(g_session_token));
-                    json_object_object_add(mark_all, "data", mark_data);
-                    
-                    const char *mark_json = json_object_to_json_string(mark_all);
-                    send(sock, mark_json, strlen(mark_json), 0);
-                    json_object_put(mark_all);
-                    
-                    char resp[BUFFER_SIZE];
-                    bytes = recv(sock, resp, BUFFER_SIZE - 1, 0);
-                    resp[bytes] = '\0';
-                    parse_and_display_response(resp);
-                    wait_for_enter();
-                }
-                break;
-            case 0: return;
-            default:
-                print_error("Invalid choice!");
-                wait_for_enter();
+        if (choice == 0) return;
+        if (!run_menu_entry(sock, MENU_GROUP, choice)) {
+            print_error("Invalid choice!");
+            wait_for_enter();
+        }
+    }
+}
+
+
+void send_mark_all_notifications_read_request(int sock) {
+    if (strlen(g_session_token) == 0) {
+        print_error("Please login first!");
+        wait_for_enter();
+        return;
+    }
+    
+    struct json_object *request = json_object_new_object();
+    json_object_object_add(request, "command", json_object_new_string("MARK_ALL_NOTIFICATIONS_READ"));
+    
+    struct json_object *data = json_object_new_object();
+    json_object_object_add(data, "session_token", json_object_new_string(g_session_token));
+    json_object_object_add(request, "data", data);
+    
+    const char *json_str = json_object_to_json_string(request);
+    send_frame(sock, json_str, strlen(json_str));
+    json_object_put(request);
+    
+    const char *buffer = receive_response(sock);
+    parse_and_display_response(buffer);
+    wait_for_enter();
+}
+
+// Live mode: the server pushes each new notification on this connection
+// until the user presses ENTER.
+void send_watch_notifications_request(int sock) {
+    if (strlen(g_session_token) == 0) {
+        print_error("Please login first!");
+        wait_for_enter();
+        return;
+    }
+    
+    struct json_object *request = json_object_new_object();
+    json_object_object_add(request, "command", json_object_new_string("SUBSCRIBE_NOTIFICATIONS"));
+    
+    struct json_object *data = json_object_new_object();
+    json_object_object_add(data, "session_token", json_object_new_string(g_session_token));
+    json_object_object_add(request, "data", data);
+    
+    const char *json_str = json_object_to_json_string(request);
+    send_frame(sock, json_str, strlen(json_str));
+    json_object_put(request);
+    
+    const char *buffer = receive_response(sock);
+    parse_and_display_response(buffer);
+    
+    struct json_object *response = json_tokener_parse(buffer);
+    struct json_object *status_obj;
+    int subscribed = response && json_object_object_get_ex(response, "status", &status_obj) &&
+                     json_object_get_int(status_obj) == STATUS_OK;
+    if (response) json_object_put(response);
+    if (!subscribed) {
+        wait_for_enter();
+        return;
+    }
+    
+    printf("\n📡 Watching for notifications. Press ENTER to stop.\n");
+    
+    while (1) {
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(STDIN_FILENO, &fds);
+        FD_SET(sock, &fds);
+        
+        if (select(sock + 1, &fds, NULL, NULL, NULL) < 0) break;
+        
+        if (FD_ISSET(sock, &fds)) {
+            receive_frame_or_exit(sock);
+            if (!display_push(g_response_buf)) parse_and_display_response(g_response_buf);
+        }
+        if (FD_ISSET(STDIN_FILENO, &fds)) {
+            getchar();
+            break;
         }
     }
+    
+    // Stop the pushes before going back to request/response mode
+    request = json_object_new_object();
+    json_object_object_add(request, "command", json_object_new_string("UNSUBSCRIBE_NOTIFICATIONS"));
+    data = json_object_new_object();
+    json_object_object_add(data, "session_token", json_object_new_string(g_session_token));
+    json_object_object_add(request, "data", data);
+    
+    json_str = json_object_to_json_string(request);
+    send_frame(sock, json_str, strlen(json_str));
+    json_object_put(request);
+    
+    receive_response(sock);
+    printf("Stopped watching notifications.\n");
+}
+
+// Menu entries come from the shared command registry in common/commands.h
+typedef struct {
+    CommandId id;
+    void (*run)(int sock);
+    CommandMenu menu;
+    const char *label;
+} ClientCommand;
+
+#define CLIENT_COMMAND_ENTRY(name, handler, client_fn, auth, priority, menu, label) \
+    { CMD_##name, client_fn, menu, label },
+
+static const ClientCommand client_commands[COMMAND_COUNT] = {
+    COMMAND_LIST(CLIENT_COMMAND_ENTRY)
+};
+
+// Returns the choice-th entry (1-based) of a menu, or NULL.
+static const ClientCommand *menu_entry(CommandMenu menu, int choice) {
+    int number = 0;
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        if (client_commands[i].menu != menu || !client_commands[i].run) continue;
+        if (++number == choice) return &client_commands[i];
+    }
+    return NULL;
 }
 
+void print_menu_entries(CommandMenu menu, int unread_count) {
+    int number = 0;
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        const ClientCommand *entry = &client_commands[i];
+        if (entry->menu != menu || !entry->run) continue;
+        
+        char prefix[16];
+        snprintf(prefix, sizeof(prefix), "%d.", ++number);
+        printf("%-3s %s%s\n", prefix, entry->label,
+               entry->id == CMD_GET_NOTIFICATIONS && unread_count > 0 ? " 🔴" : "");
+    }
+}
+
+int run_menu_entry(int sock, CommandMenu menu, int choice) {
+    const ClientCommand *entry = menu_entry(menu, choice);
+    if (!entry) return 0;
+    
+    entry->run(sock);
+    return 1;
+}
@@ -0,0 +1,71 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+// Who may call a command
+typedef enum {
+    AUTH_NONE = 0,      // No session needed
+    AUTH_SESSION        // data.session_token must be present
+} CommandAuth;
+
+// Bulk commands are refused first when the server is under pressure
+typedef enum {
+    PRIORITY_INTERACTIVE = 0,
+    PRIORITY_BULK
+} CommandPriority;
+
+// Client menu a command is listed in
+typedef enum {
+    MENU_NONE = 0,
+    MENU_ACCOUNT,
+    MENU_GROUP
+} CommandMenu;
+
+// Every protocol command, registered once. The server and the client each
+// expand the columns they need:
+//   X(name, server handler, client function, auth, priority, menu, menu label)
+// NULL marks a side that does not implement the command. Menu entries are
+// numbered in the order they appear here.
+#define COMMAND_LIST(X) \
+    X(REGISTER,                    handle_register,                    send_register_request,                     AUTH_NONE,    PRIORITY_INTERACTIVE, MENU_ACCOUNT, "📝 Register New Account") \
+    X(LOGIN,                       handle_login,                       send_login_request,                        AUTH_NONE,    PRIORITY_INTERACTIVE, MENU_ACCOUNT, "🔐 Login") \
+    X(LOGOUT,                      handle_logout,                      send_logout_request,                       AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_ACCOUNT, "🚪 Logout") \
+    X(VERIFY_SESSION,              handle_verify_session,              send_verify_session_request,               AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_NONE,    "✓ Verify Session") \
+    X(UPDATE_PROFILE,              handle_update_profile,              send_update_profile_request,               AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_ACCOUNT, "✏️  Update Profile") \
+    X(CHANGE_PASSWORD,             handle_change_password,             send_change_password_request,              AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_ACCOUNT, "🔑 Change Password") \
+    X(GET_PERMISSIONS,             handle_get_permissions,             send_get_permissions_request,              AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_NONE,    "Get Permissions") \
+    X(UPDATE_PERMISSIONS,          handle_update_permissions,          send_update_permissions_request,           AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_NONE,    "Update Permissions") \
+    X(CREATE_GROUP,                handle_create_group,                send_create_group_request,                 AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_GROUP,   "Create Group") \
+    X(LIST_MY_GROUPS,              handle_list_my_groups,              send_list_my_groups_request,               AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_GROUP,   "List My Groups") \
+    X(LIST_GROUP_MEMBERS,          handle_list_group_members,          send_list_group_members_request,           AUTH_SESSION, PRIORITY_BULK,        MENU_GROUP,   "List Group Members") \
+    X(LIST_AVAILABLE_GROUPS,       handle_list_available_groups,       NULL,                                      AUTH_SESSION, PRIORITY_BULK,        MENU_NONE,    NULL) \
+    X(SEARCH_GROUPS,               handle_search_groups,               send_search_groups_request,                AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_GROUP,   "🔍 Search Groups") \
+    X(REQUEST_JOIN_GROUP,          handle_request_join_group,          send_request_join_group_request,           AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_GROUP,   "Request Join Group") \
+    X(LIST_JOIN_REQUESTS,          handle_list_join_requests,          send_list_join_requests_request,           AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_GROUP,   "List Join Requests (Admin)") \
+    X(APPROVE_JOIN_REQUEST,        handle_approve_join_request,        send_approve_join_request_request,         AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_GROUP,   "Approve/Reject Join Request (Admin)") \
+    X(SEARCH_USERS,                handle_search_users,                send_search_users_request,                 AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_GROUP,   "🔍 Search Users") \
+    X(INVITE_TO_GROUP,             handle_invite_to_group,             send_invite_to_group_request,              AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_GROUP,   "Invite to Group (Admin)") \
+    X(LIST_MY_INVITATIONS,         handle_list_my_invitations,         send_list_my_invitations_request,          AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_GROUP,   "List My Invitations") \
+    X(RESPOND_INVITATION,          handle_respond_invitation,          send_respond_invitation_request,           AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_GROUP,   "Respond to Invitation") \
+    X(LEAVE_GROUP,                 handle_leave_group,                 send_leave_group_request,                  AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_GROUP,   "Leave Group") \
+    X(REMOVE_MEMBER,               handle_remove_member,               send_remove_member_request,                AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_GROUP,   "Remove Member (Admin)") \
+    X(GET_NOTIFICATIONS,           handle_get_notifications,           send_get_notifications_request,            AUTH_SESSION, PRIORITY_BULK,        MENU_GROUP,   "🔔 View All Notifications") \
+    X(MARK_NOTIFICATION_READ,      handle_mark_notification_read,      send_mark_notification_read_request,       AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_GROUP,   "Mark Notification as Read") \
+    X(MARK_ALL_NOTIFICATIONS_READ, handle_mark_all_notifications_read, send_mark_all_notifications_read_request,   AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_GROUP,   "Mark All as Read") \
+    X(GET_UNREAD_COUNT,            handle_get_unread_count,            send_get_unread_count_request,             AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_NONE,    "Get Unread Count") \
+    X(SUBSCRIBE_NOTIFICATIONS,     handle_subscribe_notifications,     send_watch_notifications_request,          AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_GROUP,   "📡 Watch Notifications (live)") \
+    X(UNSUBSCRIBE_NOTIFICATIONS,   handle_unsubscribe_notifications,   NULL,                                      AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_NONE,    NULL) \
+    X(CREATE_DIRECTORY,            NULL,                               send_create_directory_request,             AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_NONE,    "Create Directory") \
+    X(RENAME_DIRECTORY,            NULL,                               send_rename_directory_request,             AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_NONE,    "Rename Directory") \
+    X(DELETE_DIRECTORY,            NULL,                               send_delete_directory_request,             AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_NONE,    "Delete Directory") \
+    X(COPY_DIRECTORY,              NULL,                               send_copy_directory_request,               AUTH_SESSION, PRIORITY_BULK,        MENU_NONE,    "Copy Directory") \
+    X(MOVE_DIRECTORY,              NULL,                               send_move_directory_request,               AUTH_SESSION, PRIORITY_BULK,        MENU_NONE,    "Move Directory") \
+    X(GET_SERVER_STATS,            handle_get_server_stats,            NULL,                                      AUTH_SESSION, PRIORITY_INTERACTIVE, MENU_NONE,    NULL)
+
+#define COMMAND_ENUM_ENTRY(name, handler, client_fn, auth, priority, menu, label) CMD_##name,
+
+typedef enum {
+    COMMAND_LIST(COMMAND_ENUM_ENTRY)
+    COMMAND_COUNT
+} CommandId;
+
+#endif
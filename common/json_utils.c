@@ -0,0 +1,123 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include "json_utils.h"
+
+#define FRAME_BUFFER_MIN 4096
+
+void frame_encode_header(unsigned char header[FRAME_HEADER_SIZE], size_t body_len) {
+    header[0] = (body_len >> 24) & 0xFF;
+    header[1] = (body_len >> 16) & 0xFF;
+    header[2] = (body_len >> 8) & 0xFF;
+    header[3] = body_len & 0xFF;
+}
+
+size_t frame_decode_header(const unsigned char header[FRAME_HEADER_SIZE]) {
+    return ((size_t)header[0] << 24) | ((size_t)header[1] << 16) |
+           ((size_t)header[2] << 8) | (size_t)header[3];
+}
+
+int frame_buffer_append(FrameBuffer *fb, const char *data, size_t len) {
+    // Slide the unconsumed tail to the front before considering a resize
+    if (fb->start > 0) {
+        memmove(fb->data, fb->data + fb->start, fb->len - fb->start);
+        fb->len -= fb->start;
+        fb->start = 0;
+    }
+
+    if (fb->len + len > fb->cap) {
+        size_t new_cap = fb->cap ? fb->cap : FRAME_BUFFER_MIN;
+        while (new_cap < fb->len + len) new_cap *= 2;
+        char *new_data = realloc(fb->data, new_cap);
+        if (!new_data) return -1;
+        fb->data = new_data;
+        fb->cap = new_cap;
+    }
+
+    memcpy(fb->data + fb->len, data, len);
+    fb->len += len;
+    return 0;
+}
+
+int frame_buffer_next(FrameBuffer *fb, const char **body, size_t *body_len) {
+    size_t avail = fb->len - fb->start;
+    if (avail < FRAME_HEADER_SIZE) return 0;
+
+    size_t frame_len = frame_decode_header((unsigned char *)fb->data + fb->start);
+    if (frame_len > MAX_FRAME_SIZE) return -1;
+    if (avail < FRAME_HEADER_SIZE + frame_len) return 0;
+
+    *body = fb->data + fb->start + FRAME_HEADER_SIZE;
+    *body_len = frame_len;
+    fb->start += FRAME_HEADER_SIZE + frame_len;
+    return 1;
+}
+
+void frame_buffer_trim(FrameBuffer *fb) {
+    if (fb->start < fb->len) return;
+    frame_buffer_free(fb);
+}
+
+void frame_buffer_free(FrameBuffer *fb) {
+    free(fb->data);
+    fb->data = NULL;
+    fb->start = fb->len = fb->cap = 0;
+}
+
+static int send_all(int sock, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(sock, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int recv_all(int sock, char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = recv(sock, data, len, 0);
+        if (n == 0) return -1;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int send_frame(int sock, const char *data, size_t len) {
+    if (len > MAX_FRAME_SIZE) return -1;
+
+    unsigned char header[FRAME_HEADER_SIZE];
+    frame_encode_header(header, len);
+    if (send_all(sock, (char *)header, FRAME_HEADER_SIZE) < 0) return -1;
+    return send_all(sock, data, len);
+}
+
+long recv_frame(int sock, char **buf, size_t *cap) {
+    unsigned char header[FRAME_HEADER_SIZE];
+    if (recv_all(sock, (char *)header, FRAME_HEADER_SIZE) < 0) return -1;
+
+    size_t len = frame_decode_header(header);
+    if (len > MAX_FRAME_SIZE) return -1;
+
+    if (len + 1 > *cap) {
+        size_t new_cap = *cap ? *cap : FRAME_BUFFER_MIN;
+        while (new_cap < len + 1) new_cap *= 2;
+        char *new_buf = realloc(*buf, new_cap);
+        if (!new_buf) return -1;
+        *buf = new_buf;
+        *cap = new_cap;
+    }
+
+    if (recv_all(sock, *buf, len) < 0) return -1;
+    (*buf)[len] = '\0';
+    return (long)len;
+}
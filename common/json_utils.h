@@ -0,0 +1,40 @@
+#ifndef JSON_UTILS_H
+#define JSON_UTILS_H
+
+#include <stddef.h>
+#include "protocol.h"
+
+// Incremental reassembly buffer for framed messages. Storage is allocated on
+// demand and released again once every complete frame has been consumed.
+typedef struct {
+    char *data;
+    size_t start;   // First byte not yet consumed
+    size_t len;     // End of received data
+    size_t cap;
+} FrameBuffer;
+
+void frame_encode_header(unsigned char header[FRAME_HEADER_SIZE], size_t body_len);
+size_t frame_decode_header(const unsigned char header[FRAME_HEADER_SIZE]);
+
+// Appends received bytes, growing the buffer as needed. Returns -1 on allocation failure.
+int frame_buffer_append(FrameBuffer *fb, const char *data, size_t len);
+
+// Returns 1 and points body/body_len at the next complete frame, 0 if more data
+// is needed, -1 if the header announces a frame larger than MAX_FRAME_SIZE.
+// The body stays valid until the next append or trim.
+int frame_buffer_next(FrameBuffer *fb, const char **body, size_t *body_len);
+
+// Drops consumed frames, freeing the storage if nothing partial is left.
+void frame_buffer_trim(FrameBuffer *fb);
+void frame_buffer_free(FrameBuffer *fb);
+
+// Blocking helpers for the client side.
+// Sends header and body, retrying short writes. Returns 0 on success, -1 on error.
+int send_frame(int sock, const char *data, size_t len);
+
+// Reads one whole frame into *buf (NUL-terminated), growing it with realloc
+// and updating *cap. Returns the body length, or -1 on EOF, error or a frame
+// over MAX_FRAME_SIZE.
+long recv_frame(int sock, char **buf, size_t *cap);
+
+#endif
@@ -9,6 +9,12 @@
 #define MAX_FULLNAME 100
 #define MAX_TOKEN 64
 
+// Framing: each message is a 4-byte big-endian body length followed by the
+// JSON body. The size cap keeps the first header byte at 0, which is how the
+// server tells framed clients from legacy ones that send bare JSON.
+#define FRAME_HEADER_SIZE 4
+#define MAX_FRAME_SIZE (16 * 1024 * 1024 - 1)
+
 // Response status codes
 #define STATUS_OK 200
 #define STATUS_CREATED 201
@@ -18,5 +24,6 @@
 #define STATUS_NOT_FOUND 404
 #define STATUS_CONFLICT 409
 #define STATUS_INTERNAL_ERROR 500
+#define STATUS_SERVICE_UNAVAILABLE 503
 
 #endif
\ No newline at end of file
@@ -16,6 +16,7 @@ CREATE TABLE groups (
     group_name VARCHAR(100) NOT NULL,
     description TEXT,
     owner_id INTEGER REFERENCES users(user_id) ON DELETE CASCADE,
+    member_count INTEGER NOT NULL DEFAULT 0, -- số thành viên đã duyệt, do trigger cập nhật
     created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
 );
 
@@ -110,11 +111,64 @@ CREATE TABLE sessions (
     is_active BOOLEAN DEFAULT TRUE
 );
 
+-- Bảng notifications (thông báo riêng cho từng user)
+CREATE TABLE notifications (
+    notification_id SERIAL PRIMARY KEY,
+    user_id INTEGER REFERENCES users(user_id) ON DELETE CASCADE,
+    type VARCHAR(50) NOT NULL, -- JOIN_REQUEST, GROUP_INVITATION, MEMBER_LEFT, etc.
+    title VARCHAR(255) NOT NULL,
+    message TEXT,
+    related_type VARCHAR(50), -- GROUP, FILE, USER
+    related_id INTEGER,
+    is_read BOOLEAN NOT NULL DEFAULT FALSE,
+    read_at TIMESTAMP,
+    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+);
+
+-- Bảng notification_counters (số thông báo riêng chưa đọc của từng user, do trigger cập nhật)
+CREATE TABLE notification_counters (
+    user_id INTEGER PRIMARY KEY REFERENCES users(user_id) ON DELETE CASCADE,
+    unread INTEGER NOT NULL DEFAULT 0
+);
+
+-- Bảng group_notifications (thông báo chung cho cả nhóm, ghi một dòng cho mọi thành viên)
+CREATE TABLE group_notifications (
+    group_notification_id SERIAL PRIMARY KEY,
+    group_id INTEGER REFERENCES groups(group_id) ON DELETE CASCADE,
+    type VARCHAR(50) NOT NULL, -- MEMBER_JOINED, etc.
+    title VARCHAR(255) NOT NULL,
+    message TEXT,
+    related_type VARCHAR(50),
+    related_id INTEGER,
+    seq INTEGER NOT NULL, -- số thứ tự trong nhóm (1, 2, 3, ...), do trigger gán
+    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+    UNIQUE (group_id, seq)
+);
+
+-- Bảng group_notification_counters (seq của thông báo nhóm mới nhất)
+CREATE TABLE group_notification_counters (
+    group_id INTEGER PRIMARY KEY REFERENCES groups(group_id) ON DELETE CASCADE,
+    last_seq INTEGER NOT NULL DEFAULT 0
+);
+
+-- Bảng group_notification_cursors (user đã đọc thông báo nhóm đến seq nào).
+-- Tạo lại mỗi khi user vào nhóm; số chưa đọc = last_seq của nhóm - last_read_seq
+CREATE TABLE group_notification_cursors (
+    user_id INTEGER REFERENCES users(user_id) ON DELETE CASCADE,
+    group_id INTEGER REFERENCES groups(group_id) ON DELETE CASCADE,
+    joined_seq INTEGER NOT NULL DEFAULT 0, -- chỉ thấy thông báo có seq > joined_seq
+    last_read_seq INTEGER NOT NULL DEFAULT 0,
+    PRIMARY KEY (user_id, group_id)
+);
+
 -- Tạo indexes để tối ưu truy vấn
 CREATE INDEX idx_users_username ON users(username);
 CREATE INDEX idx_groups_owner ON groups(owner_id);
+CREATE INDEX idx_groups_created ON groups(created_at DESC, group_id DESC);
+CREATE INDEX idx_join_requests_user ON join_requests(user_id, status, group_id);
+CREATE INDEX idx_group_invitations_invitee ON group_invitations(invitee_id, status, group_id);
 CREATE INDEX idx_group_members_user ON group_members(user_id);
-CREATE INDEX idx_group_members_group ON group_members(group_id);
+CREATE INDEX idx_group_members_group ON group_members(group_id, joined_at, user_id);
 CREATE INDEX idx_files_group ON files(group_id);
 CREATE INDEX idx_files_path ON files(file_path);
 CREATE INDEX idx_directories_group ON directories(group_id);
@@ -122,4 +176,332 @@ CREATE INDEX idx_directories_path ON directories(directory_path);
 CREATE INDEX idx_activity_logs_user ON activity_logs(user_id);
 CREATE INDEX idx_activity_logs_created ON activity_logs(created_at);
 CREATE INDEX idx_sessions_token ON sessions(session_token);
-CREATE INDEX idx_sessions_user ON sessions(user_id);
\ No newline at end of file
+CREATE INDEX idx_sessions_user ON sessions(user_id);
+CREATE INDEX idx_notifications_user ON notifications(user_id, created_at DESC, notification_id DESC);
+CREATE INDEX idx_group_notifications_group ON group_notifications(group_id, created_at DESC, group_notification_id DESC);
+CREATE INDEX idx_notifications_unread ON notifications(user_id) WHERE is_read = FALSE;
+
+-- Giữ notification_counters khớp với notifications (một lần cho mỗi câu lệnh,
+-- nên đánh dấu đã đọc hàng loạt chỉ cập nhật mỗi user một lần)
+CREATE FUNCTION count_unread_notifications() RETURNS TRIGGER AS $$
+BEGIN
+    IF TG_OP = 'INSERT' THEN
+        INSERT INTO notification_counters (user_id, unread)
+        SELECT user_id, COUNT(*) FROM new_rows WHERE NOT is_read GROUP BY user_id
+        ON CONFLICT (user_id) DO UPDATE SET unread = notification_counters.unread + EXCLUDED.unread;
+    ELSIF TG_OP = 'UPDATE' THEN
+        INSERT INTO notification_counters (user_id, unread)
+        SELECT n.user_id, SUM(CASE WHEN n.is_read THEN -1 ELSE 1 END)
+        FROM new_rows n JOIN old_rows o ON o.notification_id = n.notification_id
+        WHERE n.is_read <> o.is_read
+        GROUP BY n.user_id
+        ON CONFLICT (user_id) DO UPDATE SET unread = notification_counters.unread + EXCLUDED.unread;
+    ELSE
+        UPDATE notification_counters c SET unread = c.unread - d.cnt
+        FROM (SELECT user_id, COUNT(*) AS cnt FROM old_rows WHERE NOT is_read GROUP BY user_id) d
+        WHERE c.user_id = d.user_id;
+    END IF;
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE TRIGGER trg_notifications_count_insert AFTER INSERT ON notifications
+    REFERENCING NEW TABLE AS new_rows
+    FOR EACH STATEMENT EXECUTE FUNCTION count_unread_notifications();
+CREATE TRIGGER trg_notifications_count_update AFTER UPDATE ON notifications
+    REFERENCING OLD TABLE AS old_rows NEW TABLE AS new_rows
+    FOR EACH STATEMENT EXECUTE FUNCTION count_unread_notifications();
+CREATE TRIGGER trg_notifications_count_delete AFTER DELETE ON notifications
+    REFERENCING OLD TABLE AS old_rows
+    FOR EACH STATEMENT EXECUTE FUNCTION count_unread_notifications();
+
+-- Gán seq cho thông báo nhóm mới
+CREATE FUNCTION next_group_notification_seq() RETURNS TRIGGER AS $$
+BEGIN
+    INSERT INTO group_notification_counters (group_id, last_seq) VALUES (NEW.group_id, 1)
+    ON CONFLICT (group_id) DO UPDATE SET last_seq = group_notification_counters.last_seq + 1
+    RETURNING last_seq INTO NEW.seq;
+    RETURN NEW;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE TRIGGER trg_group_notifications_seq BEFORE INSERT ON group_notifications
+    FOR EACH ROW EXECUTE FUNCTION next_group_notification_seq();
+
+-- Đặt lại cursor khi user trở thành thành viên: thông báo cũ hơn không hiện
+-- và không tính là chưa đọc
+CREATE FUNCTION reset_group_notification_cursor() RETURNS TRIGGER AS $$
+BEGIN
+    IF TG_OP = 'UPDATE' AND OLD.status = 'approved' THEN
+        RETURN NULL;
+    END IF;
+    INSERT INTO group_notification_cursors (user_id, group_id, joined_seq, last_read_seq)
+    SELECT NEW.user_id, NEW.group_id, COALESCE(MAX(last_seq), 0), COALESCE(MAX(last_seq), 0)
+    FROM group_notification_counters WHERE group_id = NEW.group_id
+    ON CONFLICT (user_id, group_id) DO UPDATE
+    SET joined_seq = EXCLUDED.joined_seq, last_read_seq = EXCLUDED.last_read_seq;
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE TRIGGER trg_group_members_cursor AFTER INSERT OR UPDATE OF status ON group_members
+    FOR EACH ROW WHEN (NEW.status = 'approved')
+    EXECUTE FUNCTION reset_group_notification_cursor();
+
+-- Giữ groups.member_count bằng số dòng group_members có status = 'approved'
+CREATE FUNCTION count_group_members() RETURNS TRIGGER AS $$
+BEGIN
+    IF TG_OP = 'UPDATE' AND OLD.status IS NOT DISTINCT FROM NEW.status AND OLD.group_id = NEW.group_id THEN
+        RETURN NULL;
+    END IF;
+    IF TG_OP IN ('UPDATE', 'DELETE') AND OLD.status = 'approved' THEN
+        UPDATE groups SET member_count = member_count - 1 WHERE group_id = OLD.group_id;
+    END IF;
+    IF TG_OP IN ('INSERT', 'UPDATE') AND NEW.status = 'approved' THEN
+        UPDATE groups SET member_count = member_count + 1 WHERE group_id = NEW.group_id;
+    END IF;
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE TRIGGER trg_group_members_count AFTER INSERT OR UPDATE OF status, group_id OR DELETE ON group_members
+    FOR EACH ROW EXECUTE FUNCTION count_group_members();
+
+-- Báo mọi server thay đổi quyền qua kênh file_share_notifications (DB_NOTIFY_CHANNEL), để
+-- bảng quyền trong bộ nhớ của từng server khớp với CSDL dù ai ghi
+CREATE FUNCTION notify_permission_change() RETURNS TRIGGER AS $$
+BEGIN
+    IF TG_OP = 'DELETE' THEN
+        PERFORM pg_notify('file_share_notifications', json_build_object('permission', json_build_object(
+            'permission_id', OLD.permission_id, 'user_id', OLD.user_id, 'group_id', OLD.group_id,
+            'removed', TRUE))::text);
+    ELSE
+        PERFORM pg_notify('file_share_notifications', json_build_object('permission', json_build_object(
+            'permission_id', NEW.permission_id, 'user_id', NEW.user_id, 'group_id', NEW.group_id,
+            'mask', (COALESCE(NEW.can_read, FALSE)::int) | (COALESCE(NEW.can_write, FALSE)::int << 1) |
+                    (COALESCE(NEW.can_delete, FALSE)::int << 2) | (COALESCE(NEW.can_manage, FALSE)::int << 3)))::text);
+    END IF;
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE TRIGGER trg_permissions_notify AFTER INSERT OR UPDATE OR DELETE ON permissions
+    FOR EACH ROW EXECUTE FUNCTION notify_permission_change();
+
+-- Báo mọi server nhóm mới hoặc nhóm đổi tên/mô tả, để chỉ mục tìm kiếm nhóm của từng server
+-- thấy cả nhóm do server khác tạo
+CREATE FUNCTION notify_group_change() RETURNS TRIGGER AS $$
+BEGIN
+    PERFORM pg_notify('file_share_notifications', json_build_object('group', json_build_object(
+        'group_id', NEW.group_id, 'owner_id', NEW.owner_id, 'group_name', NEW.group_name,
+        'description', NEW.description))::text);
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE TRIGGER trg_groups_notify_insert AFTER INSERT ON groups
+    FOR EACH ROW EXECUTE FUNCTION notify_group_change();
+CREATE TRIGGER trg_groups_notify_update AFTER UPDATE OF group_name, description, owner_id ON groups
+    FOR EACH ROW
+    WHEN (OLD.group_name IS DISTINCT FROM NEW.group_name OR OLD.description IS DISTINCT FROM NEW.description
+          OR OLD.owner_id IS DISTINCT FROM NEW.owner_id)
+    EXECUTE FUNCTION notify_group_change();
+
+-- Báo mọi server thành viên nhóm được thêm, đổi vai trò/trạng thái hoặc bị xoá, để cache vai trò
+-- (membership_cache) của từng server bỏ cặp (user, nhóm) đó
+CREATE FUNCTION notify_membership_change() RETURNS TRIGGER AS $$
+BEGIN
+    IF TG_OP <> 'INSERT' THEN
+        PERFORM pg_notify('file_share_notifications', json_build_object('membership', json_build_object(
+            'user_id', OLD.user_id, 'group_id', OLD.group_id))::text);
+    END IF;
+    IF TG_OP = 'INSERT' OR (TG_OP = 'UPDATE' AND (OLD.user_id, OLD.group_id) IS DISTINCT FROM (NEW.user_id, NEW.group_id)) THEN
+        PERFORM pg_notify('file_share_notifications', json_build_object('membership', json_build_object(
+            'user_id', NEW.user_id, 'group_id', NEW.group_id))::text);
+    END IF;
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE TRIGGER trg_group_members_notify AFTER INSERT OR UPDATE OR DELETE ON group_members
+    FOR EACH ROW EXECUTE FUNCTION notify_membership_change();
+
+-- Báo mọi server phiên bị đăng xuất/xoá, hoặc người dùng đổi mật khẩu, tên đăng nhập hay vai trò,
+-- để cache phiên (session_cache) của từng server bỏ các phiên đó ngay thay vì chờ hết TTL
+CREATE FUNCTION notify_session_change() RETURNS TRIGGER AS $$
+BEGIN
+    IF TG_TABLE_NAME = 'users' THEN
+        PERFORM pg_notify('file_share_notifications', json_build_object('session', json_build_object(
+            'user_id', NEW.user_id))::text);
+    ELSE
+        PERFORM pg_notify('file_share_notifications', json_build_object('session', json_build_object(
+            'session_token', OLD.session_token))::text);
+    END IF;
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE TRIGGER trg_sessions_notify_update AFTER UPDATE OF is_active, expires_at, user_id ON sessions
+    FOR EACH ROW
+    WHEN (NOT NEW.is_active OR NEW.expires_at < OLD.expires_at OR OLD.user_id IS DISTINCT FROM NEW.user_id)
+    EXECUTE FUNCTION notify_session_change();
+CREATE TRIGGER trg_sessions_notify_delete AFTER DELETE ON sessions
+    FOR EACH ROW EXECUTE FUNCTION notify_session_change();
+CREATE TRIGGER trg_users_notify_sessions AFTER UPDATE OF password_hash, username, role ON users
+    FOR EACH ROW
+    WHEN (OLD.password_hash IS DISTINCT FROM NEW.password_hash OR OLD.username IS DISTINCT FROM NEW.username
+          OR OLD.role IS DISTINCT FROM NEW.role)
+    EXECUTE FUNCTION notify_session_change();
+
+-- Báo mọi server người dùng mới đăng ký, để bộ lọc tên đăng nhập và chỉ mục tìm kiếm người dùng của
+-- từng server thấy cả người dùng do server khác (hoặc câu lệnh SQL ngoài server) tạo
+CREATE FUNCTION notify_user_registered() RETURNS TRIGGER AS $$
+BEGIN
+    PERFORM pg_notify('file_share_notifications', json_build_object('registered', json_build_object(
+        'user_id', NEW.user_id, 'username', NEW.username, 'full_name', NEW.full_name))::text);
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE TRIGGER trg_users_notify_insert AFTER INSERT ON users
+    FOR EACH ROW EXECUTE FUNCTION notify_user_registered();
+
+-- Báo mọi server người dùng đổi họ tên, để chỉ mục tìm kiếm người dùng của từng server cập nhật theo
+CREATE FUNCTION notify_profile_change() RETURNS TRIGGER AS $$
+BEGIN
+    PERFORM pg_notify('file_share_notifications', json_build_object('profile', json_build_object(
+        'user_id', NEW.user_id, 'full_name', NEW.full_name))::text);
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE TRIGGER trg_users_notify_profile AFTER UPDATE OF full_name ON users
+    FOR EACH ROW
+    WHEN (OLD.full_name IS DISTINCT FROM NEW.full_name)
+    EXECUTE FUNCTION notify_profile_change();
+
+-- Mỗi cặp (nhóm, user) chỉ có một yêu cầu tham gia / lời mời đang chờ
+CREATE UNIQUE INDEX idx_join_requests_pending ON join_requests(group_id, user_id) WHERE status = 'pending';
+CREATE UNIQUE INDEX idx_group_invitations_pending ON group_invitations(group_id, invitee_id) WHERE status = 'pending';
+
+-- Các hàm chuyển trạng thái tham gia/mời: mỗi lệnh chỉ một lần gọi, mọi thay đổi nằm trong
+-- cùng một transaction. "outcome" cho server biết kết quả; dòng yêu cầu/lời mời bị khóa
+-- (FOR UPDATE) nên hai admin xử lý cùng lúc thì người sau thấy nó đã được xử lý.
+
+-- Gửi yêu cầu tham gia. outcome: requested, member (đã là thành viên), pending (đã có yêu cầu chờ)
+CREATE FUNCTION request_join_group(p_user_id INTEGER, p_group_id INTEGER)
+RETURNS TABLE (outcome TEXT, new_request_id INTEGER) AS $$
+BEGIN
+    IF EXISTS (SELECT 1 FROM group_members WHERE group_id = p_group_id AND user_id = p_user_id) THEN
+        outcome := 'member';
+    ELSE
+        INSERT INTO join_requests (group_id, user_id, status) VALUES (p_group_id, p_user_id, 'pending')
+        ON CONFLICT (group_id, user_id) WHERE status = 'pending' DO NOTHING
+        RETURNING request_id INTO new_request_id;
+        outcome := CASE WHEN FOUND THEN 'requested' ELSE 'pending' END;
+    END IF;
+    RETURN NEXT;
+END;
+$$ LANGUAGE plpgsql;
+
+-- Duyệt/từ chối yêu cầu tham gia. outcome: approved, rejected, not_found, forbidden (người duyệt
+-- không phải admin), reviewed (đã được xử lý, request_status là trạng thái hiện tại).
+-- Khi duyệt, thêm thành viên và quyền mặc định; granted_permission_id là NULL nếu user đã có
+-- trong group_members.
+CREATE FUNCTION review_join_request(p_request_id INTEGER, p_reviewer_id INTEGER, p_approve BOOLEAN)
+RETURNS TABLE (outcome TEXT, request_group_id INTEGER, request_user_id INTEGER,
+               request_username VARCHAR, request_status VARCHAR, granted_permission_id INTEGER) AS $$
+BEGIN
+    SELECT jr.group_id, jr.user_id, u.username, jr.status
+    INTO request_group_id, request_user_id, request_username, request_status
+    FROM join_requests jr JOIN users u ON u.user_id = jr.user_id
+    WHERE jr.request_id = p_request_id
+    FOR UPDATE OF jr;
+
+    IF NOT FOUND THEN
+        outcome := 'not_found';
+    ELSIF NOT EXISTS (SELECT 1 FROM groups WHERE group_id = request_group_id AND owner_id = p_reviewer_id)
+      AND NOT EXISTS (SELECT 1 FROM group_members WHERE group_id = request_group_id AND user_id = p_reviewer_id
+                      AND role = 'admin' AND status = 'approved') THEN
+        outcome := 'forbidden';
+    ELSIF request_status <> 'pending' THEN
+        outcome := 'reviewed';
+    ELSE
+        request_status := CASE WHEN p_approve THEN 'approved' ELSE 'rejected' END;
+        UPDATE join_requests SET status = request_status, reviewed_at = CURRENT_TIMESTAMP, reviewed_by = p_reviewer_id
+        WHERE request_id = p_request_id;
+
+        IF p_approve THEN
+            INSERT INTO group_members (group_id, user_id, role, status)
+            VALUES (request_group_id, request_user_id, 'member', 'approved')
+            ON CONFLICT (group_id, user_id) DO NOTHING;
+            IF FOUND THEN
+                INSERT INTO permissions (group_id, user_id, can_read, can_write, can_delete, can_manage)
+                VALUES (request_group_id, request_user_id, TRUE, FALSE, FALSE, FALSE)
+                RETURNING permission_id INTO granted_permission_id;
+            END IF;
+        END IF;
+        outcome := request_status;
+    END IF;
+    RETURN NEXT;
+END;
+$$ LANGUAGE plpgsql;
+
+-- Mời user vào nhóm. outcome: invited, user_not_found, member (đã là thành viên),
+-- pending (đã có lời mời chờ)
+CREATE FUNCTION invite_to_group(p_inviter_id INTEGER, p_group_id INTEGER, p_invitee_username VARCHAR)
+RETURNS TABLE (outcome TEXT, new_invitation_id INTEGER, invitee_user_id INTEGER) AS $$
+BEGIN
+    SELECT user_id INTO invitee_user_id FROM users WHERE username = p_invitee_username;
+
+    IF NOT FOUND THEN
+        outcome := 'user_not_found';
+    ELSIF EXISTS (SELECT 1 FROM group_members WHERE group_id = p_group_id AND user_id = invitee_user_id) THEN
+        outcome := 'member';
+    ELSE
+        INSERT INTO group_invitations (group_id, inviter_id, invitee_id, status)
+        VALUES (p_group_id, p_inviter_id, invitee_user_id, 'pending')
+        ON CONFLICT (group_id, invitee_id) WHERE status = 'pending' DO NOTHING
+        RETURNING invitation_id INTO new_invitation_id;
+        outcome := CASE WHEN FOUND THEN 'invited' ELSE 'pending' END;
+    END IF;
+    RETURN NEXT;
+END;
+$$ LANGUAGE plpgsql;
+
+-- Trả lời lời mời. outcome: accepted, rejected, not_found, forbidden (không phải người được mời),
+-- responded (đã trả lời trước đó). Khi chấp nhận, thêm thành viên và quyền mặc định.
+CREATE FUNCTION respond_invitation(p_invitation_id INTEGER, p_user_id INTEGER, p_accept BOOLEAN)
+RETURNS TABLE (outcome TEXT, invitation_group_id INTEGER, granted_permission_id INTEGER) AS $$
+DECLARE
+    v_invitee_id INTEGER;
+    v_status VARCHAR(20);
+BEGIN
+    SELECT group_id, invitee_id, status INTO invitation_group_id, v_invitee_id, v_status
+    FROM group_invitations WHERE invitation_id = p_invitation_id
+    FOR UPDATE;
+
+    IF NOT FOUND THEN
+        outcome := 'not_found';
+    ELSIF v_invitee_id <> p_user_id THEN
+        outcome := 'forbidden';
+    ELSIF v_status <> 'pending' THEN
+        outcome := 'responded';
+    ELSE
+        outcome := CASE WHEN p_accept THEN 'accepted' ELSE 'rejected' END;
+        UPDATE group_invitations SET status = outcome WHERE invitation_id = p_invitation_id;
+
+        IF p_accept THEN
+            INSERT INTO group_members (group_id, user_id, role, status)
+            VALUES (invitation_group_id, p_user_id, 'member', 'approved')
+            ON CONFLICT (group_id, user_id) DO NOTHING;
+            IF FOUND THEN
+                INSERT INTO permissions (group_id, user_id, can_read, can_write, can_delete, can_manage)
+                VALUES (invitation_group_id, p_user_id, TRUE, FALSE, FALSE, FALSE)
+                RETURNING permission_id INTO granted_permission_id;
+            END IF;
+        END IF;
+    END IF;
+    RETURN NEXT;
+END;
+$$ LANGUAGE plpgsql;
@@ -8,8 +8,34 @@
 #include <json-c/json.h>
 #include "auth_handler.h"
 #include "database.h"
+#include "session_cache.h"
+#include "event_loop.h"
 #include "../common/protocol.h"
 
+// The request this thread is answering. request_id is borrowed from the
+// request object and echoed in every response so pipelining clients can match
+// responses that arrive out of order.
+static __thread struct json_object *current_request_id = NULL;
+static __thread const char *current_client_ip = NULL;
+
+void set_request_context(struct json_object *request, const char *client_ip) {
+    current_request_id = NULL;
+    current_client_ip = client_ip;
+    if (request) json_object_object_get_ex(request, "request_id", &current_request_id);
+}
+
+const char *request_client_ip() {
+    return current_client_ip ? current_client_ip : "";
+}
+
+void send_json_response(int sock, struct json_object *response) {
+    if (current_request_id) {
+        json_object_object_add(response, "request_id", json_object_get(current_request_id));
+    }
+    const char *json_str = json_object_to_json_string(response);
+    net_send(sock, json_str, strlen(json_str));
+}
+
 void send_error_response(int sock, int status, const char *code, const char *message) {
     struct json_object *response = json_object_new_object();
     json_object_object_add(response, "status", json_object_new_int(status));
@@ -17,8 +43,7 @@ void send_error_response(int sock, int status, const char *code, const char *mes
     json_object_object_add(response, "message", json_object_new_string(message));
     json_object_object_add(response, "payload", json_object_new_object());
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     json_object_put(response);
 }
@@ -74,6 +99,8 @@ void handle_register(int sock, struct json_object *request) {
     if (user_id < 0) {
         if (user_id == -2) {
             send_error_response(sock, STATUS_CONFLICT, "ERROR_CONFLICT", "Username already exists");
+        } else if (user_id == -3) {
+            send_error_response(sock, STATUS_CONFLICT, "ERROR_CONFLICT", "Email already exists");
         } else {
             send_error_response(sock, STATUS_INTERNAL_ERROR, "ERROR_INTERNAL_SERVER", "Failed to create user");
         }
@@ -97,13 +124,12 @@ void handle_register(int sock, struct json_object *request) {
     json_object_object_add(payload, "created_at", json_object_new_string(timestamp));
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     json_object_put(response);
 }
 
-void handle_login(int sock, struct json_object *request, const char *client_ip) {
+void handle_login(int sock, struct json_object *request) {
     struct json_object *data_obj, *field;
     
     if (!json_object_object_get_ex(request, "data", &data_obj)) {
@@ -127,28 +153,25 @@ void handle_login(int sock, struct json_object *request, const char *client_ip)
     char hashed_password[65];
     hash_password(password, hashed_password);
     
-    // Verify credentials
-    UserInfo *user = db_verify_user(username, hashed_password);
-    
-    if (!user) {
-        send_error_response(sock, STATUS_UNAUTHORIZED, "ERROR_UNAUTHORIZED", "Invalid username or password");
-        return;
-    }
-    
-    // Update last login time
-    db_update_last_login(user->user_id);
-    
     // Generate session token
     char session_token[37];
     generate_session_token(session_token);
     
-    // Create session (expires in 24 hours)
+    // Verify credentials, update last login time and create the session
+    // (expires in 24 hours) in one go
     time_t expires_at = time(NULL) + 86400;
-    if (!db_create_session(user->user_id, session_token, client_ip, expires_at)) {
-        free(user);
+    UserInfo *user = NULL;
+    int result = db_login(username, hashed_password, session_token, request_client_ip(), expires_at, &user);
+    
+    if (result == 0) {
+        send_error_response(sock, STATUS_UNAUTHORIZED, "ERROR_UNAUTHORIZED", "Invalid username or password");
+        return;
+    }
+    if (result < 0) {
         send_error_response(sock, STATUS_INTERNAL_ERROR, "ERROR_INTERNAL_SERVER", "Failed to create session");
         return;
     }
+    session_cache_put(session_token, user, expires_at);
     
     // Format timestamps
     char expires_str[64];
@@ -168,8 +191,7 @@ void handle_login(int sock, struct json_object *request, const char *client_ip)
     json_object_object_add(payload, "expires_at", json_object_new_string(expires_str));
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
     json_object_put(response);
@@ -193,11 +215,13 @@ void handle_logout(int sock, struct json_object *request) {
         return;
     }
     
-    // Invalidate session
+    // Invalidate session, then drop it from the cache so a verification
+    // racing with the update cannot cache it again
     if (!db_invalidate_session(session_token)) {
         send_error_response(sock, STATUS_INTERNAL_ERROR, "ERROR_INTERNAL_SERVER", "Failed to logout");
         return;
     }
+    session_cache_remove(session_token);
     
     // Send success response
     struct json_object *response = json_object_new_object();
@@ -206,8 +230,7 @@ void handle_logout(int sock, struct json_object *request) {
     json_object_object_add(response, "message", json_object_new_string("Logout successful"));
     json_object_object_add(response, "payload", json_object_new_object());
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     json_object_put(response);
 }
@@ -231,16 +254,14 @@ void handle_verify_session(int sock, struct json_object *request) {
     }
     
     // Verify session
-    UserInfo *user = db_verify_session(session_token);
+    time_t expires_at;
+    UserInfo *user = db_verify_session_expiry(session_token, &expires_at);
     
     if (!user) {
         send_error_response(sock, STATUS_UNAUTHORIZED, "ERROR_UNAUTHORIZED", "Invalid session token or session expired");
         return;
     }
     
-    // Get session expiry time (need to query again for expires_at)
-    // For now, we'll calculate it as 24 hours from now (simplified)
-    time_t expires_at = time(NULL) + 86400;
     char expires_str[64];
     strftime(expires_str, sizeof(expires_str), "%Y-%m-%dT%H:%M:%SZ", gmtime(&expires_at));
     
@@ -256,8 +277,7 @@ void handle_verify_session(int sock, struct json_object *request) {
     json_object_object_add(payload, "expires_at", json_object_new_string(expires_str));
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
     json_object_put(response);
@@ -312,8 +332,7 @@ void handle_update_profile(int sock, struct json_object *request) {
     json_object_object_add(payload, "full_name", json_object_new_string(full_name));
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
     json_object_put(response);
@@ -371,6 +390,9 @@ void handle_change_password(int sock, struct json_object *request) {
         return;
     }
     
+    // Cached sessions of this user are re-checked against the database
+    session_cache_remove_user(user->user_id);
+    
     // Send success response
     struct json_object *response = json_object_new_object();
     json_object_object_add(response, "status", json_object_new_int(STATUS_OK));
@@ -378,8 +400,7 @@ void handle_change_password(int sock, struct json_object *request) {
     json_object_object_add(response, "message", json_object_new_string("Password changed successfully"));
     json_object_object_add(response, "payload", json_object_new_object());
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
     json_object_put(response);
@@ -3,9 +3,14 @@
 
 #include <json-c/json.h>
 
+// Records the request this thread is answering: responses sent from the thread
+// echo its request_id, if any. Pass NULL once the request has been answered.
+void set_request_context(struct json_object *request, const char *client_ip);
+const char *request_client_ip();
+void send_json_response(int sock, struct json_object *response);
 void send_error_response(int sock, int status, const char *code, const char *message);
 void handle_register(int sock, struct json_object *request);
-void handle_login(int sock, struct json_object *request, const char *client_ip);
+void handle_login(int sock, struct json_object *request);
 void handle_logout(int sock, struct json_object *request);
 void handle_verify_session(int sock, struct json_object *request);
 void handle_update_profile(int sock, struct json_object *request);
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "command_table.h"
+#include "auth_handler.h"
+#include "permission_handler.h"
+#include "group_handler.h"
+#include "stats_handler.h"
+
+#define SERVER_COMMAND_ENTRY(name, handler, client_fn, auth, priority, menu, label) \
+    { CMD_##name, #name, handler, auth, priority },
+
+static const CommandInfo commands[COMMAND_COUNT] = {
+    COMMAND_LIST(SERVER_COMMAND_ENTRY)
+};
+
+// Open addressing hash index from command name to table slot. Kept at most
+// half full so probes stay short; -1 marks an empty bucket.
+#define INDEX_SIZE 128
+_Static_assert(COMMAND_COUNT * 2 <= INDEX_SIZE, "command index too small");
+
+static short name_index[INDEX_SIZE];
+
+// Updated concurrently by workers with atomic builtins
+static CommandStats command_stats[COMMAND_COUNT];
+
+static unsigned int hash_name(const char *name) {
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static unsigned long long now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+void command_table_init() {
+    memset(name_index, -1, sizeof(name_index));
+
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        unsigned int slot = hash_name(commands[i].name) & (INDEX_SIZE - 1);
+        while (name_index[slot] >= 0) {
+            slot = (slot + 1) & (INDEX_SIZE - 1);
+        }
+        name_index[slot] = (short)i;
+    }
+}
+
+const CommandInfo *command_lookup(const char *name) {
+    unsigned int slot = hash_name(name) & (INDEX_SIZE - 1);
+
+    while (name_index[slot] >= 0) {
+        const CommandInfo *cmd = &commands[name_index[slot]];
+        if (strcmp(cmd->name, name) == 0) return cmd;
+        slot = (slot + 1) & (INDEX_SIZE - 1);
+    }
+    return NULL;
+}
+
+const CommandInfo *command_info(CommandId id) {
+    return &commands[id];
+}
+
+void command_execute(const CommandInfo *cmd, int sock, struct json_object *request) {
+    unsigned long long start = now_us();
+    cmd->handler(sock, request);
+    unsigned long long elapsed = now_us() - start;
+
+    CommandStats *stats = &command_stats[cmd->id];
+    __atomic_add_fetch(&stats->calls, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats->total_us, elapsed, __ATOMIC_RELAXED);
+
+    unsigned long long max = __atomic_load_n(&stats->max_us, __ATOMIC_RELAXED);
+    while (elapsed > max &&
+           !__atomic_compare_exchange_n(&stats->max_us, &max, elapsed, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+void command_record_rejected(CommandId id) {
+    __atomic_add_fetch(&command_stats[id].rejected, 1, __ATOMIC_RELAXED);
+}
+
+void command_get_stats(CommandId id, CommandStats *out) {
+    CommandStats *stats = &command_stats[id];
+    out->calls = __atomic_load_n(&stats->calls, __ATOMIC_RELAXED);
+    out->rejected = __atomic_load_n(&stats->rejected, __ATOMIC_RELAXED);
+    out->total_us = __atomic_load_n(&stats->total_us, __ATOMIC_RELAXED);
+    out->max_us = __atomic_load_n(&stats->max_us, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,37 @@
+#ifndef COMMAND_TABLE_H
+#define COMMAND_TABLE_H
+
+#include <json-c/json.h>
+#include "../common/commands.h"
+
+typedef void (*CommandHandler)(int sock, struct json_object *request);
+
+typedef struct {
+    CommandId id;
+    const char *name;
+    CommandHandler handler;     // NULL if the server does not implement it
+    CommandAuth auth;
+    CommandPriority priority;
+} CommandInfo;
+
+typedef struct {
+    unsigned long long calls;
+    unsigned long long rejected;    // Refused before reaching the handler
+    unsigned long long total_us;
+    unsigned long long max_us;
+} CommandStats;
+
+// Builds the name index over the registry in common/commands.h.
+// Must run before the first lookup.
+void command_table_init();
+
+// Returns NULL if name is not a registered command.
+const CommandInfo *command_lookup(const char *name);
+const CommandInfo *command_info(CommandId id);
+
+// Runs the command's handler and records its latency.
+void command_execute(const CommandInfo *cmd, int sock, struct json_object *request);
+void command_record_rejected(CommandId id);
+void command_get_stats(CommandId id, CommandStats *stats);
+
+#endif
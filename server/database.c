@@ -1,70 +1,253 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <libpq-fe.h>
 #include "database.h"
+#include "db_pool.h"
+#include "db_statements.h"
+#include "session_cache.h"
+#include "membership_cache.h"
+#include "permission_table.h"
+#include "name_cache.h"
+#include "unread_cache.h"
+#include "group_search.h"
+#include "user_search.h"
+#include "username_filter.h"
 
-static PGconn *conn = NULL;
+// Timestamps before and after any stored one, for the first page of a keyset
+// query: years 1715 and 2285 in microseconds since 2000-01-01, still exact
+// once Postgres turns them into a double to build the interval.
+#define KEYSET_OLDEST_US (-9000000000000000LL)
+#define KEYSET_NEWEST_US 9000000000000000LL
 
-int init_database() {
-    const char *conninfo = "host=localhost dbname=file_share_db user=postgres password=120204";
+// Connection used by the db_* functions on this thread. Checked out of the
+// pool on first use and kept until db_release_connection() ends the request.
+static __thread PGconn *thread_conn = NULL;
+
+static PGconn *db_conn() {
+    if (!thread_conn) thread_conn = db_pool_acquire();
+    return thread_conn;
+}
+
+void db_release_connection() {
+    if (thread_conn) {
+        db_pool_release(thread_conn);
+        thread_conn = NULL;
+    }
+}
+
+static unsigned int permission_mask(int can_read, int can_write, int can_delete, int can_manage) {
+    return (can_read ? PERM_READ : 0) | (can_write ? PERM_WRITE : 0) |
+           (can_delete ? PERM_DELETE : 0) | (can_manage ? PERM_MANAGE : 0);
+}
+
+static void publish_permission(int permission_id, int user_id, int group_id, unsigned int mask) {
+    PermissionEntry entry = { user_id, group_id, permission_id, mask };
+    permission_table_set(&entry);
+}
+
+// Reads the whole permissions table into permission_table.h
+int db_load_permissions() {
+    PGconn *conn = db_conn();
+    if (!conn) return 0;
+    
+    DbParams params;
+    db_params_init(&params);
+    
+    PGresult *res = db_exec(conn, STMT_LOAD_PERMISSIONS, &params);
     
-    conn = PQconnectdb(conninfo);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        fprintf(stderr, "Loading permissions failed: %s\n", PQerrorMessage(conn));
+        PQclear(res);
+        return 0;
+    }
     
-    if (PQstatus(conn) != CONNECTION_OK) {
-        fprintf(stderr, "Connection to database failed: %s", PQerrorMessage(conn));
-        PQfinish(conn);
-        conn = NULL;
+    int rows = PQntuples(res);
+    PermissionEntry *entries = calloc(rows > 0 ? rows : 1, sizeof(PermissionEntry));
+    if (!entries) {
+        PQclear(res);
         return 0;
     }
     
-    printf("Connected to database successfully\n");
+    for (int i = 0; i < rows; i++) {
+        entries[i].permission_id = db_get_int4(res, i, 0);
+        entries[i].user_id = db_get_int4(res, i, 1);
+        entries[i].group_id = db_get_int4(res, i, 2);
+        entries[i].mask = permission_mask(db_get_bool(res, i, 3), db_get_bool(res, i, 4),
+                                          db_get_bool(res, i, 5), db_get_bool(res, i, 6));
+    }
+    PQclear(res);
+    
+    permission_table_load(entries, rows);
+    free(entries);
+    
+    printf("Loaded %d permission entries\n", rows);
     return 1;
 }
 
-void cleanup_database() {
-    if (conn) {
-        PQfinish(conn);
-        conn = NULL;
+// Feeds every existing group to the search index in group_search.h, which
+// ignores groups it already has, a page at a time like db_load_users()
+#define GROUP_LOAD_PAGE 10000
+
+int db_load_groups() {
+    PGconn *conn = db_conn();
+    if (!conn) return 0;
+    
+    int total = 0;
+    int last_group_id = 0;
+    while (1) {
+        DbParams params;
+        db_params_init(&params);
+        db_param_int4(&params, last_group_id);
+        db_param_int4(&params, GROUP_LOAD_PAGE);
+        
+        PGresult *res = db_exec(conn, STMT_LOAD_GROUP_SEARCH, &params);
+        
+        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+            fprintf(stderr, "Loading groups for search failed: %s\n", PQerrorMessage(conn));
+            PQclear(res);
+            return 0;
+        }
+        
+        int rows = PQntuples(res);
+        for (int i = 0; i < rows; i++) {
+            last_group_id = db_get_int4(res, i, 0);
+            group_search_add(last_group_id, db_get_int4(res, i, 1),
+                             db_get_text(res, i, 2), db_get_text(res, i, 3));
+        }
+        PQclear(res);
+        
+        total += rows;
+        if (rows < GROUP_LOAD_PAGE) break;
+    }
+    
+    printf("Indexed %d groups for search\n", total);
+    return 1;
+}
+
+// Feeds every user to the search index in user_search.h and the username
+// filter, a page at a time so a large users table never sits in one result.
+// Always a full scan: user_ids are handed out before their rows commit, so a
+// registration may become visible after users with higher ids and a "since
+// the highest id seen" scan would skip it. Both indexes ignore users they
+// already have.
+#define USER_LOAD_PAGE 10000
+
+int db_load_users() {
+    PGconn *conn = db_conn();
+    if (!conn) return 0;
+    
+    int total = 0;
+    int last_user_id = 0;
+    while (1) {
+        DbParams params;
+        db_params_init(&params);
+        db_param_int4(&params, last_user_id);
+        db_param_int4(&params, USER_LOAD_PAGE);
+        
+        PGresult *res = db_exec(conn, STMT_LOAD_USERS, &params);
+        
+        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+            fprintf(stderr, "Loading users failed: %s\n", PQerrorMessage(conn));
+            PQclear(res);
+            return 0;
+        }
+        
+        int rows = PQntuples(res);
+        for (int i = 0; i < rows; i++) {
+            last_user_id = db_get_int4(res, i, 0);
+            username_filter_add(db_get_text(res, i, 1));
+            user_search_add(last_user_id, db_get_text(res, i, 1), db_get_text(res, i, 2));
+        }
+        PQclear(res);
+        
+        total += rows;
+        if (rows < USER_LOAD_PAGE) break;
     }
+    user_search_build();
+    
+    printf("Indexed %d users\n", total);
+    return 1;
+}
+
+static const char *conninfo = "host=localhost dbname=file_share_db user=postgres password=120204";
+
+const char *db_conninfo() {
+    return conninfo;
+}
+
+int init_database() {
+
+    int pool_size = DB_POOL_SIZE;
+    const char *env_size = getenv("DB_POOL_SIZE");
+    if (env_size && atoi(env_size) > 0) pool_size = atoi(env_size);
+    
+    if (!db_pool_init(conninfo, pool_size)) {
+        return 0;
+    }
+    
+    printf("Connected to database successfully (%d pooled connections)\n", db_pool_size());
+    
+    // Permissions, groups and users are loaded by the notification listener
+    // once it is LISTENing, see notify_hub_init()
+    return 1;
+}
+
+void cleanup_database() {
+    db_release_connection();
+    db_pool_destroy();
 }
 
 int db_create_user(const char *username, const char *password_hash, const char *email, const char *full_name) {
+    PGconn *conn = db_conn();
     if (!conn) return -1;
     
-    const char *paramValues[4] = {username, password_hash, email, full_name};
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, username);
+    db_param_text(&params, password_hash);
+    db_param_text(&params, email);
+    db_param_text(&params, full_name);
     
-    PGresult *res = PQexecParams(conn,
-        "INSERT INTO users (username, password_hash, email, full_name) VALUES ($1, $2, $3, $4) RETURNING user_id",
-        4, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_CREATE_USER, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "INSERT failed: %s", PQerrorMessage(conn));
-        
-        // Check for duplicate username
-        if (strstr(PQerrorMessage(conn), "duplicate key") != NULL) {
-            PQclear(res);
-            return -2;
-        }
+        // A taken username is skipped by ON CONFLICT, so a unique
+        // violation here can only be the email
+        const char *sqlstate = PQresultErrorField(res, PG_DIAG_SQLSTATE);
+        int duplicate_email = sqlstate && strcmp(sqlstate, "23505") == 0;
+        if (!duplicate_email) fprintf(stderr, "INSERT failed: %s", PQerrorMessage(conn));
         
         PQclear(res);
-        return -1;
+        return duplicate_email ? -3 : -1;
     }
     
-    int user_id = atoi(PQgetvalue(res, 0, 0));
+    if (PQntuples(res) == 0) {
+        PQclear(res);
+        return -2;
+    }
+    
+    int user_id = db_get_int4(res, 0, 0);
     PQclear(res);
     
+    // Other server processes learn of it from the NOTIFY sent by the users trigger
+    username_filter_add(username);
+    user_search_add(user_id, username, full_name);
+    
     return user_id;
 }
 
 UserInfo* db_verify_user(const char *username, const char *password_hash) {
+    PGconn *conn = db_conn();
     if (!conn) return NULL;
     
-    const char *paramValues[2] = {username, password_hash};
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, username);
+    db_param_text(&params, password_hash);
     
-    PGresult *res = PQexecParams(conn,
-        "SELECT user_id, username, role FROM users WHERE username = $1 AND password_hash = $2",
-        2, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_VERIFY_USER, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
         PQclear(res);
@@ -72,7 +255,7 @@ UserInfo* db_verify_user(const char *username, const char *password_hash) {
     }
     
     UserInfo *user = (UserInfo*)malloc(sizeof(UserInfo));
-    user->user_id = atoi(PQgetvalue(res, 0, 0));
+    user->user_id = db_get_int4(res, 0, 0);
     strncpy(user->username, PQgetvalue(res, 0, 1), 50);
     user->username[50] = '\0';
     strncpy(user->role, PQgetvalue(res, 0, 2), 20);
@@ -83,18 +266,77 @@ UserInfo* db_verify_user(const char *username, const char *password_hash) {
     return user;
 }
 
+int db_login(const char *username, const char *password_hash, const char *session_token,
+             const char *ip_address, time_t expires_at, UserInfo **user) {
+    *user = NULL;
+    
+    // Unregistered usernames are turned away without a round trip
+    if (!username_filter_may_exist(username)) return 0;
+    
+    PGconn *conn = db_conn();
+    if (!conn) return -1;
+    
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, username);
+    db_param_text(&params, password_hash);
+    
+    // Session insert only matches a row if the credentials are right
+    DbParams sessionParams;
+    db_params_init(&sessionParams);
+    db_param_text(&sessionParams, username);
+    db_param_text(&sessionParams, password_hash);
+    db_param_text(&sessionParams, session_token);
+    db_param_text(&sessionParams, ip_address);
+    db_param_int8(&sessionParams, (long long)expires_at);
+    
+    DbBatch batch;
+    db_batch_init(&batch, conn);
+    int verify_step = db_batch_add(&batch, STMT_VERIFY_USER, &params);
+    db_batch_add(&batch, STMT_LOGIN_TOUCH_USER, &params);
+    int session_step = db_batch_add(&batch, STMT_LOGIN_CREATE_SESSION, &sessionParams);
+    
+    if (!db_batch_run(&batch)) {
+        fprintf(stderr, "Login failed at step %d\n", batch.failed_step);
+        db_batch_clear(&batch);
+        return -1;
+    }
+    
+    PGresult *res = db_batch_result(&batch, verify_step);
+    if (PQntuples(res) == 0) {
+        db_batch_clear(&batch);
+        return 0;
+    }
+    
+    if (atoi(PQcmdTuples(db_batch_result(&batch, session_step))) == 0) {
+        // Credentials changed between the statements
+        db_batch_clear(&batch);
+        return -1;
+    }
+    
+    *user = (UserInfo*)malloc(sizeof(UserInfo));
+    (*user)->user_id = db_get_int4(res, 0, 0);
+    strncpy((*user)->username, PQgetvalue(res, 0, 1), 50);
+    (*user)->username[50] = '\0';
+    strncpy((*user)->role, PQgetvalue(res, 0, 2), 20);
+    (*user)->role[20] = '\0';
+    
+    db_batch_clear(&batch);
+    return 1;
+}
+
 int db_create_session(int user_id, const char *session_token, const char *ip_address, time_t expires_at) {
+    PGconn *conn = db_conn();
     if (!conn) return 0;
     
-    char user_id_str[32], expires_str[32];
-    sprintf(user_id_str, "%d", user_id);
-    sprintf(expires_str, "%ld", expires_at);
-    
-    const char *paramValues[4] = {user_id_str, session_token, ip_address, expires_str};
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, user_id);
+    db_param_text(&params, session_token);
+    db_param_text(&params, ip_address);
+    db_param_int8(&params, (long long)expires_at);
     
-    PGresult *res = PQexecParams(conn,
-        "INSERT INTO sessions (user_id, session_token, ip_address, expires_at) VALUES ($1, $2, $3, to_timestamp($4))",
-        4, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_CREATE_SESSION, &params);
     
     int success = (PQresultStatus(res) == PGRES_COMMAND_OK);
     PQclear(res);
@@ -103,16 +345,14 @@ int db_create_session(int user_id, const char *session_token, const char *ip_add
 }
 
 int db_update_last_login(int user_id) {
+    PGconn *conn = db_conn();
     if (!conn) return 0;
     
-    char user_id_str[32];
-    sprintf(user_id_str, "%d", user_id);
-    
-    const char *paramValues[1] = {user_id_str};
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, user_id);
     
-    PGresult *res = PQexecParams(conn,
-        "UPDATE users SET last_login = CURRENT_TIMESTAMP WHERE user_id = $1",
-        1, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_UPDATE_LAST_LOGIN, &params);
     
     int success = (PQresultStatus(res) == PGRES_COMMAND_OK);
     PQclear(res);
@@ -121,15 +361,26 @@ int db_update_last_login(int user_id) {
 }
 
 UserInfo* db_verify_session(const char *session_token) {
+    return db_verify_session_expiry(session_token, NULL);
+}
+
+UserInfo* db_verify_session_expiry(const char *session_token, time_t *expires_at) {
+    UserInfo cached;
+    unsigned long long version;
+    if (session_cache_get(session_token, &cached, expires_at, &version)) {
+        UserInfo *user = (UserInfo*)malloc(sizeof(UserInfo));
+        *user = cached;
+        return user;
+    }
+    
+    PGconn *conn = db_conn();
     if (!conn) return NULL;
     
-    const char *paramValues[1] = {session_token};
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, session_token);
     
-    PGresult *res = PQexecParams(conn,
-        "SELECT s.user_id, u.username, u.role, s.expires_at FROM sessions s "
-        "JOIN users u ON s.user_id = u.user_id "
-        "WHERE s.session_token = $1 AND s.is_active = TRUE AND s.expires_at > CURRENT_TIMESTAMP",
-        1, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_VERIFY_SESSION, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
         PQclear(res);
@@ -137,24 +388,29 @@ UserInfo* db_verify_session(const char *session_token) {
     }
     
     UserInfo *user = (UserInfo*)malloc(sizeof(UserInfo));
-    user->user_id = atoi(PQgetvalue(res, 0, 0));
+    user->user_id = db_get_int4(res, 0, 0);
     strncpy(user->username, PQgetvalue(res, 0, 1), 50);
     user->username[50] = '\0';
     strncpy(user->role, PQgetvalue(res, 0, 2), 20);
     user->role[20] = '\0';
     
+    time_t session_expires_at = (time_t)db_get_int8(res, 0, 3);
+    if (expires_at) *expires_at = session_expires_at;
+    session_cache_fill(session_token, user, session_expires_at, version);
+    
     PQclear(res);
     return user;
 }
 
 int db_invalidate_session(const char *session_token) {
+    PGconn *conn = db_conn();
     if (!conn) return 0;
     
-    const char *paramValues[1] = {session_token};
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, session_token);
     
-    PGresult *res = PQexecParams(conn,
-        "UPDATE sessions SET is_active = FALSE WHERE session_token = $1",
-        1, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_INVALIDATE_SESSION, &params);
     
     int success = (PQresultStatus(res) == PGRES_COMMAND_OK);
     PQclear(res);
@@ -163,34 +419,39 @@ int db_invalidate_session(const char *session_token) {
 }
 
 int db_update_profile(int user_id, const char *email, const char *full_name) {
+    PGconn *conn = db_conn();
     if (!conn) return 0;
     
-    char user_id_str[32];
-    sprintf(user_id_str, "%d", user_id);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, user_id);
+    db_param_text(&params, email);
+    db_param_text(&params, full_name);
     
-    const char *paramValues[3] = {user_id_str, email, full_name};
-    
-    PGresult *res = PQexecParams(conn,
-        "UPDATE users SET email = $2, full_name = $3 WHERE user_id = $1",
-        3, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_UPDATE_PROFILE, &params);
     
     int success = (PQresultStatus(res) == PGRES_COMMAND_OK);
     PQclear(res);
     
+    // Only email and full name change today, but drop the cached name so a
+    // profile edit never leaves a stale one behind
+    if (success) {
+        name_cache_invalidate(NAME_USER, user_id);
+        user_search_update_full_name(user_id, full_name);
+    }
+    
     return success;
 }
 
 UserInfo* db_get_user_by_id(int user_id) {
+    PGconn *conn = db_conn();
     if (!conn) return NULL;
     
-    char user_id_str[32];
-    sprintf(user_id_str, "%d", user_id);
-    
-    const char *paramValues[1] = {user_id_str};
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, user_id);
     
-    PGresult *res = PQexecParams(conn,
-        "SELECT user_id, username, role, email, full_name FROM users WHERE user_id = $1",
-        1, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_GET_USER_BY_ID, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
         PQclear(res);
@@ -198,7 +459,7 @@ UserInfo* db_get_user_by_id(int user_id) {
     }
     
     UserInfo *user = (UserInfo*)malloc(sizeof(UserInfo));
-    user->user_id = atoi(PQgetvalue(res, 0, 0));
+    user->user_id = db_get_int4(res, 0, 0);
     strncpy(user->username, PQgetvalue(res, 0, 1), 50);
     user->username[50] = '\0';
     strncpy(user->role, PQgetvalue(res, 0, 2), 20);
@@ -213,16 +474,15 @@ UserInfo* db_get_user_by_id(int user_id) {
 }
 
 int db_change_password(int user_id, const char *new_password_hash) {
+    PGconn *conn = db_conn();
     if (!conn) return 0;
     
-    char user_id_str[32];
-    sprintf(user_id_str, "%d", user_id);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, user_id);
+    db_param_text(&params, new_password_hash);
     
-    const char *paramValues[2] = {user_id_str, new_password_hash};
-    
-    PGresult *res = PQexecParams(conn,
-        "UPDATE users SET password_hash = $2 WHERE user_id = $1",
-        2, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_CHANGE_PASSWORD, &params);
     
     int success = (PQresultStatus(res) == PGRES_COMMAND_OK);
     PQclear(res);
@@ -230,172 +490,138 @@ int db_change_password(int user_id, const char *new_password_hash) {
     return success;
 }
 
-PermissionInfo* db_get_permissions(int user_id, int group_id) {
-    if (!conn) return NULL;
-    
-    char user_id_str[32], group_id_str[32];
-    sprintf(user_id_str, "%d", user_id);
-    sprintf(group_id_str, "%d", group_id);
-    
-    const char *paramValues[2] = {user_id_str, group_id_str};
-    
-    PGresult *res = PQexecParams(conn,
-        "SELECT permission_id, user_id, group_id, can_read, can_write, can_delete, can_manage "
-        "FROM permissions WHERE user_id = $1 AND group_id = $2",
-        2, NULL, paramValues, NULL, NULL, 0);
-    
-    if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
-        PQclear(res);
-        return NULL;
-    }
-    
-    PermissionInfo *perm = (PermissionInfo*)malloc(sizeof(PermissionInfo));
-    perm->permission_id = atoi(PQgetvalue(res, 0, 0));
-    perm->user_id = atoi(PQgetvalue(res, 0, 1));
-    perm->group_id = atoi(PQgetvalue(res, 0, 2));
-    perm->can_read = strcmp(PQgetvalue(res, 0, 3), "t") == 0 ? 1 : 0;
-    perm->can_write = strcmp(PQgetvalue(res, 0, 4), "t") == 0 ? 1 : 0;
-    perm->can_delete = strcmp(PQgetvalue(res, 0, 5), "t") == 0 ? 1 : 0;
-    perm->can_manage = strcmp(PQgetvalue(res, 0, 6), "t") == 0 ? 1 : 0;
-    
-    PQclear(res);
-    return perm;
+int db_get_permissions(int user_id, int group_id, PermissionInfo *perm) {
+    PermissionEntry entry;
+    if (!permission_table_get(user_id, group_id, &entry)) return 0;
+    
+    perm->permission_id = entry.permission_id;
+    perm->user_id = entry.user_id;
+    perm->group_id = entry.group_id;
+    perm->can_read = (entry.mask & PERM_READ) != 0;
+    perm->can_write = (entry.mask & PERM_WRITE) != 0;
+    perm->can_delete = (entry.mask & PERM_DELETE) != 0;
+    perm->can_manage = (entry.mask & PERM_MANAGE) != 0;
+    return 1;
+}
+
+int db_has_permission(int user_id, int group_id, unsigned int mask) {
+    return permission_table_check(user_id, group_id, mask);
 }
 
 int db_update_permissions(int user_id, int group_id, int can_read, int can_write, int can_delete, int can_manage) {
+    PGconn *conn = db_conn();
     if (!conn) return 0;
     
-    char user_id_str[32], group_id_str[32];
-    char can_read_str[10], can_write_str[10], can_delete_str[10], can_manage_str[10];
-    
-    sprintf(user_id_str, "%d", user_id);
-    sprintf(group_id_str, "%d", group_id);
-    sprintf(can_read_str, "%s", can_read ? "true" : "false");
-    sprintf(can_write_str, "%s", can_write ? "true" : "false");
-    sprintf(can_delete_str, "%s", can_delete ? "true" : "false");
-    sprintf(can_manage_str, "%s", can_manage ? "true" : "false");
-    
-    const char *paramValues[6] = {user_id_str, group_id_str, can_read_str, can_write_str, can_delete_str, can_manage_str};
-    
-    // Check if permission exists
-    PGresult *check_res = PQexecParams(conn,
-        "SELECT permission_id FROM permissions WHERE user_id = $1 AND group_id = $2",
-        2, NULL, paramValues, NULL, NULL, 0);
-    
-    int exists = (PQresultStatus(check_res) == PGRES_TUPLES_OK && PQntuples(check_res) > 0);
-    PQclear(check_res);
-    
-    PGresult *res;
-    if (exists) {
-        // Update existing permission
-        res = PQexecParams(conn,
-            "UPDATE permissions SET can_read = $3, can_write = $4, can_delete = $5, can_manage = $6 "
-            "WHERE user_id = $1 AND group_id = $2",
-            6, NULL, paramValues, NULL, NULL, 0);
-    } else {
-        // Insert new permission
-        res = PQexecParams(conn,
-            "INSERT INTO permissions (user_id, group_id, can_read, can_write, can_delete, can_manage) "
-            "VALUES ($1, $2, $3, $4, $5, $6)",
-            6, NULL, paramValues, NULL, NULL, 0);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, user_id);
+    db_param_int4(&params, group_id);
+    db_param_bool(&params, can_read);
+    db_param_bool(&params, can_write);
+    db_param_bool(&params, can_delete);
+    db_param_bool(&params, can_manage);
+    
+    // Update existing permission, or insert one if there was none
+    PGresult *res = db_exec(conn, STMT_UPDATE_PERMISSIONS, &params);
+    if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 0) {
+        PQclear(res);
+        res = db_exec(conn, STMT_INSERT_PERMISSIONS, &params);
     }
     
-    int success = (PQresultStatus(res) == PGRES_COMMAND_OK);
+    int success = (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0);
+    if (success) {
+        publish_permission(db_get_int4(res, PQntuples(res) - 1, 0), user_id, group_id,
+                           permission_mask(can_read, can_write, can_delete, can_manage));
+    }
     PQclear(res);
     
     return success;
 }
 
-int db_is_group_admin(int user_id, int group_id) {
-    if (!conn) return 0;
+// Owner or approved member, and which. Answered from the membership cache
+// when possible; the write paths below keep it in step.
+static MembershipRole db_membership_role(int user_id, int group_id) {
+    MembershipRole role;
+    unsigned long long version;
+    if (membership_cache_get(user_id, group_id, &role, &version)) return role;
     
-    char user_id_str[32], group_id_str[32];
-    sprintf(user_id_str, "%d", user_id);
-    sprintf(group_id_str, "%d", group_id);
+    PGconn *conn = db_conn();
+    if (!conn) return MEMBERSHIP_NONE;
     
-    const char *paramValues[2] = {user_id_str, group_id_str};
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, user_id);
+    db_param_int4(&params, group_id);
     
-    // Check if user is owner of the group
-    PGresult *res = PQexecParams(conn,
-        "SELECT group_id FROM groups WHERE group_id = $2 AND owner_id = $1",
-        2, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_GET_MEMBERSHIP_ROLE, &params);
     
-    int is_owner = (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0);
-    PQclear(res);
-    
-    if (is_owner) return 1;
-    
-    // Check if user is admin member of the group
-    res = PQexecParams(conn,
-        "SELECT member_id FROM group_members WHERE user_id = $1 AND group_id = $2 AND role = 'admin' AND status = 'approved'",
-        2, NULL, paramValues, NULL, NULL, 0);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
+        PQclear(res);
+        return MEMBERSHIP_NONE;
+    }
     
-    int is_admin = (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0);
+    if (db_get_bool(res, 0, 0)) role = MEMBERSHIP_ADMIN;   // Owner
+    else if (PQgetisnull(res, 0, 1)) role = MEMBERSHIP_NONE;
+    else if (strcmp(db_get_text(res, 0, 1), "admin") == 0) role = MEMBERSHIP_ADMIN;
+    else role = MEMBERSHIP_MEMBER;
     PQclear(res);
     
-    return is_admin;
+    membership_cache_fill(user_id, group_id, role, version);
+    return role;
+}
+
+int db_is_group_admin(int user_id, int group_id) {
+    return db_membership_role(user_id, group_id) == MEMBERSHIP_ADMIN;
 }
 
 int db_create_group(int owner_id, const char *group_name, const char *description) {
+    PGconn *conn = db_conn();
     if (!conn) return -1;
     
-    char owner_id_str[32];
-    sprintf(owner_id_str, "%d", owner_id);
-    
-    const char *paramValues[3] = {group_name, description ? description : "", owner_id_str};
-    
-    PGresult *res = PQexecParams(conn,
-        "INSERT INTO groups (group_name, description, owner_id) VALUES ($1, $2, $3) RETURNING group_id",
-        3, NULL, paramValues, NULL, NULL, 0);
-    
-    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "INSERT group failed: %s", PQerrorMessage(conn));
-        PQclear(res);
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, group_name);
+    db_param_text(&params, description ? description : "");
+    db_param_int4(&params, owner_id);
+    
+    // Owner becomes an admin member with full permissions. Both inserts pick
+    // up the new group_id from the sequence, so all three go out together.
+    DbParams ownerParams;
+    db_params_init(&ownerParams);
+    db_param_int4(&ownerParams, owner_id);
+    
+    DbBatch batch;
+    db_batch_init(&batch, conn);
+    int group_step = db_batch_add(&batch, STMT_CREATE_GROUP, &params);
+    db_batch_add(&batch, STMT_ADD_NEW_GROUP_ADMIN, &ownerParams);
+    int grant_step = db_batch_add(&batch, STMT_GRANT_NEW_GROUP_ADMIN_PERMISSIONS, &ownerParams);
+    
+    if (!db_batch_run(&batch)) {
+        fprintf(stderr, "INSERT group failed at step %d\n", batch.failed_step);
+        db_batch_clear(&batch);
         return -1;
     }
     
-    int group_id = atoi(PQgetvalue(res, 0, 0));
-    PQclear(res);
+    int group_id = db_get_int4(db_batch_result(&batch, group_step), 0, 0);
+    int permission_id = db_get_int4(db_batch_result(&batch, grant_step), 0, 0);
+    db_batch_clear(&batch);
     
-    // Add owner as admin member
-    char group_id_str[32];
-    sprintf(group_id_str, "%d", group_id);
-    const char *memberParams[2] = {group_id_str, owner_id_str};
-    
-    res = PQexecParams(conn,
-        "INSERT INTO group_members (group_id, user_id, role, status) VALUES ($1, $2, 'admin', 'approved')",
-        2, NULL, memberParams, NULL, NULL, 0);
-    PQclear(res);
-    
-    // Create full permissions for owner (admin)
-    const char *permParams[2] = {group_id_str, owner_id_str};
-    res = PQexecParams(conn,
-        "INSERT INTO permissions (group_id, user_id, can_read, can_write, can_delete, can_manage) "
-        "VALUES ($1, $2, TRUE, TRUE, TRUE, TRUE)",
-        2, NULL, permParams, NULL, NULL, 0);
-    PQclear(res);
+    membership_cache_set(owner_id, group_id, MEMBERSHIP_ADMIN);
+    publish_permission(permission_id, owner_id, group_id, PERM_ALL);
+    group_search_add(group_id, owner_id, group_name, description);
     
     return group_id;
 }
 
 int db_get_user_groups(int user_id, GroupInfo ***groups) {
+    PGconn *conn = db_conn();
     if (!conn) return 0;
     
-    char user_id_str[32];
-    sprintf(user_id_str, "%d", user_id);
-    
-    const char *paramValues[1] = {user_id_str};
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, user_id);
     
-    PGresult *res = PQexecParams(conn,
-        "SELECT g.group_id, g.group_name, g.description, "
-        "CASE WHEN g.owner_id = $1 THEN 'admin' ELSE COALESCE(gm.role, 'member') END as role, "
-        "(SELECT COUNT(*) FROM group_members WHERE group_id = g.group_id AND status = 'approved') as member_count, "
-        "g.created_at "
-        "FROM groups g "
-        "LEFT JOIN group_members gm ON g.group_id = gm.group_id AND gm.user_id = $1 "
-        "WHERE g.owner_id = $1 OR (gm.user_id = $1 AND gm.status = 'approved') "
-        "ORDER BY g.created_at DESC",
-        1, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_GET_USER_GROUPS, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         PQclear(res);
@@ -412,16 +638,15 @@ int db_get_user_groups(int user_id, GroupInfo ***groups) {
     
     for (int i = 0; i < count; i++) {
         (*groups)[i] = (GroupInfo*)malloc(sizeof(GroupInfo));
-        (*groups)[i]->group_id = atoi(PQgetvalue(res, i, 0));
+        (*groups)[i]->group_id = db_get_int4(res, i, 0);
         strncpy((*groups)[i]->group_name, PQgetvalue(res, i, 1), 100);
         (*groups)[i]->group_name[100] = '\0';
         strncpy((*groups)[i]->description, PQgetvalue(res, i, 2), 255);
         (*groups)[i]->description[255] = '\0';
         strncpy((*groups)[i]->role, PQgetvalue(res, i, 3), 20);
         (*groups)[i]->role[20] = '\0';
-        (*groups)[i]->member_count = atoi(PQgetvalue(res, i, 4));
-        strncpy((*groups)[i]->created_at, PQgetvalue(res, i, 5), 63);
-        (*groups)[i]->created_at[63] = '\0';
+        (*groups)[i]->member_count = db_get_int4(res, i, 4);
+        db_get_timestamp(res, i, 5, (*groups)[i]->created_at, sizeof((*groups)[i]->created_at));
     }
     
     PQclear(res);
@@ -429,77 +654,56 @@ int db_get_user_groups(int user_id, GroupInfo ***groups) {
 }
 
 int db_is_group_member(int user_id, int group_id) {
-    if (!conn) return 0;
-    
-    char user_id_str[32], group_id_str[32];
-    sprintf(user_id_str, "%d", user_id);
-    sprintf(group_id_str, "%d", group_id);
-    
-    const char *paramValues[2] = {user_id_str, group_id_str};
-    
-    // Check if user is owner
-    PGresult *res = PQexecParams(conn,
-        "SELECT group_id FROM groups WHERE group_id = $2 AND owner_id = $1",
-        2, NULL, paramValues, NULL, NULL, 0);
-    
-    int is_owner = (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0);
-    PQclear(res);
-    
-    if (is_owner) return 1;
-    
-    // Check if user is approved member
-    res = PQexecParams(conn,
-        "SELECT member_id FROM group_members WHERE user_id = $1 AND group_id = $2 AND status = 'approved'",
-        2, NULL, paramValues, NULL, NULL, 0);
-    
-    int is_member = (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0);
-    PQclear(res);
-    
-    return is_member;
+    return db_membership_role(user_id, group_id) != MEMBERSHIP_NONE;
 }
 
-int db_get_group_members(int group_id, MemberInfo ***members) {
-    if (!conn) return 0;
+int db_get_group_members(int group_id, const MemberCursor *after, int limit, MemberInfo **members, int *has_more) {
+    *members = NULL;
+    *has_more = 0;
     
-    char group_id_str[32];
-    sprintf(group_id_str, "%d", group_id);
+    PGconn *conn = db_conn();
+    if (!conn) return -1;
     
-    const char *paramValues[1] = {group_id_str};
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, group_id);
+    db_param_int8(&params, after ? after->joined_us : KEYSET_OLDEST_US);
+    db_param_int4(&params, after ? after->user_id : 0);
+    db_param_int4(&params, limit + 1);     // One extra row tells whether there is more
     
-    PGresult *res = PQexecParams(conn,
-        "SELECT u.user_id, u.username, u.full_name, gm.role, gm.status, gm.joined_at "
-        "FROM group_members gm "
-        "JOIN users u ON gm.user_id = u.user_id "
-        "WHERE gm.group_id = $1 "
-        "ORDER BY gm.joined_at ASC",
-        1, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_GET_GROUP_MEMBERS, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        fprintf(stderr, "Get group members failed: %s\n", PQerrorMessage(conn));
         PQclear(res);
-        return 0;
+        return -1;
     }
     
     int count = PQntuples(res);
+    if (count > limit) {
+        count = limit;
+        *has_more = 1;
+    }
     if (count == 0) {
         PQclear(res);
         return 0;
     }
     
-    *members = (MemberInfo**)malloc(count * sizeof(MemberInfo*));
+    *members = calloc(count, sizeof(MemberInfo));
+    if (!*members) {
+        PQclear(res);
+        return -1;
+    }
     
     for (int i = 0; i < count; i++) {
-        (*members)[i] = (MemberInfo*)malloc(sizeof(MemberInfo));
-        (*members)[i]->user_id = atoi(PQgetvalue(res, i, 0));
-        strncpy((*members)[i]->username, PQgetvalue(res, i, 1), 50);
-        (*members)[i]->username[50] = '\0';
-        strncpy((*members)[i]->full_name, PQgetvalue(res, i, 2), 100);
-        (*members)[i]->full_name[100] = '\0';
-        strncpy((*members)[i]->role, PQgetvalue(res, i, 3), 20);
-        (*members)[i]->role[20] = '\0';
-        strncpy((*members)[i]->status, PQgetvalue(res, i, 4), 20);
-        (*members)[i]->status[20] = '\0';
-        strncpy((*members)[i]->joined_at, PQgetvalue(res, i, 5), 63);
-        (*members)[i]->joined_at[63] = '\0';
+        MemberInfo *member = &(*members)[i];
+        member->user_id = db_get_int4(res, i, 0);
+        db_get_string(res, i, 1, member->username, sizeof(member->username));
+        db_get_string(res, i, 2, member->full_name, sizeof(member->full_name));
+        db_get_string(res, i, 3, member->role, sizeof(member->role));
+        db_get_string(res, i, 4, member->status, sizeof(member->status));
+        db_get_timestamp(res, i, 5, member->joined_at, sizeof(member->joined_at));
+        member->joined_us = db_get_int8(res, i, 5);
     }
     
     PQclear(res);
@@ -507,68 +711,47 @@ int db_get_group_members(int group_id, MemberInfo ***members) {
 }
 
 int db_request_join_group(int user_id, int group_id) {
+    PGconn *conn = db_conn();
     if (!conn) return -1;
     
-    char user_id_str[32], group_id_str[32];
-    sprintf(user_id_str, "%d", user_id);
-    sprintf(group_id_str, "%d", group_id);
-    
-    const char *paramValues[2] = {group_id_str, user_id_str};
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, user_id);
+    db_param_int4(&params, group_id);
     
-    // Check if already a member
-    PGresult *res = PQexecParams(conn,
-        "SELECT member_id FROM group_members WHERE group_id = $1 AND user_id = $2",
-        2, NULL, paramValues, NULL, NULL, 0);
+    // Membership check and insert run in one server-side call; the partial
+    // unique index keeps concurrent requests from both going in
+    PGresult *res = db_exec(conn, STMT_REQUEST_JOIN_GROUP, &params);
     
-    if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
-        PQclear(res);
-        return -2; // Already a member or request exists
-    }
-    PQclear(res);
-    
-    // Check if request already exists
-    res = PQexecParams(conn,
-        "SELECT request_id FROM join_requests WHERE group_id = $1 AND user_id = $2 AND status = 'pending'",
-        2, NULL, paramValues, NULL, NULL, 0);
-    
-    if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
-        PQclear(res);
-        return -3; // Request already pending
-    }
-    PQclear(res);
-    
-    // Create join request
-    res = PQexecParams(conn,
-        "INSERT INTO join_requests (group_id, user_id, status) VALUES ($1, $2, 'pending') RETURNING request_id",
-        2, NULL, paramValues, NULL, NULL, 0);
-    
-    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "INSERT join_request failed: %s", PQerrorMessage(conn));
+    if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
+        fprintf(stderr, "Join request failed: %s", PQerrorMessage(conn));
         PQclear(res);
         return -1;
     }
     
-    int request_id = atoi(PQgetvalue(res, 0, 0));
+    const char *outcome = db_get_text(res, 0, 0);
+    int result;
+    if (strcmp(outcome, "member") == 0) {
+        result = -2; // Already a member
+    } else if (strcmp(outcome, "pending") == 0) {
+        result = -3; // Request already pending
+    } else {
+        result = db_get_int4(res, 0, 1);
+    }
     PQclear(res);
     
-    return request_id;
+    return result;
 }
 
 int db_get_join_requests(int group_id, JoinRequestInfo ***requests) {
+    PGconn *conn = db_conn();
     if (!conn) return 0;
     
-    char group_id_str[32];
-    sprintf(group_id_str, "%d", group_id);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, group_id);
     
-    const char *paramValues[1] = {group_id_str};
-    
-    PGresult *res = PQexecParams(conn,
-        "SELECT jr.request_id, jr.group_id, jr.user_id, u.username, u.full_name, jr.status, jr.created_at "
-        "FROM join_requests jr "
-        "JOIN users u ON jr.user_id = u.user_id "
-        "WHERE jr.group_id = $1 AND jr.status = 'pending' "
-        "ORDER BY jr.created_at DESC",
-        1, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_GET_JOIN_REQUESTS, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         PQclear(res);
@@ -585,17 +768,16 @@ int db_get_join_requests(int group_id, JoinRequestInfo ***requests) {
     
     for (int i = 0; i < count; i++) {
         (*requests)[i] = (JoinRequestInfo*)malloc(sizeof(JoinRequestInfo));
-        (*requests)[i]->request_id = atoi(PQgetvalue(res, i, 0));
-        (*requests)[i]->group_id = atoi(PQgetvalue(res, i, 1));
-        (*requests)[i]->user_id = atoi(PQgetvalue(res, i, 2));
+        (*requests)[i]->request_id = db_get_int4(res, i, 0);
+        (*requests)[i]->group_id = db_get_int4(res, i, 1);
+        (*requests)[i]->user_id = db_get_int4(res, i, 2);
         strncpy((*requests)[i]->username, PQgetvalue(res, i, 3), 50);
         (*requests)[i]->username[50] = '\0';
         strncpy((*requests)[i]->full_name, PQgetvalue(res, i, 4), 100);
         (*requests)[i]->full_name[100] = '\0';
         strncpy((*requests)[i]->status, PQgetvalue(res, i, 5), 20);
         (*requests)[i]->status[20] = '\0';
-        strncpy((*requests)[i]->created_at, PQgetvalue(res, i, 6), 63);
-        (*requests)[i]->created_at[63] = '\0';
+        db_get_timestamp(res, i, 6, (*requests)[i]->created_at, sizeof((*requests)[i]->created_at));
     }
     
     PQclear(res);
@@ -603,19 +785,14 @@ int db_get_join_requests(int group_id, JoinRequestInfo ***requests) {
 }
 
 JoinRequestInfo* db_get_join_request_by_id(int request_id) {
+    PGconn *conn = db_conn();
     if (!conn) return NULL;
     
-    char request_id_str[32];
-    sprintf(request_id_str, "%d", request_id);
-    
-    const char *paramValues[1] = {request_id_str};
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, request_id);
     
-    PGresult *res = PQexecParams(conn,
-        "SELECT jr.request_id, jr.group_id, jr.user_id, u.username, u.full_name, jr.status, jr.created_at "
-        "FROM join_requests jr "
-        "JOIN users u ON jr.user_id = u.user_id "
-        "WHERE jr.request_id = $1",
-        1, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_GET_JOIN_REQUEST_BY_ID, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
         PQclear(res);
@@ -623,85 +800,84 @@ JoinRequestInfo* db_get_join_request_by_id(int request_id) {
     }
     
     JoinRequestInfo *info = (JoinRequestInfo*)malloc(sizeof(JoinRequestInfo));
-    info->request_id = atoi(PQgetvalue(res, 0, 0));
-    info->group_id = atoi(PQgetvalue(res, 0, 1));
-    info->user_id = atoi(PQgetvalue(res, 0, 2));
+    info->request_id = db_get_int4(res, 0, 0);
+    info->group_id = db_get_int4(res, 0, 1);
+    info->user_id = db_get_int4(res, 0, 2);
     strncpy(info->username, PQgetvalue(res, 0, 3), 50);
     info->username[50] = '\0';
     strncpy(info->full_name, PQgetvalue(res, 0, 4), 100);
     info->full_name[100] = '\0';
     strncpy(info->status, PQgetvalue(res, 0, 5), 20);
     info->status[20] = '\0';
-    strncpy(info->created_at, PQgetvalue(res, 0, 6), 63);
-    info->created_at[63] = '\0';
+    db_get_timestamp(res, 0, 6, info->created_at, sizeof(info->created_at));
     
     PQclear(res);
     return info;
 }
 
-int db_approve_join_request(int request_id, int reviewer_id, const char *action) {
+int db_approve_join_request(int request_id, int reviewer_id, const char *action, JoinRequestInfo *info) {
+    PGconn *conn = db_conn();
     if (!conn) return -1;
     
-    char request_id_str[32], reviewer_id_str[32];
-    sprintf(request_id_str, "%d", request_id);
-    sprintf(reviewer_id_str, "%d", reviewer_id);
+    int approve = strcmp(action, "approve") == 0;
     
-    // Get request info
-    JoinRequestInfo *info = db_get_join_request_by_id(request_id);
-    if (!info) return -1;
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, request_id);
+    db_param_int4(&params, reviewer_id);
+    db_param_bool(&params, approve);
     
-    int group_id = info->group_id;
-    int user_id = info->user_id;
+    // review_join_request locks the request, checks the reviewer and that it
+    // is still pending, then applies every effect in the same transaction
+    PGresult *res = db_exec(conn, STMT_REVIEW_JOIN_REQUEST, &params);
     
-    // Update request status
-    const char *status = (strcmp(action, "approve") == 0) ? "approved" : "rejected";
-    const char *paramValues[3] = {status, reviewer_id_str, request_id_str};
-    
-    PGresult *res = PQexecParams(conn,
-        "UPDATE join_requests SET status = $1, reviewed_at = CURRENT_TIMESTAMP, reviewed_by = $2 WHERE request_id = $3",
-        3, NULL, paramValues, NULL, NULL, 0);
-    
-    if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-        fprintf(stderr, "UPDATE join_request failed: %s", PQerrorMessage(conn));
+    if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
+        fprintf(stderr, "Review join request failed: %s", PQerrorMessage(conn));
         PQclear(res);
-        free(info);
         return -1;
     }
-    PQclear(res);
     
-    // If approved, add to group_members
-    if (strcmp(action, "approve") == 0) {
-        char group_id_str[32], user_id_str[32];
-        sprintf(group_id_str, "%d", group_id);
-        sprintf(user_id_str, "%d", user_id);
-        
-        const char *memberParams[2] = {group_id_str, user_id_str};
-        
-        res = PQexecParams(conn,
-            "INSERT INTO group_members (group_id, user_id, role, status) VALUES ($1, $2, 'member', 'approved')",
-            2, NULL, memberParams, NULL, NULL, 0);
-        PQclear(res);
-        
-        // Create default permissions
-        res = PQexecParams(conn,
-            "INSERT INTO permissions (group_id, user_id, can_read, can_write, can_delete, can_manage) "
-            "VALUES ($1, $2, TRUE, FALSE, FALSE, FALSE)",
-            2, NULL, memberParams, NULL, NULL, 0);
+    const char *outcome = db_get_text(res, 0, 0);
+    if (strcmp(outcome, "not_found") == 0) {
         PQclear(res);
+        return -2;
     }
     
-    free(info);
-    return 0;
+    memset(info, 0, sizeof(*info));
+    info->request_id = request_id;
+    info->group_id = db_get_int4(res, 0, 1);
+    info->user_id = db_get_int4(res, 0, 2);
+    db_get_string(res, 0, 3, info->username, sizeof(info->username));
+    db_get_string(res, 0, 4, info->status, sizeof(info->status));
+    
+    int result = 0;
+    if (strcmp(outcome, "forbidden") == 0) {
+        result = -3;
+    } else if (strcmp(outcome, "reviewed") == 0) {
+        result = -4;
+    } else if (approve) {
+        membership_cache_invalidate(info->user_id, info->group_id);
+        unread_cache_invalidate(info->user_id);
+        if (!PQgetisnull(res, 0, 5)) {
+            publish_permission(db_get_int4(res, 0, 5), info->user_id, info->group_id, PERM_READ);
+        }
+    }
+    PQclear(res);
+    
+    return result;
 }
 
 UserInfo* db_get_user_by_username(const char *username) {
+    if (!username_filter_may_exist(username)) return NULL;
+    
+    PGconn *conn = db_conn();
     if (!conn) return NULL;
     
-    const char *paramValues[1] = {username};
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, username);
     
-    PGresult *res = PQexecParams(conn,
-        "SELECT user_id, username, role, email, full_name FROM users WHERE username = $1",
-        1, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_GET_USER_BY_USERNAME, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
         PQclear(res);
@@ -709,7 +885,7 @@ UserInfo* db_get_user_by_username(const char *username) {
     }
     
     UserInfo *user = (UserInfo*)malloc(sizeof(UserInfo));
-    user->user_id = atoi(PQgetvalue(res, 0, 0));
+    user->user_id = db_get_int4(res, 0, 0);
     strncpy(user->username, PQgetvalue(res, 0, 1), 50);
     user->username[50] = '\0';
     strncpy(user->role, PQgetvalue(res, 0, 2), 20);
@@ -723,79 +899,54 @@ UserInfo* db_get_user_by_username(const char *username) {
     return user;
 }
 
-int db_invite_to_group(int inviter_id, int group_id, const char *invitee_username) {
-    if (!conn) return -1;
-    
-    // Get invitee user_id
-    UserInfo *invitee = db_get_user_by_username(invitee_username);
-    if (!invitee) return -2; // User not found
-    
-    int invitee_id = invitee->user_id;
-    free(invitee);
-    
-    char inviter_id_str[32], group_id_str[32], invitee_id_str[32];
-    sprintf(inviter_id_str, "%d", inviter_id);
-    sprintf(group_id_str, "%d", group_id);
-    sprintf(invitee_id_str, "%d", invitee_id);
-    
-    // Check if already a member
-    const char *checkParams[2] = {group_id_str, invitee_id_str};
-    PGresult *res = PQexecParams(conn,
-        "SELECT member_id FROM group_members WHERE group_id = $1 AND user_id = $2",
-        2, NULL, checkParams, NULL, NULL, 0);
+int db_invite_to_group(int inviter_id, int group_id, const char *invitee_username, int *invitee_id) {
+    if (!username_filter_may_exist(invitee_username)) return -2;
     
-    if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
-        PQclear(res);
-        return -3; // Already a member
-    }
-    PQclear(res);
+    PGconn *conn = db_conn();
+    if (!conn) return -1;
     
-    // Check if invitation already exists
-    res = PQexecParams(conn,
-        "SELECT invitation_id FROM group_invitations WHERE group_id = $1 AND invitee_id = $2 AND status = 'pending'",
-        2, NULL, checkParams, NULL, NULL, 0);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, inviter_id);
+    db_param_int4(&params, group_id);
+    db_param_text(&params, invitee_username);
     
-    if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
-        PQclear(res);
-        return -4; // Invitation already pending
-    }
-    PQclear(res);
-    
-    // Create invitation
-    const char *paramValues[3] = {group_id_str, inviter_id_str, invitee_id_str};
-    res = PQexecParams(conn,
-        "INSERT INTO group_invitations (group_id, inviter_id, invitee_id, status) VALUES ($1, $2, $3, 'pending') RETURNING invitation_id",
-        3, NULL, paramValues, NULL, NULL, 0);
+    // Invitee lookup, membership check and insert in one server-side call;
+    // the partial unique index keeps concurrent invitations from both going in
+    PGresult *res = db_exec(conn, STMT_INVITE_TO_GROUP, &params);
     
-    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "INSERT invitation failed: %s", PQerrorMessage(conn));
+    if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
+        fprintf(stderr, "Invitation failed: %s", PQerrorMessage(conn));
         PQclear(res);
         return -1;
     }
     
-    int invitation_id = atoi(PQgetvalue(res, 0, 0));
+    const char *outcome = db_get_text(res, 0, 0);
+    int result;
+    if (strcmp(outcome, "user_not_found") == 0) {
+        result = -2;
+    } else if (strcmp(outcome, "member") == 0) {
+        result = -3; // Already a member
+    } else if (strcmp(outcome, "pending") == 0) {
+        result = -4; // Invitation already pending
+    } else {
+        result = db_get_int4(res, 0, 1);
+        *invitee_id = db_get_int4(res, 0, 2);
+    }
     PQclear(res);
     
-    return invitation_id;
+    return result;
 }
 
 int db_get_user_invitations(int user_id, InvitationInfo ***invitations) {
+    PGconn *conn = db_conn();
     if (!conn) return 0;
     
-    char user_id_str[32];
-    sprintf(user_id_str, "%d", user_id);
-    
-    const char *paramValues[1] = {user_id_str};
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, user_id);
     
-    PGresult *res = PQexecParams(conn,
-        "SELECT gi.invitation_id, gi.group_id, g.group_name, gi.inviter_id, "
-        "u.username, u.full_name, gi.invitee_id, gi.status, gi.created_at "
-        "FROM group_invitations gi "
-        "JOIN groups g ON gi.group_id = g.group_id "
-        "JOIN users u ON gi.inviter_id = u.user_id "
-        "WHERE gi.invitee_id = $1 AND gi.status = 'pending' "
-        "ORDER BY gi.created_at DESC",
-        1, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_GET_USER_INVITATIONS, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         PQclear(res);
@@ -812,20 +963,19 @@ int db_get_user_invitations(int user_id, InvitationInfo ***invitations) {
     
     for (int i = 0; i < count; i++) {
         (*invitations)[i] = (InvitationInfo*)malloc(sizeof(InvitationInfo));
-        (*invitations)[i]->invitation_id = atoi(PQgetvalue(res, i, 0));
-        (*invitations)[i]->group_id = atoi(PQgetvalue(res, i, 1));
+        (*invitations)[i]->invitation_id = db_get_int4(res, i, 0);
+        (*invitations)[i]->group_id = db_get_int4(res, i, 1);
         strncpy((*invitations)[i]->group_name, PQgetvalue(res, i, 2), 100);
         (*invitations)[i]->group_name[100] = '\0';
-        (*invitations)[i]->inviter_id = atoi(PQgetvalue(res, i, 3));
+        (*invitations)[i]->inviter_id = db_get_int4(res, i, 3);
         strncpy((*invitations)[i]->inviter_username, PQgetvalue(res, i, 4), 50);
         (*invitations)[i]->inviter_username[50] = '\0';
         strncpy((*invitations)[i]->inviter_name, PQgetvalue(res, i, 5), 100);
         (*invitations)[i]->inviter_name[100] = '\0';
-        (*invitations)[i]->invitee_id = atoi(PQgetvalue(res, i, 6));
+        (*invitations)[i]->invitee_id = db_get_int4(res, i, 6);
         strncpy((*invitations)[i]->status, PQgetvalue(res, i, 7), 20);
         (*invitations)[i]->status[20] = '\0';
-        strncpy((*invitations)[i]->created_at, PQgetvalue(res, i, 8), 63);
-        (*invitations)[i]->created_at[63] = '\0';
+        db_get_timestamp(res, i, 8, (*invitations)[i]->created_at, sizeof((*invitations)[i]->created_at));
     }
     
     PQclear(res);
@@ -833,21 +983,14 @@ int db_get_user_invitations(int user_id, InvitationInfo ***invitations) {
 }
 
 InvitationInfo* db_get_invitation_by_id(int invitation_id) {
+    PGconn *conn = db_conn();
     if (!conn) return NULL;
     
-    char invitation_id_str[32];
-    sprintf(invitation_id_str, "%d", invitation_id);
-    
-    const char *paramValues[1] = {invitation_id_str};
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, invitation_id);
     
-    PGresult *res = PQexecParams(conn,
-        "SELECT gi.invitation_id, gi.group_id, g.group_name, gi.inviter_id, "
-        "u.username, u.full_name, gi.invitee_id, gi.status, gi.created_at "
-        "FROM group_invitations gi "
-        "JOIN groups g ON gi.group_id = g.group_id "
-        "JOIN users u ON gi.inviter_id = u.user_id "
-        "WHERE gi.invitation_id = $1",
-        1, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_GET_INVITATION_BY_ID, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
         PQclear(res);
@@ -855,91 +998,80 @@ InvitationInfo* db_get_invitation_by_id(int invitation_id) {
     }
     
     InvitationInfo *info = (InvitationInfo*)malloc(sizeof(InvitationInfo));
-    info->invitation_id = atoi(PQgetvalue(res, 0, 0));
-    info->group_id = atoi(PQgetvalue(res, 0, 1));
+    info->invitation_id = db_get_int4(res, 0, 0);
+    info->group_id = db_get_int4(res, 0, 1);
     strncpy(info->group_name, PQgetvalue(res, 0, 2), 100);
     info->group_name[100] = '\0';
-    info->inviter_id = atoi(PQgetvalue(res, 0, 3));
+    info->inviter_id = db_get_int4(res, 0, 3);
     strncpy(info->inviter_username, PQgetvalue(res, 0, 4), 50);
     info->inviter_username[50] = '\0';
     strncpy(info->inviter_name, PQgetvalue(res, 0, 5), 100);
     info->inviter_name[100] = '\0';
-    info->invitee_id = atoi(PQgetvalue(res, 0, 6));
+    info->invitee_id = db_get_int4(res, 0, 6);
     strncpy(info->status, PQgetvalue(res, 0, 7), 20);
     info->status[20] = '\0';
-    strncpy(info->created_at, PQgetvalue(res, 0, 8), 63);
-    info->created_at[63] = '\0';
+    db_get_timestamp(res, 0, 8, info->created_at, sizeof(info->created_at));
     
     PQclear(res);
     return info;
 }
 
-int db_respond_invitation(int invitation_id, const char *action) {
+int db_respond_invitation(int invitation_id, int user_id, const char *action, int *group_id) {
+    PGconn *conn = db_conn();
     if (!conn) return -1;
     
-    // Get invitation info
-    InvitationInfo *info = db_get_invitation_by_id(invitation_id);
-    if (!info) return -1;
+    int accept = strcmp(action, "accept") == 0;
     
-    int group_id = info->group_id;
-    int user_id = info->invitee_id;
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, invitation_id);
+    db_param_int4(&params, user_id);
+    db_param_bool(&params, accept);
     
-    // Update invitation status
-    char invitation_id_str[32];
-    sprintf(invitation_id_str, "%d", invitation_id);
-    const char *status = (strcmp(action, "accept") == 0) ? "accepted" : "rejected";
-    const char *paramValues[2] = {status, invitation_id_str};
+    // respond_invitation locks the invitation, checks it is the user's and
+    // still pending, then applies every effect in the same transaction
+    PGresult *res = db_exec(conn, STMT_RESPOND_INVITATION, &params);
     
-    PGresult *res = PQexecParams(conn,
-        "UPDATE group_invitations SET status = $1 WHERE invitation_id = $2",
-        2, NULL, paramValues, NULL, NULL, 0);
-    
-    if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-        fprintf(stderr, "UPDATE invitation failed: %s", PQerrorMessage(conn));
+    if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
+        fprintf(stderr, "Respond invitation failed: %s", PQerrorMessage(conn));
         PQclear(res);
-        free(info);
         return -1;
     }
-    PQclear(res);
     
-    // If accepted, add to group_members
-    if (strcmp(action, "accept") == 0) {
-        char group_id_str[32], user_id_str[32];
-        sprintf(group_id_str, "%d", group_id);
-        sprintf(user_id_str, "%d", user_id);
-        
-        const char *memberParams[2] = {group_id_str, user_id_str};
-        
-        res = PQexecParams(conn,
-            "INSERT INTO group_members (group_id, user_id, role, status) VALUES ($1, $2, 'member', 'approved')",
-            2, NULL, memberParams, NULL, NULL, 0);
-        PQclear(res);
-        
-        // Create default permissions
-        res = PQexecParams(conn,
-            "INSERT INTO permissions (group_id, user_id, can_read, can_write, can_delete, can_manage) "
-            "VALUES ($1, $2, TRUE, FALSE, FALSE, FALSE)",
-            2, NULL, memberParams, NULL, NULL, 0);
-        PQclear(res);
+    const char *outcome = db_get_text(res, 0, 0);
+    int result = 0;
+    if (strcmp(outcome, "not_found") == 0) {
+        result = -2;
+    } else if (strcmp(outcome, "forbidden") == 0) {
+        result = -3;
+    } else if (strcmp(outcome, "responded") == 0) {
+        result = -4;
+    } else {
+        *group_id = db_get_int4(res, 0, 1);
+        if (accept) {
+            membership_cache_invalidate(user_id, *group_id);
+            unread_cache_invalidate(user_id);
+            if (!PQgetisnull(res, 0, 2)) {
+                publish_permission(db_get_int4(res, 0, 2), user_id, *group_id, PERM_READ);
+            }
+        }
     }
+    PQclear(res);
     
-    free(info);
-    return 0;
+    return result;
 }
 
 int db_leave_group(int user_id, int group_id) {
+    PGconn *conn = db_conn();
     if (!conn) return -1;
     
-    char user_id_str[32], group_id_str[32];
-    sprintf(user_id_str, "%d", user_id);
-    sprintf(group_id_str, "%d", group_id);
-    
-    const char *paramValues[2] = {group_id_str, user_id_str};
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, group_id);
+    db_param_int4(&params, user_id);
     
     // Delete from group_members
-    PGresult *res = PQexecParams(conn,
-        "DELETE FROM group_members WHERE group_id = $1 AND user_id = $2",
-        2, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_DELETE_MEMBERSHIP, &params);
     
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "DELETE member failed: %s", PQerrorMessage(conn));
@@ -947,29 +1079,31 @@ int db_leave_group(int user_id, int group_id) {
         return -1;
     }
     PQclear(res);
+    membership_cache_invalidate(user_id, group_id);
+    // The group's notifications no longer count towards the user's unread count
+    unread_cache_invalidate(user_id);
     
     // Delete permissions
-    res = PQexecParams(conn,
-        "DELETE FROM permissions WHERE group_id = $1 AND user_id = $2",
-        2, NULL, paramValues, NULL, NULL, 0);
+    res = db_exec(conn, STMT_DELETE_PERMISSIONS, &params);
+    if (PQresultStatus(res) == PGRES_COMMAND_OK) {
+        permission_table_remove(user_id, group_id);
+    }
     PQclear(res);
     
     return 0;
 }
 
 int db_remove_member(int group_id, int target_user_id) {
+    PGconn *conn = db_conn();
     if (!conn) return -1;
     
-    char group_id_str[32], target_user_id_str[32];
-    sprintf(group_id_str, "%d", group_id);
-    sprintf(target_user_id_str, "%d", target_user_id);
-    
-    const char *paramValues[2] = {group_id_str, target_user_id_str};
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, group_id);
+    db_param_int4(&params, target_user_id);
     
     // Delete from group_members
-    PGresult *res = PQexecParams(conn,
-        "DELETE FROM group_members WHERE group_id = $1 AND user_id = $2",
-        2, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_DELETE_MEMBERSHIP, &params);
     
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "DELETE member failed: %s", PQerrorMessage(conn));
@@ -977,11 +1111,15 @@ int db_remove_member(int group_id, int target_user_id) {
         return -1;
     }
     PQclear(res);
+    membership_cache_invalidate(target_user_id, group_id);
+    // The group's notifications no longer count towards the user's unread count
+    unread_cache_invalidate(target_user_id);
     
     // Delete permissions
-    res = PQexecParams(conn,
-        "DELETE FROM permissions WHERE group_id = $1 AND user_id = $2",
-        2, NULL, paramValues, NULL, NULL, 0);
+    res = db_exec(conn, STMT_DELETE_PERMISSIONS, &params);
+    if (PQresultStatus(res) == PGRES_COMMAND_OK) {
+        permission_table_remove(target_user_id, group_id);
+    }
     PQclear(res);
     
     return 0;
@@ -989,12 +1127,9 @@ int db_remove_member(int group_id, int target_user_id) {
 
 // Directory operations
 int db_create_directory(int group_id, const char *directory_name, const char *parent_path, int created_by_user_id) {
+    PGconn *conn = db_conn();
     if (!conn || !directory_name || !parent_path) return -1;
     
-    char group_id_str[32], user_id_str[32];
-    sprintf(group_id_str, "%d", group_id);
-    sprintf(user_id_str, "%d", created_by_user_id);
-    
     // Build full directory path
     char directory_path[512];
     if (parent_path[strlen(parent_path) - 1] == '/') {
@@ -1003,12 +1138,14 @@ int db_create_directory(int group_id, const char *directory_name, const char *pa
         sprintf(directory_path, "%s/%s", parent_path, directory_name);
     }
     
-    const char *paramValues[4] = {directory_name, directory_path, group_id_str, user_id_str};
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, directory_name);
+    db_param_text(&params, directory_path);
+    db_param_int4(&params, group_id);
+    db_param_int4(&params, created_by_user_id);
     
-    PGresult *res = PQexecParams(conn,
-        "INSERT INTO directories (directory_name, directory_path, group_id, created_by) "
-        "VALUES ($1, $2, $3, $4) RETURNING directory_id",
-        4, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_CREATE_DIRECTORY, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "INSERT directory failed: %s", PQerrorMessage(conn));
@@ -1016,27 +1153,21 @@ int db_create_directory(int group_id, const char *directory_name, const char *pa
         return -1;
     }
     
-    int directory_id = atoi(PQgetvalue(res, 0, 0));
+    int directory_id = db_get_int4(res, 0, 0);
     PQclear(res);
     
     return directory_id;
 }
 
 DirectoryInfo* db_get_directory_by_id(int directory_id) {
+    PGconn *conn = db_conn();
     if (!conn) return NULL;
     
-    char directory_id_str[32];
-    sprintf(directory_id_str, "%d", directory_id);
-    
-    const char *paramValues[1] = {directory_id_str};
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, directory_id);
     
-    PGresult *res = PQexecParams(conn,
-        "SELECT d.directory_id, d.directory_name, d.directory_path, d.group_id, u.username, "
-        "TO_CHAR(d.created_at, 'YYYY-MM-DD\"T\"HH24:MI:SS\"Z\"') "
-        "FROM directories d "
-        "LEFT JOIN users u ON d.created_by = u.user_id "
-        "WHERE d.directory_id = $1",
-        1, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_GET_DIRECTORY_BY_ID, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
         PQclear(res);
@@ -1044,10 +1175,10 @@ DirectoryInfo* db_get_directory_by_id(int directory_id) {
     }
     
     DirectoryInfo *dir = (DirectoryInfo*)malloc(sizeof(DirectoryInfo));
-    dir->directory_id = atoi(PQgetvalue(res, 0, 0));
+    dir->directory_id = db_get_int4(res, 0, 0);
     strncpy(dir->directory_name, PQgetvalue(res, 0, 1), 255);
     strncpy(dir->directory_path, PQgetvalue(res, 0, 2), 511);
-    dir->group_id = atoi(PQgetvalue(res, 0, 3));
+    dir->group_id = db_get_int4(res, 0, 3);
     strncpy(dir->created_by, PQgetvalue(res, 0, 4), 50);
     strncpy(dir->created_at, PQgetvalue(res, 0, 5), 63);
     
@@ -1056,6 +1187,7 @@ DirectoryInfo* db_get_directory_by_id(int directory_id) {
 }
 
 int db_rename_directory(int directory_id, const char *new_name) {
+    PGconn *conn = db_conn();
     if (!conn || !new_name) return -1;
     
     DirectoryInfo *old_dir = db_get_directory_by_id(directory_id);
@@ -1071,28 +1203,31 @@ int db_rename_directory(int directory_id, const char *new_name) {
     if (strlen(parent_path) > 0) sprintf(new_path, "%s/%s", parent_path, new_name);
     else strcpy(new_path, new_name);
     
-    char directory_id_str[32];
-    sprintf(directory_id_str, "%d", directory_id);
-    const char *paramValues[3] = {new_name, new_path, directory_id_str};
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, new_name);
+    db_param_text(&params, new_path);
+    db_param_int4(&params, directory_id);
     
-    PGresult *res = PQexecParams(conn,
-        "UPDATE directories SET directory_name = $1, directory_path = $2 WHERE directory_id = $3",
-        3, NULL, paramValues, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_RENAME_DIRECTORY, &params);
     int success = (PQresultStatus(res) == PGRES_COMMAND_OK);
     PQclear(res);
     
     if (success) {
         char old_path_pattern[520];
         sprintf(old_path_pattern, "%s/%%", old_dir->directory_path);
-        res = PQexecParams(conn,
-            "UPDATE directories SET directory_path = $1 || SUBSTRING(directory_path FROM $2) "
-            "WHERE directory_path LIKE $3",
-            3, NULL, (const char*[]){new_path, "LENGTH($2) + 1", old_path_pattern}, NULL, NULL, 0);
+        
+        // Keep everything after the old prefix: SUBSTRING is 1-based
+        DbParams rebaseParams;
+        db_params_init(&rebaseParams);
+        db_param_text(&rebaseParams, new_path);
+        db_param_int4(&rebaseParams, (int)strlen(old_dir->directory_path) + 1);
+        db_param_text(&rebaseParams, old_path_pattern);
+        
+        res = db_exec(conn, STMT_REBASE_SUBDIRECTORIES, &rebaseParams);
         PQclear(res);
         
-        res = PQexecParams(conn,
-            "UPDATE files SET file_path = $1 || SUBSTRING(file_path FROM $2) WHERE file_path LIKE $3",
-            3, NULL, (const char*[]){new_path, "LENGTH($2) + 1", old_path_pattern}, NULL, NULL, 0);
+        res = db_exec(conn, STMT_REBASE_FILES, &rebaseParams);
         PQclear(res);
     }
     
@@ -1101,37 +1236,37 @@ int db_rename_directory(int directory_id, const char *new_name) {
 }
 
 int db_delete_directory(int directory_id, int *deleted_files, int *deleted_subdirs) {
+    PGconn *conn = db_conn();
     if (!conn) return -1;
     
     DirectoryInfo *dir = db_get_directory_by_id(directory_id);
     if (!dir) return -1;
     
-    char directory_id_str[32];
-    sprintf(directory_id_str, "%d", directory_id);
-    
     char path_pattern[520];
     sprintf(path_pattern, "%s/%%", dir->directory_path);
     
-    PGresult *res = PQexecParams(conn,
-        "SELECT COUNT(*) FROM files WHERE file_path LIKE $1 OR file_path = $2",
-        2, NULL, (const char*[]){path_pattern, dir->directory_path}, NULL, NULL, 0);
-    if (deleted_files) *deleted_files = (PQresultStatus(res) == PGRES_TUPLES_OK) ? atoi(PQgetvalue(res, 0, 0)) : 0;
+    DbParams fileParams;
+    db_params_init(&fileParams);
+    db_param_text(&fileParams, path_pattern);
+    db_param_text(&fileParams, dir->directory_path);
+    
+    PGresult *res = db_exec(conn, STMT_COUNT_FILES_UNDER_PATH, &fileParams);
+    if (deleted_files) *deleted_files = (PQresultStatus(res) == PGRES_TUPLES_OK) ? (int)db_get_int8(res, 0, 0) : 0;
     PQclear(res);
     
-    res = PQexecParams(conn,
-        "DELETE FROM files WHERE file_path LIKE $1 OR file_path = $2",
-        2, NULL, (const char*[]){path_pattern, dir->directory_path}, NULL, NULL, 0);
+    res = db_exec(conn, STMT_DELETE_FILES_UNDER_PATH, &fileParams);
     PQclear(res);
     
-    res = PQexecParams(conn,
-        "SELECT COUNT(*) FROM directories WHERE directory_path LIKE $1",
-        1, NULL, (const char*[]){path_pattern}, NULL, NULL, 0);
-    if (deleted_subdirs) *deleted_subdirs = (PQresultStatus(res) == PGRES_TUPLES_OK) ? atoi(PQgetvalue(res, 0, 0)) : 0;
+    DbParams dirParams;
+    db_params_init(&dirParams);
+    db_param_text(&dirParams, path_pattern);
+    
+    res = db_exec(conn, STMT_COUNT_SUBDIRECTORIES, &dirParams);
+    if (deleted_subdirs) *deleted_subdirs = (PQresultStatus(res) == PGRES_TUPLES_OK) ? (int)db_get_int8(res, 0, 0) : 0;
     PQclear(res);
     
-    res = PQexecParams(conn,
-        "DELETE FROM directories WHERE directory_path LIKE $1 OR directory_id = $2",
-        2, NULL, (const char*[]){path_pattern, directory_id_str}, NULL, NULL, 0);
+    db_param_int4(&dirParams, directory_id);
+    res = db_exec(conn, STMT_DELETE_DIRECTORY_TREE, &dirParams);
     int success = (PQresultStatus(res) == PGRES_COMMAND_OK);
     PQclear(res);
     
@@ -1140,6 +1275,7 @@ int db_delete_directory(int directory_id, int *deleted_files, int *deleted_subdi
 }
 
 int db_copy_directory(int directory_id, const char *destination_path, int user_id) {
+    PGconn *conn = db_conn();
     if (!conn || !destination_path) return -1;
     
     DirectoryInfo *source = db_get_directory_by_id(directory_id);
@@ -1151,6 +1287,7 @@ int db_copy_directory(int directory_id, const char *destination_path, int user_i
 }
 
 int db_move_directory(int directory_id, const char *destination_path, int *affected_files, int *affected_subdirs) {
+    PGconn *conn = db_conn();
     if (!conn || !destination_path) return -1;
     
     DirectoryInfo *dir = db_get_directory_by_id(directory_id);
@@ -1160,26 +1297,27 @@ int db_move_directory(int directory_id, const char *destination_path, int *affec
     if (destination_path[strlen(destination_path) - 1] == '/') sprintf(new_path, "%s%s", destination_path, dir->directory_name);
     else sprintf(new_path, "%s/%s", destination_path, dir->directory_name);
     
-    char directory_id_str[32];
-    sprintf(directory_id_str, "%d", directory_id);
     char old_path_pattern[520];
     sprintf(old_path_pattern, "%s/%%", dir->directory_path);
     
-    PGresult *res = PQexecParams(conn,
-        "UPDATE directories SET directory_path = $1 WHERE directory_id = $2",
-        2, NULL, (const char*[]){new_path, directory_id_str}, NULL, NULL, 0);
+    DbParams params;
+    db_params_init(&params);
+    db_param_text(&params, new_path);
+    db_param_int4(&params, directory_id);
+    
+    PGresult *res = db_exec(conn, STMT_MOVE_DIRECTORY, &params);
     PQclear(res);
     
-    res = PQexecParams(conn,
-        "SELECT COUNT(*) FROM directories WHERE directory_path LIKE $1",
-        1, NULL, (const char*[]){old_path_pattern}, NULL, NULL, 0);
-    if (affected_subdirs) *affected_subdirs = (PQresultStatus(res) == PGRES_TUPLES_OK) ? atoi(PQgetvalue(res, 0, 0)) : 0;
+    DbParams patternParams;
+    db_params_init(&patternParams);
+    db_param_text(&patternParams, old_path_pattern);
+    
+    res = db_exec(conn, STMT_COUNT_SUBDIRECTORIES, &patternParams);
+    if (affected_subdirs) *affected_subdirs = (PQresultStatus(res) == PGRES_TUPLES_OK) ? (int)db_get_int8(res, 0, 0) : 0;
     PQclear(res);
     
-    res = PQexecParams(conn,
-        "SELECT COUNT(*) FROM files WHERE file_path LIKE $1",
-        1, NULL, (const char*[]){old_path_pattern}, NULL, NULL, 0);
-    if (affected_files) *affected_files = (PQresultStatus(res) == PGRES_TUPLES_OK) ? atoi(PQgetvalue(res, 0, 0)) : 0;
+    res = db_exec(conn, STMT_COUNT_FILES_LIKE, &patternParams);
+    if (affected_files) *affected_files = (PQresultStatus(res) == PGRES_TUPLES_OK) ? (int)db_get_int8(res, 0, 0) : 0;
     PQclear(res);
     
     int success = 0;
@@ -1188,154 +1326,198 @@ int db_move_directory(int directory_id, const char *destination_path, int *affec
 }
 
 
-char* db_get_group_name_by_id(int group_id) {
-    const char *query = "SELECT group_name FROM groups WHERE group_id = $1";
-    const char *params[1];
-    char group_id_str[32];
-    snprintf(group_id_str, sizeof(group_id_str), "%d", group_id);
-    params[0] = group_id_str;
+// Looks a name up in the name cache, loading it with stmt on a miss
+static const char *db_lookup_name(NameKind kind, DbStatement stmt, int id) {
+    unsigned long long version;
+    const char *name = name_cache_get(kind, id, &version);
+    if (name) return name;
     
-    PGresult *res = PQexecParams(conn, query, 1, NULL, params, NULL, NULL, 0);
+    PGconn *conn = db_conn();
+    if (!conn) return NULL;
+    
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, id);
+    
+    PGresult *res = db_exec(conn, stmt, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
         PQclear(res);
         return NULL;
     }
     
-    char *group_name = strdup(PQgetvalue(res, 0, 0));
+    name = name_cache_fill(kind, id, db_get_text(res, 0, 0), version);
     PQclear(res);
-    return group_name;
+    return name;
+}
+
+const char* db_get_group_name_by_id(int group_id) {
+    return db_lookup_name(NAME_GROUP, STMT_GET_GROUP_NAME, group_id);
+}
+
+const char* db_get_username_by_id(int user_id) {
+    return db_lookup_name(NAME_USER, STMT_GET_USERNAME, user_id);
 }
 
-char* db_get_username_by_id(int user_id) {
-    const char *query = "SELECT username FROM users WHERE user_id = $1";
-    const char *params[1];
-    char user_id_str[32];
-    snprintf(user_id_str, sizeof(user_id_str), "%d", user_id);
-    params[0] = user_id_str;
+void db_release_name(const char *name) {
+    name_release(name);
+}
+
+int db_create_notification(int user_id, const char *type, const char *title,
+                          const char *message, const char *related_type,
+                          int related_id) {
+    PGconn *conn = db_conn();
+    if (!conn) return -1;
     
-    PGresult *res = PQexecParams(conn, query, 1, NULL, params, NULL, NULL, 0);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, user_id);
+    db_param_text(&params, type);
+    db_param_text(&params, title);
+    db_param_text(&params, message);
+    db_param_text(&params, related_type);
+    db_param_int4(&params, related_id);
     
-    if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
+    PGresult *res = db_exec(conn, STMT_CREATE_NOTIFICATION, &params);
+    
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        fprintf(stderr, "Create notification failed: %s\n", PQerrorMessage(conn));
         PQclear(res);
-        return NULL;
+        return -1;
     }
     
-    char *username = strdup(PQgetvalue(res, 0, 0));
+    int notification_id = db_get_int4(res, 0, 0);
     PQclear(res);
-    return username;
+    return notification_id;
 }
 
-int db_get_group_admin_ids(int group_id, int **admin_ids) {
-    const char *query = 
-        "SELECT user_id FROM group_members "
-        "WHERE group_id = $1 AND role = 'admin' AND status = 'approved'";
+int db_notify_group_admins(int group_id, const char *type, const char *title,
+                           const char *message, const char *related_type,
+                           int related_id) {
+    PGconn *conn = db_conn();
+    if (!conn) return -1;
     
-    const char *params[1];
-    char group_id_str[32];
-    snprintf(group_id_str, sizeof(group_id_str), "%d", group_id);
-    params[0] = group_id_str;
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, group_id);
+    db_param_text(&params, type);
+    db_param_text(&params, title);
+    db_param_text(&params, message);
+    db_param_text(&params, related_type);
+    db_param_int4(&params, related_id);
     
-    PGresult *res = PQexecParams(conn, query, 1, NULL, params, NULL, NULL, 0);
+    // One INSERT ... SELECT over the admin set instead of a round trip per admin
+    PGresult *res = db_exec(conn, STMT_NOTIFY_GROUP_ADMINS, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        fprintf(stderr, "Notify group admins failed: %s\n", PQerrorMessage(conn));
         PQclear(res);
-        return 0;
-    }
-    
-    int count = PQntuples(res);
-    if (count == 0) {
-        PQclear(res);
-        *admin_ids = NULL;
-        return 0;
-    }
-    
-    *admin_ids = malloc(sizeof(int) * count);
-    for (int i = 0; i < count; i++) {
-        (*admin_ids)[i] = atoi(PQgetvalue(res, i, 0));
+        return -1;
     }
     
+    int created = PQntuples(res);
     PQclear(res);
-    return count;
+    return created;
 }
 
-int db_create_notification(int user_id, const char *type, const char *title,
-                          const char *message, const char *related_type,
-                          int related_id) {
-    const char *query = 
-        "INSERT INTO notifications (user_id, type, title, message, related_type, related_id) "
-        "VALUES ($1, $2, $3, $4, $5, $6) RETURNING notification_id";
-    
-    const char *params[6];
-    char user_id_str[32], related_id_str[32];
-    snprintf(user_id_str, sizeof(user_id_str), "%d", user_id);
-    snprintf(related_id_str, sizeof(related_id_str), "%d", related_id);
+int db_create_group_notification(int group_id, const char *type, const char *title,
+                                 const char *message, const char *related_type,
+                                 int related_id) {
+    PGconn *conn = db_conn();
+    if (!conn) return -1;
     
-    params[0] = user_id_str;
-    params[1] = type;
-    params[2] = title;
-    params[3] = message;
-    params[4] = related_type;
-    params[5] = related_id_str;
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, group_id);
+    db_param_text(&params, type);
+    db_param_text(&params, title);
+    db_param_text(&params, message);
+    db_param_text(&params, related_type);
+    db_param_int4(&params, related_id);
     
-    PGresult *res = PQexecParams(conn, query, 6, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_CREATE_GROUP_NOTIFICATION, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "Create notification failed: %s\n", PQerrorMessage(conn));
+        fprintf(stderr, "Create group notification failed: %s\n", PQerrorMessage(conn));
         PQclear(res);
         return -1;
     }
     
-    int notification_id = atoi(PQgetvalue(res, 0, 0));
+    int notification_id = db_get_int4(res, 0, 0);
     PQclear(res);
     return notification_id;
 }
 
-int db_get_user_notifications(int user_id, NotificationInfo ***notifications) {
-    const char *query = 
-        "SELECT notification_id, user_id, type, title, message, "
-        "related_type, related_id, is_read, created_at "
-        "FROM notifications "
-        "WHERE user_id = $1 "
-        "ORDER BY created_at DESC "
-        "LIMIT 50";
+int db_get_user_notifications(int user_id, const NotificationCursor *before, const NotificationCursor *after,
+                              int unread_only, int limit, NotificationInfo **notifications, int *has_more) {
+    *notifications = NULL;
+    *has_more = 0;
     
-    const char *params[1];
-    char user_id_str[32];
-    snprintf(user_id_str, sizeof(user_id_str), "%d", user_id);
-    params[0] = user_id_str;
+    PGconn *conn = db_conn();
+    if (!conn) return -1;
+    
+    // Rows at exactly the cursor's created_at are split by the id bounds:
+    // group rows sort above personal ones, so a group cursor keeps every
+    // personal row on the older side and a personal cursor every group row on
+    // the newer side.
+    const NotificationCursor *cursor = after ? after : before;
+    long long created_us = KEYSET_NEWEST_US;
+    int personal_bound = INT_MAX;
+    int group_bound = INT_MAX;
+    if (cursor) {
+        created_us = cursor->created_us;
+        personal_bound = cursor->group_id > 0 ? INT_MAX : cursor->notification_id;
+        group_bound = cursor->group_id > 0 ? cursor->notification_id : 0;
+    }
     
-    PGresult *res = PQexecParams(conn, query, 1, NULL, params, NULL, NULL, 0);
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, user_id);
+    db_param_int8(&params, created_us);
+    db_param_int4(&params, personal_bound);
+    db_param_int4(&params, group_bound);
+    db_param_bool(&params, unread_only);
+    db_param_int4(&params, limit + 1);     // One extra row tells whether there is more
+    
+    PGresult *res = db_exec(conn, after ? STMT_GET_NOTIFICATIONS_AFTER : STMT_GET_NOTIFICATIONS_BEFORE, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "Get notifications failed: %s\n", PQerrorMessage(conn));
         PQclear(res);
-        return 0;
+        return -1;
     }
     
     int count = PQntuples(res);
+    if (count > limit) {
+        count = limit;
+        *has_more = 1;
+    }
     if (count == 0) {
         PQclear(res);
-        *notifications = NULL;
         return 0;
     }
     
-    *notifications = malloc(sizeof(NotificationInfo*) * count);
+    *notifications = calloc(count, sizeof(NotificationInfo));
+    if (!*notifications) {
+        PQclear(res);
+        return -1;
+    }
     
     for (int i = 0; i < count; i++) {
-        NotificationInfo *notif = malloc(sizeof(NotificationInfo));
-        
-        notif->notification_id = atoi(PQgetvalue(res, i, 0));
-        notif->user_id = atoi(PQgetvalue(res, i, 1));
-        strncpy(notif->type, PQgetvalue(res, i, 2), sizeof(notif->type) - 1);
-        strncpy(notif->title, PQgetvalue(res, i, 3), sizeof(notif->title) - 1);
-        strncpy(notif->message, PQgetvalue(res, i, 4), sizeof(notif->message) - 1);
-        strncpy(notif->related_type, PQgetvalue(res, i, 5), sizeof(notif->related_type) - 1);
-        notif->related_id = atoi(PQgetvalue(res, i, 6));
-        notif->is_read = strcmp(PQgetvalue(res, i, 7), "t") == 0 ? 1 : 0;
-        strncpy(notif->created_at, PQgetvalue(res, i, 8), sizeof(notif->created_at) - 1);
+        // Newer pages come back oldest first
+        NotificationInfo *notif = &(*notifications)[after ? count - 1 - i : i];
         
-        (*notifications)[i] = notif;
+        notif->notification_id = db_get_int4(res, i, 0);
+        notif->user_id = user_id;
+        notif->group_id = db_get_int4(res, i, 1);
+        db_get_string(res, i, 2, notif->type, sizeof(notif->type));
+        db_get_string(res, i, 3, notif->title, sizeof(notif->title));
+        db_get_string(res, i, 4, notif->message, sizeof(notif->message));
+        db_get_string(res, i, 5, notif->related_type, sizeof(notif->related_type));
+        notif->related_id = db_get_int4(res, i, 6);
+        notif->is_read = db_get_bool(res, i, 7);
+        db_get_timestamp(res, i, 8, notif->created_at, sizeof(notif->created_at));
+        notif->created_us = db_get_int8(res, i, 8);
     }
     
     PQclear(res);
@@ -1343,19 +1525,15 @@ int db_get_user_notifications(int user_id, NotificationInfo ***notifications) {
 }
 
 int db_mark_notification_read(int user_id, int notification_id) {
-    const char *query = 
-        "UPDATE notifications "
-        "SET is_read = TRUE, read_at = CURRENT_TIMESTAMP "
-        "WHERE notification_id = $1 AND user_id = $2";
+    PGconn *conn = db_conn();
+    if (!conn) return -1;
     
-    const char *params[2];
-    char notification_id_str[32], user_id_str[32];
-    snprintf(notification_id_str, sizeof(notification_id_str), "%d", notification_id);
-    snprintf(user_id_str, sizeof(user_id_str), "%d", user_id);
-    params[0] = notification_id_str;
-    params[1] = user_id_str;
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, notification_id);
+    db_param_int4(&params, user_id);
     
-    PGresult *res = PQexecParams(conn, query, 2, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_MARK_NOTIFICATION_READ, &params);
     
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "Mark notification read failed: %s\n", PQerrorMessage(conn));
@@ -1363,82 +1541,136 @@ int db_mark_notification_read(int user_id, int notification_id) {
         return -1;
     }
     
+    // Only a row that was still unread moved the counter
+    if (atoi(PQcmdTuples(res)) > 0) {
+        unread_cache_add(user_id, -1);
+    }
+    
     PQclear(res);
     return 0;
 }
 
-int db_mark_all_notifications_read(int user_id) {
-    const char *query = 
-        "UPDATE notifications "
-        "SET is_read = TRUE, read_at = CURRENT_TIMESTAMP "
-        "WHERE user_id = $1 AND is_read = FALSE";
+int db_mark_group_notification_read(int user_id, int group_notification_id) {
+    PGconn *conn = db_conn();
+    if (!conn) return -1;
     
-    const char *params[1];
-    char user_id_str[32];
-    snprintf(user_id_str, sizeof(user_id_str), "%d", user_id);
-    params[0] = user_id_str;
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, group_notification_id);
+    db_param_int4(&params, user_id);
     
-    PGresult *res = PQexecParams(conn, query, 1, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_MARK_GROUP_NOTIFICATION_READ, &params);
     
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+        fprintf(stderr, "Mark group notification read failed: %s\n", PQerrorMessage(conn));
         PQclear(res);
         return -1;
     }
     
+    // The cursor may have skipped several notifications at once
+    if (atoi(PQcmdTuples(res)) > 0) {
+        unread_cache_invalidate(user_id);
+    }
+    
     PQclear(res);
     return 0;
 }
 
+int db_mark_all_notifications_read(int user_id) {
+    PGconn *conn = db_conn();
+    if (!conn) return -1;
+    
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, user_id);
+    
+    // Personal rows, then every group cursor moved to its newest notification
+    DbBatch batch;
+    db_batch_init(&batch, conn);
+    db_batch_add(&batch, STMT_MARK_ALL_NOTIFICATIONS_READ, &params);
+    db_batch_add(&batch, STMT_MARK_ALL_GROUP_NOTIFICATIONS_READ, &params);
+    
+    int success = db_batch_run(&batch);
+    if (!success) {
+        fprintf(stderr, "Mark all notifications read failed at step %d\n", batch.failed_step);
+    }
+    unread_cache_invalidate(user_id);
+    
+    db_batch_clear(&batch);
+    return success ? 0 : -1;
+}
+
+// Personal counts come from notification_counters and group counts from the
+// cursors, both kept current by triggers (database.sql), so a miss costs one
+// row per group the user is in. The group rows are cached as they are: group
+// notifications then only move the group's seq in the cache.
 int db_get_unread_notification_count(int user_id) {
-    const char *query = 
-        "SELECT COUNT(*) FROM notifications "
-        "WHERE user_id = $1 AND is_read = FALSE";
+    int count;
+    unsigned long long version;
+    if (unread_cache_get(user_id, &count, &version)) {
+        return count;
+    }
+    
+    PGconn *conn = db_conn();
+    if (!conn) return 0;
     
-    const char *params[1];
-    char user_id_str[32];
-    snprintf(user_id_str, sizeof(user_id_str), "%d", user_id);
-    params[0] = user_id_str;
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, user_id);
     
-    PGresult *res = PQexecParams(conn, query, 1, NULL, params, NULL, NULL, 0);
+    PGresult *res = db_exec(conn, STMT_COUNT_UNREAD_NOTIFICATIONS, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         PQclear(res);
         return 0;
     }
     
-    int count = atoi(PQgetvalue(res, 0, 0));
+    // The personal row (group 0) comes first, then one per group
+    int rows = PQntuples(res);
+    int personal = 0;
+    UnreadGroup *groups = rows > 1 ? malloc((rows - 1) * sizeof(UnreadGroup)) : NULL;
+    int group_count = 0;
+    count = 0;
+    for (int i = 0; i < rows; i++) {
+        int group_id = db_get_int4(res, i, 0);
+        if (group_id == 0) {
+            personal = db_get_int4(res, i, 1);
+            count += personal;
+            continue;
+        }
+        int last_read_seq = db_get_int4(res, i, 1);
+        int last_seq = db_get_int4(res, i, 2);
+        if (last_seq > last_read_seq) count += last_seq - last_read_seq;
+        if (groups) {
+            groups[group_count].group_id = group_id;
+            groups[group_count].last_read_seq = last_read_seq;
+            groups[group_count].last_seq = last_seq;
+            group_count++;
+        }
+    }
     PQclear(res);
+    
+    // Without the group rows the count could not follow group notifications
+    if (groups || rows <= 1) unread_cache_fill(user_id, personal, groups, group_count, version);
+    free(groups);
     return count;
 }
 
-int db_get_available_groups(int user_id, GroupInfo ***groups) {
-    const char *query = 
-        "SELECT g.group_id, g.group_name, g.description, g.created_at, "
-        "       (SELECT COUNT(*) FROM group_members WHERE group_id = g.group_id AND status = 'active') as member_count "
-        "FROM groups g "
-        "WHERE g.group_id NOT IN ( "
-        "    SELECT group_id FROM group_members "
-        "    WHERE user_id = $1 "
-        "    AND status IN ('active', 'pending') "
-        ") "
-        "AND g.group_id NOT IN ( "
-        "    SELECT group_id FROM join_requests "
-        "    WHERE user_id = $1 "
-        "    AND status = 'pending' "
-        ") "
-        "AND g.group_id NOT IN ( "
-        "    SELECT group_id FROM group_invitations "
-        "    WHERE invitee_id = $1 "
-        "    AND status = 'pending' "
-        ") "
-        "ORDER BY g.created_at DESC";
-    
-    const char *paramValues[1];
-    char user_id_str[20];
-    snprintf(user_id_str, sizeof(user_id_str), "%d", user_id);
-    paramValues[0] = user_id_str;
-    
-    PGresult *res = PQexecParams(conn, query, 1, NULL, paramValues, NULL, NULL, 0);
+int db_get_available_groups(int user_id, const GroupCursor *after, int limit, GroupInfo **groups, int *has_more) {
+    *groups = NULL;
+    *has_more = 0;
+    
+    PGconn *conn = db_conn();
+    if (!conn) return -1;
+    
+    DbParams params;
+    db_params_init(&params);
+    db_param_int4(&params, user_id);
+    db_param_int8(&params, after ? after->created_us : KEYSET_NEWEST_US);
+    db_param_int4(&params, after ? after->group_id : INT_MAX);
+    db_param_int4(&params, limit + 1);     // One extra row tells whether there is more
+    
+    PGresult *res = db_exec(conn, STMT_GET_AVAILABLE_GROUPS, &params);
     
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "Get available groups failed: %s\n", PQerrorMessage(conn));
@@ -1447,22 +1679,30 @@ int db_get_available_groups(int user_id, GroupInfo ***groups) {
     }
     
     int count = PQntuples(res);
+    if (count > limit) {
+        count = limit;
+        *has_more = 1;
+    }
     if (count == 0) {
-        *groups = NULL;
         PQclear(res);
         return 0;
     }
     
-    *groups = malloc(sizeof(GroupInfo*) * count);
+    *groups = calloc(count, sizeof(GroupInfo));
+    if (!*groups) {
+        PQclear(res);
+        return -1;
+    }
     
     for (int i = 0; i < count; i++) {
-        (*groups)[i] = malloc(sizeof(GroupInfo));
-        (*groups)[i]->group_id = atoi(PQgetvalue(res, i, 0));
-        strncpy((*groups)[i]->group_name, PQgetvalue(res, i, 1), sizeof((*groups)[i]->group_name) - 1);
-        strncpy((*groups)[i]->description, PQgetvalue(res, i, 2), sizeof((*groups)[i]->description) - 1);
-        strncpy((*groups)[i]->created_at, PQgetvalue(res, i, 3), sizeof((*groups)[i]->created_at) - 1);
-        (*groups)[i]->member_count = atoi(PQgetvalue(res, i, 4));
-        strcpy((*groups)[i]->role, ""); // Not a member
+        GroupInfo *group = &(*groups)[i];
+        group->group_id = db_get_int4(res, i, 0);
+        db_get_string(res, i, 1, group->group_name, sizeof(group->group_name));
+        db_get_string(res, i, 2, group->description, sizeof(group->description));
+        db_get_timestamp(res, i, 3, group->created_at, sizeof(group->created_at));
+        group->created_us = db_get_int8(res, i, 3);
+        group->member_count = db_get_int4(res, i, 4);
+        // role stays empty: not a member
     }
     
     PQclear(res);
@@ -28,8 +28,19 @@ typedef struct {
     char role[21];
     int member_count;
     char created_at[64];
+    long long created_us;   // created_at as microseconds since 2000-01-01, for cursors
 } GroupInfo;
 
+// Keyset position in the group discovery list, ordered newest first by
+// (created_at, group_id)
+typedef struct {
+    long long created_us;
+    int group_id;
+} GroupCursor;
+
+#define GROUP_PAGE_DEFAULT 50
+#define GROUP_PAGE_MAX 200
+
 typedef struct {
     int user_id;
     char username[51];
@@ -37,8 +48,18 @@ typedef struct {
     char role[21];
     char status[21];
     char joined_at[64];
+    long long joined_us;    // joined_at as microseconds since 2000-01-01, for cursors
 } MemberInfo;
 
+// Keyset position in a group's member list, ordered by (joined_at, user_id)
+typedef struct {
+    long long joined_us;
+    int user_id;
+} MemberCursor;
+
+#define MEMBER_PAGE_DEFAULT 200
+#define MEMBER_PAGE_MAX 1000
+
 typedef struct {
     int request_id;
     int group_id;
@@ -86,6 +107,7 @@ typedef struct {
 typedef struct {
     int notification_id;
     int user_id;
+    int group_id;       // Set for group-scoped notifications, 0 for personal ones
     char type[50];
     char title[255];
     char message[512];
@@ -93,34 +115,84 @@ typedef struct {
     int related_id;
     int is_read;
     char created_at[64];
+    long long created_us;   // created_at as microseconds since 2000-01-01, for cursors
 } NotificationInfo;
 
+// Keyset position in a user's notification list, which is ordered newest
+// first by (created_at, group before personal, id).
+typedef struct {
+    long long created_us;
+    int group_id;           // Non-zero for a group notification
+    int notification_id;
+} NotificationCursor;
+
+#define NOTIFICATION_PAGE_DEFAULT 50
+#define NOTIFICATION_PAGE_MAX 100
+
 int init_database();
 void cleanup_database();
+// Returns the pooled connection used by this thread's db_* calls, if any.
+// Called by the worker once a request has been answered.
+void db_release_connection();
+// Connection string of the pool, for connections kept outside it
+const char *db_conninfo();
+// Startup and catch-up loads, run by the notification listener each time it
+// (re)connects so that changes made while it was down are picked up whatever
+// order they committed in. Each returns 0 on error.
+// Reads the permissions table into permission_table.h
+int db_load_permissions();
+// Indexes every group for search
+int db_load_groups();
+// Indexes every user for search and adds them to the username filter
+int db_load_users();
+// Returns the new user_id, -2 if the username is taken, -3 if the email is
+// taken, -1 on error
 int db_create_user(const char *username, const char *password_hash, const char *email, const char *full_name);
 UserInfo* db_verify_user(const char *username, const char *password_hash);
+// Checks credentials, stamps last_login and creates the session in one round
+// trip. Returns 1 and sets *user on success, 0 for bad credentials, -1 on error.
+int db_login(const char *username, const char *password_hash, const char *session_token,
+             const char *ip_address, time_t expires_at, UserInfo **user);
 int db_create_session(int user_id, const char *session_token, const char *ip_address, time_t expires_at);
 int db_update_last_login(int user_id);
 UserInfo* db_verify_session(const char *session_token);
+// Same, also reporting the session's expires_at when expires_at is not NULL
+UserInfo* db_verify_session_expiry(const char *session_token, time_t *expires_at);
 int db_invalidate_session(const char *session_token);
 int db_update_profile(int user_id, const char *email, const char *full_name);
 UserInfo* db_get_user_by_id(int user_id);
 int db_change_password(int user_id, const char *new_password_hash);
-PermissionInfo* db_get_permissions(int user_id, int group_id);
+// Served from the in-memory permission table (permission_table.h), no query
+int db_get_permissions(int user_id, int group_id, PermissionInfo *perm);
+// mask is a set of PERM_* bits (permission_table.h), all of which must be granted
+int db_has_permission(int user_id, int group_id, unsigned int mask);
 int db_update_permissions(int user_id, int group_id, int can_read, int can_write, int can_delete, int can_manage);
 int db_is_group_admin(int user_id, int group_id);
 int db_create_group(int owner_id, const char *group_name, const char *description);
 int db_get_user_groups(int user_id, GroupInfo ***groups);
 int db_is_group_member(int user_id, int group_id);
-int db_get_group_members(int group_id, MemberInfo ***members);
+// Fills *members (one array, free() it) with up to limit members following
+// after, or the first ones when after is NULL. *has_more says whether any
+// follow the page. Returns the count, or -1 on error.
+int db_get_group_members(int group_id, const MemberCursor *after, int limit, MemberInfo **members, int *has_more);
 int db_request_join_group(int user_id, int group_id);
 int db_get_join_requests(int group_id, JoinRequestInfo ***requests);
-int db_approve_join_request(int request_id, int reviewer_id, const char *action);
+// Approves or rejects a pending request in one round trip. Fills info's ids,
+// username and status. Returns 0, -2 if there is no such request, -3 if the
+// reviewer is not a group admin, -4 if it was already reviewed (info->status
+// says how), -1 on error.
+int db_approve_join_request(int request_id, int reviewer_id, const char *action, JoinRequestInfo *info);
 JoinRequestInfo* db_get_join_request_by_id(int request_id);
-int db_invite_to_group(int inviter_id, int group_id, const char *invitee_username);
+// Returns the invitation_id and sets *invitee_id, or -2 if there is no such
+// user, -3 if they are already a member, -4 if an invitation is pending, -1
+// on error
+int db_invite_to_group(int inviter_id, int group_id, const char *invitee_username, int *invitee_id);
 int db_get_user_invitations(int user_id, InvitationInfo ***invitations);
 InvitationInfo* db_get_invitation_by_id(int invitation_id);
-int db_respond_invitation(int invitation_id, const char *action);
+// Accepts or rejects a pending invitation in one round trip and sets
+// *group_id. Returns 0, -2 if there is no such invitation, -3 if it is not
+// user_id's, -4 if it was already answered, -1 on error.
+int db_respond_invitation(int invitation_id, int user_id, const char *action, int *group_id);
 int db_leave_group(int user_id, int group_id);
 int db_remove_member(int group_id, int target_user_id);
 UserInfo* db_get_user_by_username(const char *username);
@@ -136,15 +208,40 @@ int db_move_directory(int directory_id, const char *destination_path, int *affec
 int db_create_notification(int user_id, const char *type, const char *title, 
                           const char *message, const char *related_type, 
                           int related_id);
-int db_get_user_notifications(int user_id, NotificationInfo ***notifications);
+// Sends the same notification to every approved admin of a group in one
+// statement. Returns the number of notifications created, -1 on error.
+int db_notify_group_admins(int group_id, const char *type, const char *title,
+                           const char *message, const char *related_type,
+                           int related_id);
+// Posts one notification to a whole group. Members see it from the time
+// they joined; nothing is written per member.
+int db_create_group_notification(int group_id, const char *type, const char *title,
+                                 const char *message, const char *related_type,
+                                 int related_id);
+// Personal and group-scoped notifications merged, newest first
+// Fills *notifications (one array, free() it) with up to limit entries, newest
+// first: the newest ones with no cursor, those older than before, or the
+// oldest ones newer than after. *has_more says whether more rows lie past the
+// page in that direction. Returns the count, or -1 on error.
+int db_get_user_notifications(int user_id, const NotificationCursor *before, const NotificationCursor *after,
+                              int unread_only, int limit, NotificationInfo **notifications, int *has_more);
 int db_mark_notification_read(int user_id, int notification_id);
+// Group notifications are read through a per-(user, group) cursor, so this
+// also marks every older notification of that group as read.
+int db_mark_group_notification_read(int user_id, int group_notification_id);
 int db_mark_all_notifications_read(int user_id);
 int db_get_unread_notification_count(int user_id);
 
 // Helper functions
-char* db_get_group_name_by_id(int group_id);
-char* db_get_username_by_id(int user_id);
-int db_get_group_admin_ids(int group_id, int **admin_ids);
+// Shared, cached names: pass each non-NULL result to db_release_name()
+// instead of free().
+const char* db_get_group_name_by_id(int group_id);
+const char* db_get_username_by_id(int user_id);
+void db_release_name(const char *name);
 
-int db_get_available_groups(int user_id, GroupInfo ***groups);
+// Groups user_id could ask to join: not a member, and no pending request or
+// invitation. Fills *groups (one array, free() it) with up to limit of them
+// older than after, or the newest ones when after is NULL. *has_more says
+// whether any follow. Returns the count, or -1 on error.
+int db_get_available_groups(int user_id, const GroupCursor *after, int limit, GroupInfo **groups, int *has_more);
 #endif
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <libpq-fe.h>
+#include "db_pool.h"
+
+typedef struct {
+    PGconn *conn;
+    time_t last_used;
+    unsigned int generation;    // Bumped on every reconnect
+} PoolSlot;
+
+static PoolSlot *slots = NULL;
+static int *free_slots = NULL;      // Stack of idle slot indexes
+static int free_count = 0;
+static int pool_size = 0;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_available = PTHREAD_COND_INITIALIZER;
+static DbPoolStats stats;
+
+static unsigned long long now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+int db_pool_init(const char *conninfo, int size) {
+    if (size < 1) size = 1;
+    if (size > DB_POOL_MAX_SIZE) size = DB_POOL_MAX_SIZE;
+
+    slots = calloc(size, sizeof(PoolSlot));
+    free_slots = calloc(size, sizeof(int));
+    if (!slots || !free_slots) return 0;
+
+    for (int i = 0; i < size; i++) {
+        slots[i].conn = PQconnectdb(conninfo);
+        if (PQstatus(slots[i].conn) != CONNECTION_OK) {
+            fprintf(stderr, "Connection to database failed: %s", PQerrorMessage(slots[i].conn));
+            PQfinish(slots[i].conn);
+            slots[i].conn = NULL;
+            pool_size = i;
+            db_pool_destroy();
+            return 0;
+        }
+        slots[i].last_used = time(NULL);
+        free_slots[i] = i;
+    }
+
+    pool_size = size;
+    free_count = size;
+    memset(&stats, 0, sizeof(stats));
+    stats.size = size;
+    return 1;
+}
+
+void db_pool_destroy() {
+    pthread_mutex_lock(&pool_lock);
+    for (int i = 0; i < pool_size; i++) {
+        if (slots[i].conn) PQfinish(slots[i].conn);
+    }
+    free(slots);
+    free(free_slots);
+    slots = NULL;
+    free_slots = NULL;
+    pool_size = free_count = 0;
+    pthread_mutex_unlock(&pool_lock);
+}
+
+int db_pool_size() {
+    return pool_size;
+}
+
+// Makes sure a connection fresh out of the pool is usable, pinging it first
+// if it sat idle long enough for the server to have dropped it. Called without
+// the pool lock since it may talk to the server.
+static int check_connection(PGconn *conn, int idle_check, int *reconnected) {
+    *reconnected = 0;
+
+    int ok = PQstatus(conn) == CONNECTION_OK;
+    if (ok && idle_check) {
+        PGresult *res = PQexec(conn, "SELECT 1");
+        ok = PQresultStatus(res) == PGRES_TUPLES_OK;
+        PQclear(res);
+    }
+    if (ok) return 1;
+
+    PQreset(conn);
+    *reconnected = 1;
+    return PQstatus(conn) == CONNECTION_OK;
+}
+
+PGconn *db_pool_acquire() {
+    unsigned long long start = now_us();
+
+    pthread_mutex_lock(&pool_lock);
+    if (free_count == 0) stats.waited++;
+    while (free_count == 0) {
+        pthread_cond_wait(&pool_available, &pool_lock);
+    }
+
+    int index = free_slots[--free_count];
+    stats.in_use++;
+    if (stats.in_use > stats.high_water) stats.high_water = stats.in_use;
+
+    unsigned long long waited = now_us() - start;
+    stats.checkouts++;
+    stats.total_wait_us += waited;
+    if (waited > stats.max_wait_us) stats.max_wait_us = waited;
+
+    int idle_check = time(NULL) - slots[index].last_used > DB_POOL_IDLE_CHECK_SECONDS;
+    pthread_mutex_unlock(&pool_lock);
+
+    int reconnected;
+    int healthy = check_connection(slots[index].conn, idle_check, &reconnected);
+
+    pthread_mutex_lock(&pool_lock);
+    if (idle_check) stats.health_checks++;
+    if (reconnected) {
+        stats.reconnects++;
+        slots[index].generation++;
+    }
+    if (!healthy) {
+        fprintf(stderr, "Database connection unavailable: %s", PQerrorMessage(slots[index].conn));
+        stats.failures++;
+        stats.in_use--;
+        free_slots[free_count++] = index;
+        pthread_cond_signal(&pool_available);
+        pthread_mutex_unlock(&pool_lock);
+        return NULL;
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    return slots[index].conn;
+}
+
+void db_pool_release(PGconn *conn) {
+    if (!conn) return;
+
+    // Never hand the next request a connection stuck inside a transaction
+    PGTransactionStatusType tx = PQtransactionStatus(conn);
+    if (tx == PQTRANS_INTRANS || tx == PQTRANS_INERROR) {
+        PGresult *res = PQexec(conn, "ROLLBACK");
+        PQclear(res);
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    for (int i = 0; i < pool_size; i++) {
+        if (slots[i].conn == conn) {
+            slots[i].last_used = time(NULL);
+            free_slots[free_count++] = i;
+            stats.in_use--;
+            pthread_cond_signal(&pool_available);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+int db_pool_slot(PGconn *conn) {
+    // slots never moves after db_pool_init, so no lock is needed to search it
+    for (int i = 0; i < pool_size; i++) {
+        if (slots[i].conn == conn) return i;
+    }
+    return -1;
+}
+
+unsigned int db_pool_generation(int slot) {
+    pthread_mutex_lock(&pool_lock);
+    unsigned int generation = slots[slot].generation;
+    pthread_mutex_unlock(&pool_lock);
+    return generation;
+}
+
+void db_pool_get_stats(DbPoolStats *out) {
+    pthread_mutex_lock(&pool_lock);
+    *out = stats;
+    pthread_mutex_unlock(&pool_lock);
+}
@@ -0,0 +1,44 @@
+#ifndef DB_POOL_H
+#define DB_POOL_H
+
+#include <libpq-fe.h>
+
+#define DB_POOL_SIZE 8                  // Default, overridden by the DB_POOL_SIZE environment variable
+#define DB_POOL_MAX_SIZE 256
+#define DB_POOL_IDLE_CHECK_SECONDS 30   // Connections idle longer than this are pinged before reuse
+
+typedef struct {
+    int size;
+    int in_use;
+    int high_water;
+    unsigned long long checkouts;
+    unsigned long long waited;          // Checkouts that found every connection busy
+    unsigned long long total_wait_us;
+    unsigned long long max_wait_us;
+    unsigned long long health_checks;
+    unsigned long long reconnects;
+    unsigned long long failures;        // Checkouts that could not get a working connection
+} DbPoolStats;
+
+// Opens size connections up front. Returns 0 if any of them fails.
+int db_pool_init(const char *conninfo, int size);
+void db_pool_destroy();
+int db_pool_size();
+
+// Blocks until a connection is free, reconnecting it first if it went bad.
+// Returns NULL if the database cannot be reached.
+PGconn *db_pool_acquire();
+
+// Gives a connection back, rolling back any transaction left open on it.
+void db_pool_release(PGconn *conn);
+
+// Index of a pooled connection, or -1 if conn is not from the pool
+int db_pool_slot(PGconn *conn);
+
+// Changes whenever the connection in slot has been re-established, so
+// per-session state (like prepared statements) can be dropped.
+unsigned int db_pool_generation(int slot);
+
+void db_pool_get_stats(DbPoolStats *stats);
+
+#endif
@@ -0,0 +1,408 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <libpq-fe.h>
+#include "db_statements.h"
+#include "db_pool.h"
+
+typedef struct {
+    const char *name;
+    const char *sql;
+} StatementDef;
+
+#define DB_STATEMENT_DEF_ENTRY(name, sql) { #name, sql },
+
+static const StatementDef statements[STMT_COUNT] = {
+    DB_STATEMENT_LIST(DB_STATEMENT_DEF_ENTRY)
+};
+
+// Which statements exist on each pooled connection. A slot is only touched by
+// the thread that has its connection checked out, so no locking is needed.
+// The pool bumps a slot's generation whenever it reconnects, which drops
+// everything prepared on the old session.
+static unsigned char prepared[DB_POOL_MAX_SIZE][STMT_COUNT];
+static unsigned int prepared_generation[DB_POOL_MAX_SIZE];
+
+static DbStatementStats statement_stats[STMT_COUNT];
+
+// Type OIDs from pg_type, for the parameters we send in binary
+#define BOOLOID 16
+#define INT8OID 20
+#define INT4OID 23
+
+// PostgreSQL timestamps are microseconds since 2000-01-01 00:00:00
+#define POSTGRES_EPOCH_UNIX 946684800LL
+
+// SQLSTATE for a prepared statement the server does not know (any more)
+#define SQLSTATE_INVALID_STATEMENT_NAME "26000"
+#define SQLSTATE_DUPLICATE_PREPARED "42P05"
+
+static int has_sqlstate(const PGresult *res, const char *state) {
+    const char *code = PQresultErrorField(res, PG_DIAG_SQLSTATE);
+    return code && strcmp(code, state) == 0;
+}
+
+static int prepare_statement(PGconn *conn, DbStatement stmt, const DbParams *params) {
+    PGresult *res = PQprepare(conn, statements[stmt].name, statements[stmt].sql,
+                              params->count, params->types);
+    int ok = PQresultStatus(res) == PGRES_COMMAND_OK ||
+             has_sqlstate(res, SQLSTATE_DUPLICATE_PREPARED);
+    if (!ok) {
+        fprintf(stderr, "PREPARE %s failed: %s", statements[stmt].name, PQerrorMessage(conn));
+    }
+    PQclear(res);
+    return ok;
+}
+
+void db_params_init(DbParams *params) {
+    params->count = 0;
+}
+
+static int next_param(DbParams *params, Oid type) {
+    if (params->count == DB_MAX_PARAMS) {
+        fprintf(stderr, "Too many statement parameters (max %d)\n", DB_MAX_PARAMS);
+        return -1;
+    }
+    int i = params->count++;
+    params->types[i] = type;
+    params->lengths[i] = 0;
+    params->formats[i] = 1;
+    params->values[i] = params->storage[i];
+    return i;
+}
+
+void db_param_text(DbParams *params, const char *value) {
+    // Type 0 lets the server infer it from the statement (text, varchar...)
+    int i = next_param(params, 0);
+    if (i < 0) return;
+    params->formats[i] = 0;
+    params->values[i] = value;
+}
+
+void db_param_int4(DbParams *params, int value) {
+    int i = next_param(params, INT4OID);
+    if (i < 0) return;
+    uint32_t be = htonl((uint32_t)value);
+    memcpy(params->storage[i], &be, 4);
+    params->lengths[i] = 4;
+}
+
+void db_param_int8(DbParams *params, long long value) {
+    int i = next_param(params, INT8OID);
+    if (i < 0) return;
+    uint32_t hi = htonl((uint32_t)((unsigned long long)value >> 32));
+    uint32_t lo = htonl((uint32_t)value);
+    memcpy(params->storage[i], &hi, 4);
+    memcpy(params->storage[i] + 4, &lo, 4);
+    params->lengths[i] = 8;
+}
+
+void db_param_bool(DbParams *params, int value) {
+    int i = next_param(params, BOOLOID);
+    if (i < 0) return;
+    params->storage[i][0] = value ? 1 : 0;
+    params->lengths[i] = 1;
+}
+
+static PGresult *exec_prepared(PGconn *conn, DbStatement stmt, const DbParams *params) {
+    return PQexecPrepared(conn, statements[stmt].name, params->count, params->values,
+                          params->lengths, params->formats, 1);
+}
+
+// Prepared flags for conn, reset if the pool reconnected it since we last
+// looked. NULL for a connection that is not from the pool.
+static unsigned char *prepared_flags(PGconn *conn) {
+    int slot = db_pool_slot(conn);
+    if (slot < 0) return NULL;
+
+    unsigned int generation = db_pool_generation(slot);
+    if (prepared_generation[slot] != generation) {
+        memset(prepared[slot], 0, sizeof(prepared[slot]));
+        prepared_generation[slot] = generation;
+    }
+    return prepared[slot];
+}
+
+PGresult *db_exec(PGconn *conn, DbStatement stmt, const DbParams *params) {
+    unsigned char *flags = prepared_flags(conn);
+
+    if (flags && flags[stmt]) {
+        __atomic_add_fetch(&statement_stats[stmt].hits, 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_add_fetch(&statement_stats[stmt].misses, 1, __ATOMIC_RELAXED);
+        if (!prepare_statement(conn, stmt, params)) {
+            __atomic_add_fetch(&statement_stats[stmt].failures, 1, __ATOMIC_RELAXED);
+            // Still answer the caller, just without the plan cache
+            return PQexecParams(conn, statements[stmt].sql, params->count, params->types,
+                                params->values, params->lengths, params->formats, 1);
+        }
+        if (flags) flags[stmt] = 1;
+    }
+
+    PGresult *res = exec_prepared(conn, stmt, params);
+
+    if (has_sqlstate(res, SQLSTATE_INVALID_STATEMENT_NAME)) {
+        // The session lost its statements behind our back (e.g. DISCARD ALL)
+        PQclear(res);
+        if (flags) memset(flags, 0, STMT_COUNT);
+        if (!prepare_statement(conn, stmt, params)) {
+            return PQexecParams(conn, statements[stmt].sql, params->count, params->types,
+                                params->values, params->lengths, params->formats, 1);
+        }
+        if (flags) flags[stmt] = 1;
+        res = exec_prepared(conn, stmt, params);
+    }
+
+    return res;
+}
+
+void db_batch_init(DbBatch *batch, PGconn *conn) {
+    memset(batch, 0, sizeof(*batch));
+    batch->conn = conn;
+    batch->failed_step = -1;
+}
+
+int db_batch_add(DbBatch *batch, DbStatement stmt, const DbParams *params) {
+    if (batch->count == DB_BATCH_MAX_STEPS) {
+        fprintf(stderr, "Too many batched statements (max %d)\n", DB_BATCH_MAX_STEPS);
+        return -1;
+    }
+    batch->stmts[batch->count] = stmt;
+    batch->params[batch->count] = params;
+    return batch->count++;
+}
+
+static int step_ok(const PGresult *res) {
+    ExecStatusType status = PQresultStatus(res);
+    return status == PGRES_COMMAND_OK || status == PGRES_TUPLES_OK;
+}
+
+// Queues every step (plus a PREPARE for each statement not yet on this
+// connection) and syncs once. Without flags (a connection outside the pool)
+// steps are sent as unnamed statements. Returns 0 if the commands could not
+// be sent.
+static int send_batch(DbBatch *batch, unsigned char *flags, int *prepare_sent) {
+    PGconn *conn = batch->conn;
+
+    for (int i = 0; i < batch->count; i++) {
+        DbStatement stmt = batch->stmts[i];
+        const DbParams *params = batch->params[i];
+
+        if (!flags) {
+            prepare_sent[i] = 0;
+            if (!PQsendQueryParams(conn, statements[stmt].sql, params->count, params->types,
+                                   params->values, params->lengths, params->formats, 1)) return 0;
+            continue;
+        }
+
+        prepare_sent[i] = !flags[stmt];
+        if (prepare_sent[i]) {
+            __atomic_add_fetch(&statement_stats[stmt].misses, 1, __ATOMIC_RELAXED);
+            if (!PQsendPrepare(conn, statements[stmt].name, statements[stmt].sql,
+                               params->count, params->types)) return 0;
+            flags[stmt] = 1;    // Cleared again below if the PREPARE fails
+        } else {
+            __atomic_add_fetch(&statement_stats[stmt].hits, 1, __ATOMIC_RELAXED);
+        }
+
+        if (!PQsendQueryPrepared(conn, statements[stmt].name, params->count, params->values,
+                                 params->lengths, params->formats, 1)) return 0;
+    }
+    return PQpipelineSync(conn);
+}
+
+// Reads back one result per queued command, then the sync marker. Each
+// command's results end with a NULL from PQgetResult. Any error aborts the
+// rest of the pipeline, a failed PREPARE included. Returns 1 if the error
+// only came from flags disagreeing with the session about one statement;
+// that flag is corrected and the batch can be sent again.
+static int collect_batch(DbBatch *batch, unsigned char *flags, const int *prepare_sent) {
+    PGconn *conn = batch->conn;
+    PGresult *res;
+    int aborted = 0;
+    int retry = 0;
+
+    for (int i = 0; i < batch->count; i++) {
+        DbStatement stmt = batch->stmts[i];
+
+        if (prepare_sent[i]) {
+            res = PQgetResult(conn);
+            if (res && !step_ok(res)) {
+                if (PQresultStatus(res) == PGRES_PIPELINE_ABORTED) {
+                    flags[stmt] = 0;
+                } else if (has_sqlstate(res, SQLSTATE_DUPLICATE_PREPARED)) {
+                    // Already on the session, the flag stays set
+                    retry = !aborted;
+                } else {
+                    fprintf(stderr, "PREPARE %s failed: %s", statements[stmt].name,
+                            PQresultErrorMessage(res));
+                    __atomic_add_fetch(&statement_stats[stmt].failures, 1, __ATOMIC_RELAXED);
+                    flags[stmt] = 0;
+                }
+                aborted = 1;
+            }
+            PQclear(res);
+            while ((res = PQgetResult(conn)) != NULL) PQclear(res);
+        }
+
+        batch->results[i] = PQgetResult(conn);
+        while ((res = PQgetResult(conn)) != NULL) PQclear(res);
+
+        if (!step_ok(batch->results[i])) {
+            if (batch->failed_step < 0) batch->failed_step = i;
+            if (PQresultStatus(batch->results[i]) != PGRES_PIPELINE_ABORTED) {
+                if (!aborted && flags &&
+                    has_sqlstate(batch->results[i], SQLSTATE_INVALID_STATEMENT_NAME)) {
+                    // The session lost this statement behind our back
+                    flags[stmt] = 0;
+                    retry = 1;
+                } else {
+                    fprintf(stderr, "%s failed: %s", statements[stmt].name,
+                            PQresultErrorMessage(batch->results[i]));
+                }
+            }
+            aborted = 1;
+        }
+    }
+
+    // PGRES_PIPELINE_SYNC
+    res = PQgetResult(conn);
+    PQclear(res);
+    return retry;
+}
+
+int db_batch_run(DbBatch *batch) {
+    PGconn *conn = batch->conn;
+    unsigned char *flags = prepared_flags(conn);
+
+    // Each retry corrects the flag of one statement in the batch, so this
+    // converges even if the session lost several of them
+    for (int attempt = 0; attempt <= batch->count; attempt++) {
+        int prepare_sent[DB_BATCH_MAX_STEPS];
+
+        if (!PQenterPipelineMode(conn)) {
+            fprintf(stderr, "Cannot enter pipeline mode: %s", PQerrorMessage(conn));
+            return 0;
+        }
+        if (!send_batch(batch, flags, prepare_sent)) {
+            // Only happens on a broken connection; the pool resets it later
+            fprintf(stderr, "Sending batch failed: %s", PQerrorMessage(conn));
+            PQexitPipelineMode(conn);
+            batch->failed_step = 0;
+            return 0;
+        }
+        int retry = collect_batch(batch, flags, prepare_sent);
+        PQexitPipelineMode(conn);
+
+        if (batch->failed_step < 0) return 1;
+
+        // The whole batch was rolled back, so it is safe to send it again
+        if (!retry) break;
+        db_batch_clear(batch);
+    }
+    return 0;
+}
+
+PGresult *db_batch_result(const DbBatch *batch, int step) {
+    if (step < 0 || step >= batch->count) return NULL;
+    return batch->results[step];
+}
+
+void db_batch_clear(DbBatch *batch) {
+    for (int i = 0; i < batch->count; i++) {
+        PQclear(batch->results[i]);
+        batch->results[i] = NULL;
+    }
+    batch->failed_step = -1;
+}
+
+// Integers are decoded by their width so COUNT(*) (int8) and SERIAL ids
+// (int4) can be read with either helper.
+static long long get_integer(const PGresult *res, int row, int col) {
+    if (PQgetisnull(res, row, col)) return 0;
+
+    const unsigned char *p = (const unsigned char*)PQgetvalue(res, row, col);
+    switch (PQgetlength(res, row, col)) {
+    case 2:
+        return (int16_t)((p[0] << 8) | p[1]);
+    case 4:
+        return (int32_t)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                         ((uint32_t)p[2] << 8) | p[3]);
+    case 8: {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; i++) v = (v << 8) | p[i];
+        return (long long)v;
+    }
+    default:
+        return 0;
+    }
+}
+
+int db_get_int4(const PGresult *res, int row, int col) {
+    return (int)get_integer(res, row, col);
+}
+
+long long db_get_int8(const PGresult *res, int row, int col) {
+    return get_integer(res, row, col);
+}
+
+int db_get_bool(const PGresult *res, int row, int col) {
+    if (PQgetisnull(res, row, col) || PQgetlength(res, row, col) < 1) return 0;
+    return PQgetvalue(res, row, col)[0] != 0;
+}
+
+const char *db_get_text(const PGresult *res, int row, int col) {
+    // Binary text is the raw string; libpq NUL terminates every value
+    return PQgetvalue(res, row, col);
+}
+
+void db_get_string(const PGresult *res, int row, int col, char *buf, size_t size) {
+    strncpy(buf, PQgetvalue(res, row, col), size - 1);
+    buf[size - 1] = '\0';
+}
+
+void db_get_timestamp(const PGresult *res, int row, int col, char *buf, size_t size) {
+    if (PQgetisnull(res, row, col) || PQgetlength(res, row, col) != 8) {
+        buf[0] = '\0';
+        return;
+    }
+
+    long long value = get_integer(res, row, col);
+    if (value == INT64_MAX) { snprintf(buf, size, "infinity"); return; }
+    if (value == INT64_MIN) { snprintf(buf, size, "-infinity"); return; }
+
+    long long seconds = value / 1000000;
+    long long usec = value % 1000000;
+    if (usec < 0) {
+        usec += 1000000;
+        seconds--;
+    }
+
+    // timestamp without time zone holds wall-clock fields, so no TZ conversion
+    time_t t = (time_t)(seconds + POSTGRES_EPOCH_UNIX);
+    struct tm tm;
+    gmtime_r(&t, &tm);
+
+    int n = snprintf(buf, size, "%04d-%02d-%02d %02d:%02d:%02d",
+                     tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                     tm.tm_hour, tm.tm_min, tm.tm_sec);
+    if (usec == 0 || n < 0 || (size_t)n >= size) return;
+
+    // Same fraction as the text output: up to 6 digits, trailing zeros dropped
+    char fraction[8];
+    snprintf(fraction, sizeof(fraction), ".%06lld", usec);
+    for (int i = 6; i > 0 && fraction[i] == '0'; i--) fraction[i] = '\0';
+    snprintf(buf + n, size - n, "%s", fraction);
+}
+
+const char *db_statement_name(DbStatement stmt) {
+    return statements[stmt].name;
+}
+
+void db_statement_get_stats(DbStatement stmt, DbStatementStats *out) {
+    out->hits = __atomic_load_n(&statement_stats[stmt].hits, __ATOMIC_RELAXED);
+    out->misses = __atomic_load_n(&statement_stats[stmt].misses, __ATOMIC_RELAXED);
+    out->failures = __atomic_load_n(&statement_stats[stmt].failures, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,337 @@
+#ifndef DB_STATEMENTS_H
+#define DB_STATEMENTS_H
+
+#include <stddef.h>
+#include <libpq-fe.h>
+
+// Postgres channel every notification insert raises a NOTIFY on, with a
+// JSON payload {"user_id", "group_id", "seq", "notification"} (see notify_hub.h).
+// Triggers in database.sql raise the other payloads on it, so every server
+// process learns of changes made by any of them: {"registered": {...}} for a
+// new user, {"profile": {...}} for a changed full name, {"session": {...}}
+// for a logout or account change, {"permission": {...}}, {"membership": {...}}
+// and {"group": {...}} for permissions, group_members and groups rows.
+#define DB_NOTIFY_CHANNEL "file_share_notifications"
+
+// Row of a freshly inserted notification as sent in that payload. Shaped like
+// a GET_NOTIFICATIONS entry; n is the RETURNING row. seq is the group
+// notification's number within its group, 0 for personal ones.
+#define DB_NOTIFY_PAYLOAD(user_id, group_id, seq, id, scope) \
+    "pg_notify('" DB_NOTIFY_CHANNEL "', json_build_object(" \
+    "'user_id', " user_id ", 'group_id', " group_id ", 'seq', " seq ", 'notification', json_build_object(" \
+    "'notification_id', " id ", 'scope', '" scope "', 'group_id', " group_id ", " \
+    "'type', n.type, 'title', n.title, 'message', n.message, " \
+    "'related_type', n.related_type, 'related_id', n.related_id, 'is_read', FALSE, " \
+    "'created_at', to_char(n.created_at, 'YYYY-MM-DD HH24:MI:SS')))::text)"
+
+// One page of a user's personal and group notifications on either side of a
+// keyset cursor, ordered by (created_at, group before personal, id).
+//   $1 user_id, $2 cursor created_at as microseconds since 2000-01-01,
+//   $3 / $4 id bound for personal / group rows at exactly that created_at,
+//   $5 unread only, $6 row limit
+#define DB_NOTIFICATION_CURSOR_TIME "(TIMESTAMP '2000-01-01' + $2 * INTERVAL '1 microsecond')"
+#define DB_NOTIFICATION_PAGE(cmp, dir) \
+    "(SELECT notification_id, 0 AS group_id, type, title, message, " \
+    " related_type, related_id, is_read, created_at " \
+    " FROM notifications " \
+    " WHERE user_id = $1 AND (created_at, notification_id) " cmp " (" DB_NOTIFICATION_CURSOR_TIME ", $3) " \
+    " AND (NOT $5 OR NOT is_read) " \
+    " ORDER BY created_at " dir ", notification_id " dir " LIMIT $6) " \
+    "UNION ALL " \
+    "(SELECT gn.group_notification_id, gn.group_id, gn.type, gn.title, gn.message, " \
+    " gn.related_type, gn.related_id, gn.seq <= c.last_read_seq, gn.created_at " \
+    " FROM group_notification_cursors c " \
+    " JOIN group_members gm ON gm.group_id = c.group_id AND gm.user_id = c.user_id AND gm.status = 'approved' " \
+    " JOIN group_notifications gn ON gn.group_id = c.group_id AND gn.seq > c.joined_seq " \
+    " WHERE c.user_id = $1 AND (gn.created_at, gn.group_notification_id) " cmp " (" DB_NOTIFICATION_CURSOR_TIME ", $4) " \
+    " AND (NOT $5 OR gn.seq > c.last_read_seq) " \
+    " ORDER BY gn.created_at " dir ", gn.group_notification_id " dir " LIMIT $6) " \
+    "ORDER BY created_at " dir ", group_id > 0 " dir ", notification_id " dir " " \
+    "LIMIT $6"
+
+// Every SQL statement the server runs, registered once by name:
+//   X(name, sql)
+// Statements are prepared lazily on each pooled connection the first time
+// they run there and executed with PQexecPrepared afterwards.
+#define DB_STATEMENT_LIST(X) \
+    X(CREATE_USER, \
+      "INSERT INTO users (username, password_hash, email, full_name) VALUES ($1, $2, $3, $4) " \
+      "ON CONFLICT (username) DO NOTHING RETURNING user_id") \
+    X(VERIFY_USER, \
+      "SELECT user_id, username, role FROM users WHERE username = $1 AND password_hash = $2") \
+    X(CREATE_SESSION, \
+      "INSERT INTO sessions (user_id, session_token, ip_address, expires_at) VALUES ($1, $2, $3, to_timestamp($4))") \
+    X(UPDATE_LAST_LOGIN, \
+      "UPDATE users SET last_login = CURRENT_TIMESTAMP WHERE user_id = $1") \
+    X(LOGIN_TOUCH_USER, \
+      "UPDATE users SET last_login = CURRENT_TIMESTAMP WHERE username = $1 AND password_hash = $2") \
+    X(LOGIN_CREATE_SESSION, \
+      "INSERT INTO sessions (user_id, session_token, ip_address, expires_at) " \
+      "SELECT user_id, $3, $4, to_timestamp($5) FROM users WHERE username = $1 AND password_hash = $2") \
+    X(VERIFY_SESSION, \
+      "SELECT s.user_id, u.username, u.role, EXTRACT(EPOCH FROM s.expires_at::timestamptz)::int8 " \
+      "FROM sessions s " \
+      "JOIN users u ON s.user_id = u.user_id " \
+      "WHERE s.session_token = $1 AND s.is_active = TRUE AND s.expires_at > CURRENT_TIMESTAMP") \
+    X(INVALIDATE_SESSION, \
+      "UPDATE sessions SET is_active = FALSE WHERE session_token = $1") \
+    X(UPDATE_PROFILE, \
+      "UPDATE users SET email = $2, full_name = $3 WHERE user_id = $1") \
+    X(GET_USER_BY_ID, \
+      "SELECT user_id, username, role, email, full_name FROM users WHERE user_id = $1") \
+    X(CHANGE_PASSWORD, \
+      "UPDATE users SET password_hash = $2 WHERE user_id = $1") \
+    X(LOAD_PERMISSIONS, \
+      "SELECT permission_id, user_id, group_id, can_read, can_write, can_delete, can_manage " \
+      "FROM permissions ORDER BY permission_id") \
+    X(UPDATE_PERMISSIONS, \
+      "UPDATE permissions SET can_read = $3, can_write = $4, can_delete = $5, can_manage = $6 " \
+      "WHERE user_id = $1 AND group_id = $2 RETURNING permission_id") \
+    X(INSERT_PERMISSIONS, \
+      "INSERT INTO permissions (user_id, group_id, can_read, can_write, can_delete, can_manage) " \
+      "VALUES ($1, $2, $3, $4, $5, $6) RETURNING permission_id") \
+    X(GET_MEMBERSHIP_ROLE, \
+      "SELECT EXISTS (SELECT 1 FROM groups WHERE group_id = $2 AND owner_id = $1), " \
+      "(SELECT role FROM group_members WHERE user_id = $1 AND group_id = $2 AND status = 'approved')") \
+    X(LOAD_GROUP_SEARCH, \
+      "SELECT group_id, owner_id, group_name, description FROM groups WHERE group_id > $1 " \
+      "ORDER BY group_id LIMIT $2") \
+    X(LOAD_USERS, \
+      "SELECT user_id, username, full_name FROM users WHERE user_id > $1 ORDER BY user_id LIMIT $2") \
+    X(CREATE_GROUP, \
+      "INSERT INTO groups (group_name, description, owner_id) VALUES ($1, $2, $3) RETURNING group_id") \
+    X(ADD_NEW_GROUP_ADMIN, \
+      "INSERT INTO group_members (group_id, user_id, role, status) " \
+      "VALUES (currval(pg_get_serial_sequence('groups', 'group_id')), $1, 'admin', 'approved')") \
+    X(GRANT_NEW_GROUP_ADMIN_PERMISSIONS, \
+      "INSERT INTO permissions (group_id, user_id, can_read, can_write, can_delete, can_manage) " \
+      "VALUES (currval(pg_get_serial_sequence('groups', 'group_id')), $1, TRUE, TRUE, TRUE, TRUE) " \
+      "RETURNING permission_id") \
+    X(GET_USER_GROUPS, \
+      "SELECT g.group_id, g.group_name, g.description, " \
+      "CASE WHEN g.owner_id = $1 THEN 'admin' ELSE COALESCE(gm.role, 'member') END as role, " \
+      "g.member_count, " \
+      "g.created_at " \
+      "FROM groups g " \
+      "LEFT JOIN group_members gm ON g.group_id = gm.group_id AND gm.user_id = $1 " \
+      "WHERE g.owner_id = $1 OR (gm.user_id = $1 AND gm.status = 'approved') " \
+      "ORDER BY g.created_at DESC") \
+    X(GET_GROUP_MEMBERS, \
+      "SELECT u.user_id, u.username, u.full_name, gm.role, gm.status, gm.joined_at " \
+      "FROM group_members gm " \
+      "JOIN users u ON gm.user_id = u.user_id " \
+      "WHERE gm.group_id = $1 " \
+      "AND (gm.joined_at, gm.user_id) > (TIMESTAMP '2000-01-01' + $2 * INTERVAL '1 microsecond', $3) " \
+      "ORDER BY gm.joined_at ASC, gm.user_id ASC " \
+      "LIMIT $4") \
+    X(REQUEST_JOIN_GROUP, \
+      "SELECT outcome, new_request_id FROM request_join_group($1, $2)") \
+    X(GET_JOIN_REQUESTS, \
+      "SELECT jr.request_id, jr.group_id, jr.user_id, u.username, u.full_name, jr.status, jr.created_at " \
+      "FROM join_requests jr " \
+      "JOIN users u ON jr.user_id = u.user_id " \
+      "WHERE jr.group_id = $1 AND jr.status = 'pending' " \
+      "ORDER BY jr.created_at DESC") \
+    X(GET_JOIN_REQUEST_BY_ID, \
+      "SELECT jr.request_id, jr.group_id, jr.user_id, u.username, u.full_name, jr.status, jr.created_at " \
+      "FROM join_requests jr " \
+      "JOIN users u ON jr.user_id = u.user_id " \
+      "WHERE jr.request_id = $1") \
+    X(REVIEW_JOIN_REQUEST, \
+      "SELECT outcome, request_group_id, request_user_id, request_username, request_status, granted_permission_id " \
+      "FROM review_join_request($1, $2, $3)") \
+    X(GET_USER_BY_USERNAME, \
+      "SELECT user_id, username, role, email, full_name FROM users WHERE username = $1") \
+    X(INVITE_TO_GROUP, \
+      "SELECT outcome, new_invitation_id, invitee_user_id FROM invite_to_group($1, $2, $3)") \
+    X(GET_USER_INVITATIONS, \
+      "SELECT gi.invitation_id, gi.group_id, g.group_name, gi.inviter_id, " \
+      "u.username, u.full_name, gi.invitee_id, gi.status, gi.created_at " \
+      "FROM group_invitations gi " \
+      "JOIN groups g ON gi.group_id = g.group_id " \
+      "JOIN users u ON gi.inviter_id = u.user_id " \
+      "WHERE gi.invitee_id = $1 AND gi.status = 'pending' " \
+      "ORDER BY gi.created_at DESC") \
+    X(GET_INVITATION_BY_ID, \
+      "SELECT gi.invitation_id, gi.group_id, g.group_name, gi.inviter_id, " \
+      "u.username, u.full_name, gi.invitee_id, gi.status, gi.created_at " \
+      "FROM group_invitations gi " \
+      "JOIN groups g ON gi.group_id = g.group_id " \
+      "JOIN users u ON gi.inviter_id = u.user_id " \
+      "WHERE gi.invitation_id = $1") \
+    X(RESPOND_INVITATION, \
+      "SELECT outcome, invitation_group_id, granted_permission_id FROM respond_invitation($1, $2, $3)") \
+    X(DELETE_MEMBERSHIP, \
+      "DELETE FROM group_members WHERE group_id = $1 AND user_id = $2") \
+    X(DELETE_PERMISSIONS, \
+      "DELETE FROM permissions WHERE group_id = $1 AND user_id = $2") \
+    X(CREATE_DIRECTORY, \
+      "INSERT INTO directories (directory_name, directory_path, group_id, created_by) " \
+      "VALUES ($1, $2, $3, $4) RETURNING directory_id") \
+    X(GET_DIRECTORY_BY_ID, \
+      "SELECT d.directory_id, d.directory_name, d.directory_path, d.group_id, u.username, " \
+      "TO_CHAR(d.created_at, 'YYYY-MM-DD\"T\"HH24:MI:SS\"Z\"') " \
+      "FROM directories d " \
+      "LEFT JOIN users u ON d.created_by = u.user_id " \
+      "WHERE d.directory_id = $1") \
+    X(RENAME_DIRECTORY, \
+      "UPDATE directories SET directory_name = $1, directory_path = $2 WHERE directory_id = $3") \
+    X(REBASE_SUBDIRECTORIES, \
+      "UPDATE directories SET directory_path = $1 || SUBSTRING(directory_path FROM $2) " \
+      "WHERE directory_path LIKE $3") \
+    X(REBASE_FILES, \
+      "UPDATE files SET file_path = $1 || SUBSTRING(file_path FROM $2) WHERE file_path LIKE $3") \
+    X(COUNT_FILES_UNDER_PATH, \
+      "SELECT COUNT(*) FROM files WHERE file_path LIKE $1 OR file_path = $2") \
+    X(DELETE_FILES_UNDER_PATH, \
+      "DELETE FROM files WHERE file_path LIKE $1 OR file_path = $2") \
+    X(COUNT_SUBDIRECTORIES, \
+      "SELECT COUNT(*) FROM directories WHERE directory_path LIKE $1") \
+    X(DELETE_DIRECTORY_TREE, \
+      "DELETE FROM directories WHERE directory_path LIKE $1 OR directory_id = $2") \
+    X(MOVE_DIRECTORY, \
+      "UPDATE directories SET directory_path = $1 WHERE directory_id = $2") \
+    X(COUNT_FILES_LIKE, \
+      "SELECT COUNT(*) FROM files WHERE file_path LIKE $1") \
+    X(GET_GROUP_NAME, \
+      "SELECT group_name FROM groups WHERE group_id = $1") \
+    X(GET_USERNAME, \
+      "SELECT username FROM users WHERE user_id = $1") \
+    X(NOTIFY_GROUP_ADMINS, \
+      "WITH n AS (" \
+      "INSERT INTO notifications (user_id, type, title, message, related_type, related_id) " \
+      "SELECT user_id, $2, $3, $4, $5, $6 FROM group_members " \
+      "WHERE group_id = $1 AND role = 'admin' AND status = 'approved' RETURNING *) " \
+      "SELECT n.notification_id, " DB_NOTIFY_PAYLOAD("n.user_id", "0", "0", "n.notification_id", "user") " FROM n") \
+    X(CREATE_NOTIFICATION, \
+      "WITH n AS (" \
+      "INSERT INTO notifications (user_id, type, title, message, related_type, related_id) " \
+      "VALUES ($1, $2, $3, $4, $5, $6) RETURNING *) " \
+      "SELECT n.notification_id, " DB_NOTIFY_PAYLOAD("n.user_id", "0", "0", "n.notification_id", "user") " FROM n") \
+    X(CREATE_GROUP_NOTIFICATION, \
+      "WITH n AS (" \
+      "INSERT INTO group_notifications (group_id, type, title, message, related_type, related_id) " \
+      "VALUES ($1, $2, $3, $4, $5, $6) RETURNING *) " \
+      "SELECT n.group_notification_id, " \
+      DB_NOTIFY_PAYLOAD("0", "n.group_id", "n.seq", "n.group_notification_id", "group") " FROM n") \
+    X(GET_NOTIFICATIONS_BEFORE, DB_NOTIFICATION_PAGE("<", "DESC")) \
+    X(GET_NOTIFICATIONS_AFTER, DB_NOTIFICATION_PAGE(">", "ASC")) \
+    X(MARK_NOTIFICATION_READ, \
+      "UPDATE notifications " \
+      "SET is_read = TRUE, read_at = CURRENT_TIMESTAMP " \
+      "WHERE notification_id = $1 AND user_id = $2 AND is_read = FALSE") \
+    X(MARK_ALL_NOTIFICATIONS_READ, \
+      "UPDATE notifications " \
+      "SET is_read = TRUE, read_at = CURRENT_TIMESTAMP " \
+      "WHERE user_id = $1 AND is_read = FALSE") \
+    X(MARK_GROUP_NOTIFICATION_READ, \
+      "UPDATE group_notification_cursors c " \
+      "SET last_read_seq = gn.seq " \
+      "FROM group_notifications gn " \
+      "WHERE gn.group_notification_id = $1 AND c.user_id = $2 AND c.group_id = gn.group_id " \
+      "AND gn.seq > c.last_read_seq") \
+    X(MARK_ALL_GROUP_NOTIFICATIONS_READ, \
+      "UPDATE group_notification_cursors c " \
+      "SET last_read_seq = gc.last_seq " \
+      "FROM group_notification_counters gc " \
+      "WHERE c.user_id = $1 AND gc.group_id = c.group_id AND c.last_read_seq < gc.last_seq") \
+    X(COUNT_UNREAD_NOTIFICATIONS, \
+      "SELECT 0, COALESCE((SELECT unread FROM notification_counters WHERE user_id = $1), 0), 0 " \
+      "UNION ALL " \
+      "SELECT c.group_id, c.last_read_seq, COALESCE(gc.last_seq, 0) " \
+      "FROM group_notification_cursors c " \
+      "JOIN group_members gm ON gm.group_id = c.group_id AND gm.user_id = c.user_id AND gm.status = 'approved' " \
+      "LEFT JOIN group_notification_counters gc ON gc.group_id = c.group_id " \
+      "WHERE c.user_id = $1") \
+    X(GET_AVAILABLE_GROUPS, \
+      "SELECT g.group_id, g.group_name, g.description, g.created_at, g.member_count " \
+      "FROM groups g " \
+      "WHERE (g.created_at, g.group_id) < (TIMESTAMP '2000-01-01' + $2 * INTERVAL '1 microsecond', $3) " \
+      "AND NOT EXISTS (SELECT 1 FROM group_members gm " \
+      "    WHERE gm.group_id = g.group_id AND gm.user_id = $1 AND gm.status IN ('approved', 'pending')) " \
+      "AND NOT EXISTS (SELECT 1 FROM join_requests jr " \
+      "    WHERE jr.user_id = $1 AND jr.status = 'pending' AND jr.group_id = g.group_id) " \
+      "AND NOT EXISTS (SELECT 1 FROM group_invitations gi " \
+      "    WHERE gi.invitee_id = $1 AND gi.status = 'pending' AND gi.group_id = g.group_id) " \
+      "ORDER BY g.created_at DESC, g.group_id DESC " \
+      "LIMIT $4")
+
+#define DB_STATEMENT_ENUM_ENTRY(name, sql) STMT_##name,
+
+typedef enum {
+    DB_STATEMENT_LIST(DB_STATEMENT_ENUM_ENTRY)
+    STMT_COUNT
+} DbStatement;
+
+typedef struct {
+    unsigned long long hits;        // Already prepared on the connection
+    unsigned long long misses;      // Had to be prepared first
+    unsigned long long failures;    // PQprepare itself failed
+} DbStatementStats;
+
+#define DB_MAX_PARAMS 8
+
+// Parameters for one statement. Integers and booleans are sent in binary
+// (network byte order) so nothing is formatted to text on the way out.
+// Build with db_params_init() and the db_param_* appenders, in $1, $2... order.
+typedef struct {
+    int count;
+    Oid types[DB_MAX_PARAMS];
+    const char *values[DB_MAX_PARAMS];
+    int lengths[DB_MAX_PARAMS];
+    int formats[DB_MAX_PARAMS];
+    char storage[DB_MAX_PARAMS][8];     // Binary values point in here
+} DbParams;
+
+void db_params_init(DbParams *params);
+void db_param_text(DbParams *params, const char *value);     // NULL sends SQL NULL
+void db_param_int4(DbParams *params, int value);
+void db_param_int8(DbParams *params, long long value);
+void db_param_bool(DbParams *params, int value);
+
+// Runs a registered statement on conn, preparing it there first if needed.
+// The parameter types seen on that first run are fixed in the prepared
+// statement, so a statement must always be called with the same types.
+// Results come back in binary format; read them with the db_get_* helpers.
+PGresult *db_exec(PGconn *conn, DbStatement stmt, const DbParams *params);
+
+#define DB_BATCH_MAX_STEPS 8
+
+// A fixed sequence of statements sent together using libpq pipeline mode:
+// one network flush and one sync for the whole batch instead of a round trip
+// per statement. The steps run in order inside a single implicit transaction,
+// so if one fails the steps after it are aborted and all of it is rolled back.
+// Parameters passed to db_batch_add() must stay valid until db_batch_run().
+typedef struct {
+    PGconn *conn;
+    int count;
+    DbStatement stmts[DB_BATCH_MAX_STEPS];
+    const DbParams *params[DB_BATCH_MAX_STEPS];
+    PGresult *results[DB_BATCH_MAX_STEPS];
+    int failed_step;    // First step that did not succeed, -1 if none
+} DbBatch;
+
+void db_batch_init(DbBatch *batch, PGconn *conn);
+// Returns the step index used to fetch its result, or -1 if the batch is full
+int db_batch_add(DbBatch *batch, DbStatement stmt, const DbParams *params);
+// Returns 1 if every step succeeded. Results are available either way.
+int db_batch_run(DbBatch *batch);
+// Result of one step, owned by the batch. Steps skipped after a failure
+// report PGRES_PIPELINE_ABORTED.
+PGresult *db_batch_result(const DbBatch *batch, int step);
+void db_batch_clear(DbBatch *batch);
+
+// Column decoders for binary results. NULL reads as 0 / "".
+int db_get_int4(const PGresult *res, int row, int col);
+long long db_get_int8(const PGresult *res, int row, int col);
+int db_get_bool(const PGresult *res, int row, int col);
+const char *db_get_text(const PGresult *res, int row, int col);
+// Copies a text column into a fixed buffer, always NUL terminated
+void db_get_string(const PGresult *res, int row, int col, char *buf, size_t size);
+// Formats a timestamp column the way PostgreSQL prints it ("2024-05-01 10:20:30.5")
+void db_get_timestamp(const PGresult *res, int row, int col, char *buf, size_t size);
+
+const char *db_statement_name(DbStatement stmt);
+void db_statement_get_stats(DbStatement stmt, DbStatementStats *stats);
+
+#endif
@@ -0,0 +1,725 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <json-c/json.h>
+#include "event_loop.h"
+#include "auth_handler.h"
+#include "../common/protocol.h"
+#include "../common/json_utils.h"
+
+#define MAX_EVENTS 256
+#define MAX_PENDING_REQUESTS 64
+#define MAX_PIPELINED_REQUESTS 64
+#define MAX_PUSH_BACKLOG (1024 * 1024)  // Unsent bytes past which pushes to a connection are dropped
+#define OUTPUT_HIGH_WATER (1024 * 1024) // Unsent bytes past which the connection's requests are not read
+#define OUTPUT_LOW_WATER (256 * 1024)   // Unsent bytes below which reading resumes
+
+// Wire format of a connection, fixed by the first byte the client sends: a
+// framed message always starts with 0x00, a legacy bare JSON one never does.
+typedef enum {
+    WIRE_UNKNOWN = 0,
+    WIRE_FRAMED,
+    WIRE_LEGACY
+} WireMode;
+
+// A request waiting in net_when_drained()
+typedef struct DrainedWaiter {
+    DrainedHandler handler;
+    void *arg;
+    size_t below;
+    struct DrainedWaiter *next;
+} DrainedWaiter;
+
+typedef struct PendingRequest {
+    struct json_object *request;
+    struct PendingRequest *next;
+} PendingRequest;
+
+// Per-connection state. Buffers are only allocated while they hold data so an
+// idle connection costs little more than this struct.
+//
+// Only the event loop thread creates and frees connections. A connection with
+// a request in flight is never freed, so workers can safely net_send() to it.
+typedef struct Connection {
+    int fd;
+    unsigned long long id;  // Unique for the life of the process
+    char ip[46];
+    WireMode mode;
+    FrameBuffer in;         // Partial frame being reassembled (framed clients)
+    json_tokener *tok;      // Incremental parser for legacy clients, allocated on first byte of a request
+    int reading_paused;     // EPOLLIN disarmed until output drains, event loop thread only
+    pthread_mutex_t lock;   // Guards everything below
+    char *out_buf;          // Bytes not yet accepted by the kernel start at out_buf + out_off
+    size_t out_off;
+    size_t out_len;
+    size_t out_cap;
+    DrainedWaiter *drained; // Waiting for out_len to drop, see net_when_drained()
+    int inflight;           // Requests handed to workers and not yet done
+    int ordered_busy;       // One of them is an ordered (non-pipelined) request
+    int closing;            // Peer went away, free once inflight drops to 0
+    PendingRequest *backlog_head;   // Ordered requests waiting for the in-flight one
+    PendingRequest *backlog_tail;
+    int backlog_len;
+    struct Connection *next_close;
+} Connection;
+
+static Connection **connections = NULL;
+static int max_connections = 0;
+static int epoll_fd = -1;
+static RequestHandler request_handler = NULL;
+static json_tokener *frame_tok = NULL;     // Parses complete frame bodies, event loop thread only
+static unsigned long long next_connection_id = 1;
+static CloseHandler close_handler = NULL;
+
+// Connections whose last request finished after the peer disconnected.
+// Workers push here and wake the loop through wake_fd.
+static int wake_fd = -1;
+static Connection *close_list = NULL;
+static pthread_mutex_t close_list_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Pushed messages waiting for the event loop thread, oldest first. Only that
+// thread frees connections, so only it can safely check a target still exists.
+typedef struct PushMessage {
+    int sock;
+    unsigned long long conn_id;
+    size_t len;
+    struct PushMessage *next;
+    char data[];
+} PushMessage;
+
+// Set by net_request_hold() for the handler running on this thread
+static __thread int request_held = 0;
+
+static PushMessage *push_head = NULL;
+static PushMessage *push_tail = NULL;
+static pthread_mutex_t push_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return -1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static void drop_backlog(Connection *c) {
+    while (c->backlog_head) {
+        PendingRequest *p = c->backlog_head;
+        c->backlog_head = p->next;
+        json_object_put(p->request);
+        free(p);
+    }
+    c->backlog_tail = NULL;
+    c->backlog_len = 0;
+}
+
+static void close_connection(Connection *c) {
+    printf("Client disconnected: %s\n", c->ip);
+    if (close_handler) close_handler(c->fd, c->id);
+    connections[c->fd] = NULL;
+    close(c->fd);
+    if (c->tok) json_tokener_free(c->tok);
+    frame_buffer_free(&c->in);
+    drop_backlog(c);
+    free(c->out_buf);
+    pthread_mutex_destroy(&c->lock);
+    free(c);
+}
+
+// Unlinks the net_when_drained() waiters that are due. Caller holds c->lock
+// and passes the list to run_drained() once it has released it.
+static DrainedWaiter *take_drained(Connection *c) {
+    DrainedWaiter *due = NULL;
+    DrainedWaiter **link = &c->drained;
+    while (*link) {
+        DrainedWaiter *waiter = *link;
+        if (c->closing || c->out_len <= waiter->below) {
+            *link = waiter->next;
+            waiter->next = due;
+            due = waiter;
+        } else {
+            link = &waiter->next;
+        }
+    }
+    return due;
+}
+
+static void run_drained(DrainedWaiter *due, int sock, int closing) {
+    while (due) {
+        DrainedWaiter *next = due->next;
+        due->handler(sock, due->arg, closing);
+        free(due);
+        due = next;
+    }
+}
+
+// Closes the connection now, or as soon as its in-flight request completes.
+static void begin_close(Connection *c) {
+    pthread_mutex_lock(&c->lock);
+    c->closing = 1;
+    drop_backlog(c);
+    DrainedWaiter *due = take_drained(c);
+    int busy = c->inflight;
+    pthread_mutex_unlock(&c->lock);
+
+    // A waiting stream holds its request in flight, so c outlives the calls
+    run_drained(due, c->fd, 1);
+    if (!busy) close_connection(c);
+}
+
+static void wake_loop() {
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0) perror("eventfd write failed");
+}
+
+static void schedule_close(Connection *c) {
+    pthread_mutex_lock(&close_list_lock);
+    c->next_close = close_list;
+    close_list = c;
+    pthread_mutex_unlock(&close_list_lock);
+
+    wake_loop();
+}
+
+static void process_push_queue() {
+    pthread_mutex_lock(&push_lock);
+    PushMessage *list = push_head;
+    push_head = push_tail = NULL;
+    pthread_mutex_unlock(&push_lock);
+
+    while (list) {
+        PushMessage *next = list->next;
+        Connection *c = connections[list->sock];
+        if (c && c->id == list->conn_id && !c->closing) {
+            pthread_mutex_lock(&c->lock);
+            int backed_up = c->out_len > MAX_PUSH_BACKLOG;
+            pthread_mutex_unlock(&c->lock);
+
+            if (!backed_up) net_send(list->sock, list->data, list->len);
+        }
+        free(list);
+        list = next;
+    }
+}
+
+static void process_wakeups() {
+    uint64_t value;
+    while (read(wake_fd, &value, sizeof(value)) > 0) {}
+
+    process_push_queue();
+
+    pthread_mutex_lock(&close_list_lock);
+    Connection *list = close_list;
+    close_list = NULL;
+    pthread_mutex_unlock(&close_list_lock);
+
+    while (list) {
+        Connection *next = list->next_close;
+        close_connection(list);
+        list = next;
+    }
+}
+
+// Writes as much of the pending output as the socket accepts. Caller holds c->lock.
+// Returns -1 if the connection is broken.
+static int flush_output(Connection *c) {
+    while (c->out_len > 0) {
+        ssize_t n = send(c->fd, c->out_buf + c->out_off, c->out_len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return -1;
+        }
+        // The rest stays in place; net_send() compacts only when it needs the room
+        c->out_off += n;
+        c->out_len -= n;
+    }
+
+    if (c->out_len == 0) {
+        // Drop the buffer entirely so idle connections hold no output memory
+        free(c->out_buf);
+        c->out_buf = NULL;
+        c->out_off = c->out_cap = 0;
+    }
+    return 0;
+}
+
+int net_send(int sock, const char *data, size_t len) {
+    if (sock < 0 || sock >= max_connections || !connections[sock]) return -1;
+    Connection *c = connections[sock];
+    if (len > MAX_FRAME_SIZE) return -1;
+
+    // Header and body go into the buffer under one lock so concurrent
+    // responses on the same connection can never interleave.
+    size_t header_len = c->mode == WIRE_FRAMED ? FRAME_HEADER_SIZE : 0;
+
+    pthread_mutex_lock(&c->lock);
+    size_t needed = c->out_len + header_len + len;
+    if (c->out_off + needed > c->out_cap) {
+        if (needed > c->out_cap) {
+            size_t new_cap = c->out_cap ? c->out_cap : BUFFER_SIZE;
+            while (new_cap < needed) new_cap *= 2;
+            char *new_buf = realloc(c->out_buf, new_cap);
+            if (!new_buf) {
+                pthread_mutex_unlock(&c->lock);
+                return -1;
+            }
+            c->out_buf = new_buf;
+            c->out_cap = new_cap;
+        }
+        memmove(c->out_buf, c->out_buf + c->out_off, c->out_len);
+        c->out_off = 0;
+    }
+    char *tail = c->out_buf + c->out_off + c->out_len;
+    if (header_len) {
+        frame_encode_header((unsigned char *)tail, len);
+        tail += header_len;
+    }
+    memcpy(tail, data, len);
+    c->out_len = needed;
+
+    int result = flush_output(c);
+    DrainedWaiter *due = take_drained(c);
+    pthread_mutex_unlock(&c->lock);
+
+    run_drained(due, sock, 0);
+    return result;
+}
+
+int net_when_drained(int sock, size_t max_pending, DrainedHandler handler, void *arg) {
+    if (sock < 0 || sock >= max_connections || !connections[sock]) return -1;
+    Connection *c = connections[sock];
+
+    // Output only shrinks under c->lock and every flush checks for a waiting
+    // handler, so one registered here cannot miss its wakeup. The rest goes
+    // out on EPOLLOUT, which fires since the socket buffer is full.
+    DrainedWaiter *waiter = malloc(sizeof(DrainedWaiter));
+    if (!waiter) return -1;
+    waiter->handler = handler;
+    waiter->arg = arg;
+    waiter->below = max_pending;
+
+    int result;
+    pthread_mutex_lock(&c->lock);
+    if (c->closing) {
+        result = -1;
+    } else if (c->out_len <= max_pending) {
+        result = 0;
+    } else {
+        // Pipelined streams on one connection each wait here
+        waiter->next = c->drained;
+        c->drained = waiter;
+        waiter = NULL;
+        result = 1;
+    }
+    pthread_mutex_unlock(&c->lock);
+    free(waiter);
+    return result;
+}
+
+int net_request_is_pipelined(struct json_object *request) {
+    return json_object_object_get_ex(request, "request_id", NULL);
+}
+
+void net_request_done(int sock, int pipelined) {
+    if (sock < 0 || sock >= max_connections || !connections[sock]) return;
+    Connection *c = connections[sock];
+
+    pthread_mutex_lock(&c->lock);
+    if (!pipelined) {
+        PendingRequest *next = c->closing ? NULL : c->backlog_head;
+        if (next) {
+            // Hand the ordered slot straight to the next request, it stays in flight
+            c->backlog_head = next->next;
+            if (!c->backlog_head) c->backlog_tail = NULL;
+            c->backlog_len--;
+            pthread_mutex_unlock(&c->lock);
+
+            request_handler(sock, c->ip, next->request);
+            free(next);
+            return;
+        }
+        c->ordered_busy = 0;
+    }
+
+    c->inflight--;
+    int close_now = c->closing && c->inflight == 0;
+    pthread_mutex_unlock(&c->lock);
+
+    if (close_now) schedule_close(c);
+}
+
+void net_request_hold() {
+    request_held = 1;
+}
+
+int net_request_held() {
+    int held = request_held;
+    request_held = 0;
+    return held;
+}
+
+unsigned long long net_connection_id(int sock) {
+    if (sock < 0 || sock >= max_connections || !connections[sock]) return 0;
+    return connections[sock]->id;
+}
+
+int net_push(int sock, unsigned long long conn_id, const char *data, size_t len) {
+    if (sock < 0 || sock >= max_connections || len > MAX_FRAME_SIZE) return -1;
+
+    PushMessage *msg = malloc(sizeof(PushMessage) + len);
+    if (!msg) return -1;
+    msg->sock = sock;
+    msg->conn_id = conn_id;
+    msg->len = len;
+    msg->next = NULL;
+    memcpy(msg->data, data, len);
+
+    pthread_mutex_lock(&push_lock);
+    int was_empty = push_head == NULL;
+    if (push_tail) push_tail->next = msg;
+    else push_head = msg;
+    push_tail = msg;
+    pthread_mutex_unlock(&push_lock);
+
+    // One wakeup covers everything queued before the loop drains the list
+    if (was_empty) wake_loop();
+    return 0;
+}
+
+void net_set_close_handler(CloseHandler handler) {
+    close_handler = handler;
+}
+
+static void accept_connections(int listen_sock) {
+    while (1) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int sock = accept4(listen_sock, (struct sockaddr *)&client_addr, &client_len,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (sock < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("Accept failed");
+            return;
+        }
+
+        if (sock >= max_connections) {
+            fprintf(stderr, "Too many connections, rejecting fd %d\n", sock);
+            close(sock);
+            continue;
+        }
+
+        Connection *c = calloc(1, sizeof(Connection));
+        if (!c) {
+            close(sock);
+            continue;
+        }
+        c->fd = sock;
+        c->id = next_connection_id++;
+        pthread_mutex_init(&c->lock, NULL);
+        strncpy(c->ip, inet_ntoa(client_addr.sin_addr), 45);
+        c->ip[45] = '\0';
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = sock;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock, &ev) < 0) {
+            perror("epoll_ctl failed");
+            close(sock);
+            pthread_mutex_destroy(&c->lock);
+            free(c);
+            continue;
+        }
+        connections[sock] = c;
+
+        printf("New client connected from %s:%d\n", c->ip, ntohs(client_addr.sin_port));
+    }
+}
+
+static void reject_request(Connection *c, struct json_object *request,
+                           int status, const char *code, const char *message) {
+    set_request_context(request, c->ip);
+    send_error_response(c->fd, status, code, message);
+    set_request_context(NULL, NULL);
+    json_object_put(request);
+}
+
+static void reject_busy(Connection *c, struct json_object *request) {
+    reject_request(c, request, STATUS_SERVICE_UNAVAILABLE, "ERROR_SERVER_BUSY", "Too many pending requests");
+}
+
+// Passes a request to the handler. Ordered requests are parked behind the one
+// already in flight so their responses keep request order; pipelined ones go
+// straight through, up to MAX_PIPELINED_REQUESTS per connection.
+static void submit_request(Connection *c, struct json_object *request) {
+    pthread_mutex_lock(&c->lock);
+    if (net_request_is_pipelined(request)) {
+        if (c->inflight - c->ordered_busy >= MAX_PIPELINED_REQUESTS) {
+            pthread_mutex_unlock(&c->lock);
+            reject_busy(c, request);
+            return;
+        }
+        c->inflight++;
+        pthread_mutex_unlock(&c->lock);
+
+        request_handler(c->fd, c->ip, request);
+        return;
+    }
+
+    if (c->ordered_busy) {
+        if (c->backlog_len >= MAX_PENDING_REQUESTS) {
+            pthread_mutex_unlock(&c->lock);
+            reject_busy(c, request);
+            return;
+        }
+
+        PendingRequest *p = malloc(sizeof(PendingRequest));
+        if (!p) {
+            pthread_mutex_unlock(&c->lock);
+            reject_request(c, request, STATUS_INTERNAL_ERROR, "ERROR_INTERNAL_SERVER", "Out of memory");
+            return;
+        }
+        p->request = request;
+        p->next = NULL;
+        if (c->backlog_tail) c->backlog_tail->next = p;
+        else c->backlog_head = p;
+        c->backlog_tail = p;
+        c->backlog_len++;
+        pthread_mutex_unlock(&c->lock);
+        return;
+    }
+    c->ordered_busy = 1;
+    c->inflight++;
+    pthread_mutex_unlock(&c->lock);
+
+    request_handler(c->fd, c->ip, request);
+}
+
+// Legacy path: feeds freshly read bytes to the connection's streaming JSON
+// parser and submits every complete request.
+static void process_legacy_input(Connection *c, const char *data, int len) {
+    int offset = 0;
+
+    while (offset < len) {
+        if (!c->tok) c->tok = json_tokener_new();
+
+        struct json_object *request = json_tokener_parse_ex(c->tok, data + offset, len - offset);
+        enum json_tokener_error err = json_tokener_get_error(c->tok);
+
+        if (err == json_tokener_continue) break;
+
+        if (err != json_tokener_success) {
+            // The stream cannot be resynchronised, discard what is left of this read
+            send_error_response(c->fd, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Invalid JSON format");
+            json_tokener_free(c->tok);
+            c->tok = NULL;
+            break;
+        }
+
+        offset += json_tokener_get_parse_end(c->tok);
+        json_tokener_reset(c->tok);
+
+        if (offset >= len) {
+            // Nothing partial is pending, release the parser while idle
+            json_tokener_free(c->tok);
+            c->tok = NULL;
+        }
+
+        submit_request(c, request);
+    }
+}
+
+// Framed path: appends the bytes to the reassembly buffer and submits every
+// frame that is now complete. Returns -1 if the stream is unusable.
+static int process_framed_input(Connection *c, const char *data, int len) {
+    if (frame_buffer_append(&c->in, data, len) < 0) {
+        fprintf(stderr, "Out of memory reassembling request from %s\n", c->ip);
+        return -1;
+    }
+
+    const char *body;
+    size_t body_len;
+    int result;
+    while ((result = frame_buffer_next(&c->in, &body, &body_len)) > 0) {
+        json_tokener_reset(frame_tok);
+        struct json_object *request = json_tokener_parse_ex(frame_tok, body, (int)body_len);
+
+        if (json_tokener_get_error(frame_tok) != json_tokener_success) {
+            // The frame boundary is intact, only this message is lost
+            if (request) json_object_put(request);
+            send_error_response(c->fd, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Invalid JSON format");
+            continue;
+        }
+
+        submit_request(c, request);
+    }
+
+    if (result < 0) {
+        send_error_response(c->fd, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Message too large");
+        return -1;
+    }
+
+    frame_buffer_trim(&c->in);
+    return 0;
+}
+
+static int process_input(Connection *c, const char *data, int len) {
+    if (c->mode == WIRE_UNKNOWN) {
+        c->mode = data[0] == 0 ? WIRE_FRAMED : WIRE_LEGACY;
+    }
+
+    if (c->mode == WIRE_FRAMED) return process_framed_input(c, data, len);
+
+    process_legacy_input(c, data, len);
+    return 0;
+}
+
+// Arms or disarms EPOLLIN. EPOLL_CTL_MOD re-checks readiness, so input that
+// arrived while reading was paused is reported again once it is re-armed.
+static int set_reading(Connection *c, int enabled) {
+    struct epoll_event ev;
+    ev.events = (enabled ? EPOLLIN : 0) | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.fd = c->fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev) < 0) {
+        perror("epoll_ctl failed");
+        return -1;
+    }
+    c->reading_paused = !enabled;
+    return 0;
+}
+
+// Reads until the kernel buffer is drained, as required by edge-triggered mode,
+// or until the client has more unsent responses than OUTPUT_HIGH_WATER. A
+// client that pipelines requests without reading the answers then waits in
+// its own socket buffer instead of growing ours.
+// Returns -1 when the peer closed the connection or an error occurred.
+static int read_input(Connection *c) {
+    char buffer[BUFFER_SIZE];
+
+    while (1) {
+        pthread_mutex_lock(&c->lock);
+        int backed_up = c->out_len > OUTPUT_HIGH_WATER;
+        pthread_mutex_unlock(&c->lock);
+        if (backed_up) return set_reading(c, 0);
+
+        ssize_t n = recv(c->fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            if (process_input(c, buffer, n) < 0) return -1;
+            continue;
+        }
+        if (n == 0) return -1;
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        return -1;
+    }
+}
+
+int event_loop_run(int listen_sock, RequestHandler handler) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY) {
+        max_connections = (int)rl.rlim_cur;
+    } else {
+        max_connections = 65536;
+    }
+
+    connections = calloc(max_connections, sizeof(Connection *));
+    if (!connections) {
+        fprintf(stderr, "Failed to allocate connection table\n");
+        return -1;
+    }
+
+    request_handler = handler;
+    frame_tok = json_tokener_new();
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wake_fd < 0) {
+        perror("epoll/eventfd creation failed");
+        return -1;
+    }
+
+    if (set_nonblocking(listen_sock) < 0) {
+        perror("Failed to make listening socket non-blocking");
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = listen_sock;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_sock, &ev) < 0) {
+        perror("epoll_ctl failed");
+        return -1;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.fd = wake_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) < 0) {
+        perror("epoll_ctl failed");
+        return -1;
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+
+    while (1) {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait failed");
+            return -1;
+        }
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+
+            if (fd == listen_sock) {
+                accept_connections(listen_sock);
+                continue;
+            }
+            if (fd == wake_fd) {
+                process_wakeups();
+                continue;
+            }
+
+            Connection *c = connections[fd];
+            if (!c || c->closing) continue;
+
+            if (events[i].events & EPOLLOUT) {
+                pthread_mutex_lock(&c->lock);
+                int result = flush_output(c);
+                DrainedWaiter *due = result < 0 ? NULL : take_drained(c);
+                int resume = c->reading_paused && c->out_len <= OUTPUT_LOW_WATER;
+                pthread_mutex_unlock(&c->lock);
+                if (result < 0) {
+                    begin_close(c);
+                    continue;
+                }
+                run_drained(due, fd, 0);
+                if (resume && set_reading(c, 1) < 0) {
+                    begin_close(c);
+                    continue;
+                }
+            }
+
+            if (c->reading_paused) {
+                // A half-close is read as EOF once reading resumes, but a
+                // full hang-up means the pending output can never go out
+                if (events[i].events & (EPOLLHUP | EPOLLERR)) begin_close(c);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                if (read_input(c) < 0) begin_close(c);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stddef.h>
+#include <json-c/json.h>
+
+// Called for every complete request read from a client. Ownership of request
+// passes to the callee, which must call net_request_done() once the request
+// has been answered.
+//
+// Requests without a request_id are handed out one at a time per connection
+// so their responses keep request order. Requests carrying a top-level
+// request_id are pipelined: they run concurrently and may complete in any order.
+typedef void (*RequestHandler)(int sock, const char *client_ip, struct json_object *request);
+
+// Runs the epoll reactor on an already listening socket. Only returns on fatal error.
+int event_loop_run(int listen_sock, RequestHandler handler);
+
+// Queues one whole message for a client socket owned by the event loop, adding
+// a length header if the client speaks the framed protocol. Whatever cannot be
+// written immediately is kept in the connection's output buffer and flushed
+// when the socket becomes writable again.
+int net_send(int sock, const char *data, size_t len);
+
+// Called once the output queued for a connection is down to the size given
+// to net_when_drained(), or with closing set if the connection is going away
+// first. Runs on whichever thread flushed the output, with no locks held, so
+// it must not block.
+typedef void (*DrainedHandler)(int sock, void *arg, int closing);
+
+// Lets a handler streaming a long response wait for a slow client without
+// holding a thread, so it never buffers all of it. Returns 1 if handler will
+// be called later, 0 if at most max_pending bytes are unsent already (carry
+// on now), or -1 if the connection is closing or out of memory. Only valid
+// while a request is in flight on sock; each pipelined request may wait.
+int net_when_drained(int sock, size_t max_pending, DrainedHandler handler, void *arg);
+
+int net_request_is_pipelined(struct json_object *request);
+
+// Marks a request as finished so the next queued one (if any) can be handed
+// out. pipelined must be what net_request_is_pipelined() said for that request.
+// Safe to call from any thread.
+void net_request_done(int sock, int pipelined);
+
+// Called by a handler that hands its request on (e.g. to a net_when_drained()
+// callback): the request stays in flight after the handler returns, and
+// whoever finishes it calls net_request_done(). net_request_held() tells the
+// caller of the handler, and resets for the next request on this thread.
+void net_request_hold();
+int net_request_held();
+
+// Server push. Connections are identified by (sock, id) since descriptors
+// are reused. net_connection_id() may only be called while a request is in
+// flight on sock, e.g. from its handler.
+unsigned long long net_connection_id(int sock);
+
+// Queues a message for a connection from any thread. It is delivered by the
+// event loop thread if the connection is still open by then, and dropped
+// otherwise or if the client has stopped reading.
+int net_push(int sock, unsigned long long conn_id, const char *data, size_t len);
+
+// Called on the event loop thread whenever a connection is closed.
+typedef void (*CloseHandler)(int sock, unsigned long long conn_id);
+void net_set_close_handler(CloseHandler handler);
+
+#endif
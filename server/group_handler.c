@@ -1,14 +1,34 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <time.h>
 #include <sys/socket.h>
 #include <json-c/json.h>
 #include "group_handler.h"
 #include "database.h"
 #include "auth_handler.h"
+#include "notify_hub.h"
+#include "event_loop.h"
+#include "group_search.h"
+#include "user_search.h"
+#include "worker_pool.h"
 #include "../common/protocol.h"
 
+// Tells the whole group about a new member with a single group-scoped row
+static void announce_member_joined(int group_id, const char *username, const char *group_name) {
+    char notif_title[255];
+    char notif_message[512];
+    snprintf(notif_title, sizeof(notif_title), "New Member");
+    snprintf(notif_message, sizeof(notif_message),
+            "%s has joined '%s'",
+            username ? username : "A new member",
+            group_name ? group_name : "the group");
+    
+    db_create_group_notification(group_id, "MEMBER_JOINED",
+                                 notif_title, notif_message, "GROUP", group_id);
+}
+
 void handle_create_group(int sock, struct json_object *request) {
     struct json_object *data_obj, *field;
     
@@ -65,8 +85,7 @@ void handle_create_group(int sock, struct json_object *request) {
     json_object_object_add(payload, "created_at", json_object_new_string(timestamp));
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
     json_object_put(response);
@@ -126,13 +145,211 @@ void handle_list_my_groups(int sock, struct json_object *request) {
     json_object_object_add(payload, "groups", groups_array);
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
     json_object_put(response);
 }
 
+#define MEMBER_STREAM_CHUNK 500                 // Members per frame when streaming
+#define MEMBER_STREAM_MAX_PENDING (256 * 1024)  // Unsent bytes before the stream waits for the client
+
+// Every paged handler's cursor travels as "<int64>-<int>"; clients treat them
+// as opaque. The handlers below say what the two parts hold.
+#define CURSOR_TEXT_MAX 32
+
+static void format_cursor(long long major, int minor, char *buf, size_t size) {
+    snprintf(buf, size, "%lld-%d", major, minor);
+}
+
+static int parse_cursor(const char *text, long long *major, int *minor) {
+    int consumed = 0;
+    return sscanf(text, "%lld-%d%n", major, minor, &consumed) == 2 && text[consumed] == '\0';
+}
+
+// Sets *text to the cursor under key in data_obj. Returns 0 if there is none,
+// -1 if it is not a string.
+static int get_cursor_string(struct json_object *data_obj, const char *key, const char **text) {
+    struct json_object *field;
+    if (!json_object_object_get_ex(data_obj, key, &field)) return 0;
+    if (!json_object_is_type(field, json_type_string)) return -1;
+    *text = json_object_get_string(field);
+    return 1;
+}
+
+// Member cursors hold <joined_us>-<user_id>
+static void format_member_cursor(const MemberInfo *member, char *buf, size_t size) {
+    format_cursor(member->joined_us, member->user_id, buf, size);
+}
+
+static int parse_member_cursor(const char *text, MemberCursor *cursor) {
+    return parse_cursor(text, &cursor->joined_us, &cursor->user_id);
+}
+
+// Response for one page of members. next_cursor is set when more follow.
+static struct json_object *member_page_response(int group_id, const MemberInfo *members, int count, int has_more) {
+    struct json_object *response = json_object_new_object();
+    json_object_object_add(response, "status", json_object_new_int(STATUS_OK));
+    json_object_object_add(response, "code", json_object_new_string("SUCCESS_LIST_MEMBERS"));
+    json_object_object_add(response, "message", json_object_new_string("Members retrieved successfully"));
+    
+    struct json_object *payload = json_object_new_object();
+    json_object_object_add(payload, "group_id", json_object_new_int(group_id));
+    
+    struct json_object *members_array = json_object_new_array();
+    
+    for (int i = 0; i < count; i++) {
+        struct json_object *member_obj = json_object_new_object();
+        json_object_object_add(member_obj, "user_id", json_object_new_int(members[i].user_id));
+        json_object_object_add(member_obj, "username", json_object_new_string(members[i].username));
+        json_object_object_add(member_obj, "full_name", json_object_new_string(members[i].full_name));
+        json_object_object_add(member_obj, "role", json_object_new_string(members[i].role));
+        json_object_object_add(member_obj, "status", json_object_new_string(members[i].status));
+        json_object_object_add(member_obj, "joined_at", json_object_new_string(members[i].joined_at));
+        json_object_array_add(members_array, member_obj);
+    }
+    
+    json_object_object_add(payload, "members", members_array);
+    json_object_object_add(payload, "has_more", json_object_new_boolean(has_more));
+    if (has_more) {
+        char cursor[CURSOR_TEXT_MAX];
+        format_member_cursor(&members[count - 1], cursor, sizeof(cursor));
+        json_object_object_add(payload, "next_cursor", json_object_new_string(cursor));
+    }
+    json_object_object_add(response, "payload", payload);
+    return response;
+}
+
+// State of a streamed member list between chunks. The request stays in
+// flight until the stream ends, which keeps the connection and the order of
+// its responses.
+typedef struct {
+    int sock;
+    int pipelined;
+    struct json_object *context;    // Copy of the request_id, the request goes when the handler returns
+    char client_ip[46];
+    int group_id;
+    MemberCursor cursor;
+    int has_cursor;
+    int total;
+} MemberStream;
+
+static void member_stream_drained(int sock, void *arg, int closing);
+
+// Sends the next chunk. Returns 1 if more follow.
+static int send_member_chunk(MemberStream *stream) {
+    MemberInfo *members = NULL;
+    int has_more = 0;
+    int count = db_get_group_members(stream->group_id, stream->has_cursor ? &stream->cursor : NULL,
+                                     MEMBER_STREAM_CHUNK, &members, &has_more);
+    if (count < 0) {
+        send_error_response(stream->sock, STATUS_INTERNAL_ERROR, "ERROR_INTERNAL_SERVER", "Failed to list members");
+        return 0;
+    }
+    
+    stream->total += count;
+    struct json_object *response = member_page_response(stream->group_id, members, count, has_more);
+    struct json_object *payload;
+    json_object_object_get_ex(response, "payload", &payload);
+    json_object_object_add(payload, "done", json_object_new_boolean(!has_more));
+    if (!has_more) {
+        json_object_object_add(payload, "total_count", json_object_new_int(stream->total));
+    } else {
+        stream->cursor.joined_us = members[count - 1].joined_us;
+        stream->cursor.user_id = members[count - 1].user_id;
+        stream->has_cursor = 1;
+    }
+    free(members);
+    
+    send_json_response(stream->sock, response);
+    json_object_put(response);
+    return has_more;
+}
+
+static void finish_member_stream(MemberStream *stream) {
+    int sock = stream->sock;
+    int pipelined = stream->pipelined;
+    json_object_put(stream->context);
+    free(stream);
+    net_request_done(sock, pipelined);
+}
+
+// Sends chunks while the client keeps up. Once too much is unsent, returns
+// and lets member_stream_drained() pick up on a worker again.
+static void continue_member_stream(MemberStream *stream) {
+    while (send_member_chunk(stream)) {
+        // Don't hold a pooled connection while a slow client catches up
+        db_release_connection();
+        int waiting = net_when_drained(stream->sock, MEMBER_STREAM_MAX_PENDING, member_stream_drained, stream);
+        if (waiting > 0) return;
+        if (waiting < 0) break;
+    }
+    finish_member_stream(stream);
+}
+
+static void member_stream_task(void *arg) {
+    MemberStream *stream = arg;
+    set_request_context(stream->context, stream->client_ip);
+    continue_member_stream(stream);
+    set_request_context(NULL, NULL);
+    db_release_connection();
+}
+
+// May run on any thread in the middle of its own work, so it only queues the
+// next chunk, or ends the stream if that is not possible
+static void member_stream_drained(int sock, void *arg, int closing) {
+    MemberStream *stream = arg;
+    if (closing) {
+        finish_member_stream(stream);
+        return;
+    }
+    if (worker_pool_submit_task(member_stream_task, stream) < 0) {
+        // Built by hand: the request context of this thread belongs to
+        // whatever it was doing
+        struct json_object *response = json_object_new_object();
+        json_object_object_add(response, "status", json_object_new_int(STATUS_SERVICE_UNAVAILABLE));
+        json_object_object_add(response, "code", json_object_new_string("ERROR_SERVER_BUSY"));
+        json_object_object_add(response, "message", json_object_new_string("Server is overloaded, try again later"));
+        json_object_object_add(response, "payload", json_object_new_object());
+        struct json_object *request_id;
+        if (json_object_object_get_ex(stream->context, "request_id", &request_id)) {
+            json_object_object_add(response, "request_id", json_object_get(request_id));
+        }
+        const char *json_str = json_object_to_json_string(response);
+        net_send(sock, json_str, strlen(json_str));
+        json_object_put(response);
+        finish_member_stream(stream);
+    }
+}
+
+// Sends the whole member list as consecutive SUCCESS_LIST_MEMBERS frames of
+// MEMBER_STREAM_CHUNK rows, the last one with "done": true. Only one chunk is
+// held at a time and the next is read only once the client has taken most of
+// the previous ones; no thread waits for it meanwhile.
+static void stream_group_members(int sock, struct json_object *request, int group_id, const MemberCursor *start) {
+    MemberStream *stream = calloc(1, sizeof(MemberStream));
+    if (!stream) {
+        send_error_response(sock, STATUS_INTERNAL_ERROR, "ERROR_INTERNAL_SERVER", "Failed to list members");
+        return;
+    }
+    stream->sock = sock;
+    stream->pipelined = net_request_is_pipelined(request);
+    stream->context = json_object_new_object();
+    struct json_object *request_id;
+    if (json_object_object_get_ex(request, "request_id", &request_id)) {
+        // json-c reference counts are not atomic, so copy rather than share
+        json_object_object_add(stream->context, "request_id",
+                               json_tokener_parse(json_object_to_json_string(request_id)));
+    }
+    snprintf(stream->client_ip, sizeof(stream->client_ip), "%s", request_client_ip());
+    stream->group_id = group_id;
+    if (start) stream->cursor = *start;
+    stream->has_cursor = start != NULL;
+    
+    net_request_hold();
+    continue_member_stream(stream);
+}
+
 void handle_list_group_members(int sock, struct json_object *request) {
     struct json_object *data_obj, *field;
     
@@ -143,11 +360,27 @@ void handle_list_group_members(int sock, struct json_object *request) {
     
     const char *session_token = NULL;
     int group_id = 0;
+    int limit = MEMBER_PAGE_DEFAULT;
+    int stream = 0;
+    MemberCursor after;
+    const char *cursor_text;
     
     if (json_object_object_get_ex(data_obj, "session_token", &field))
         session_token = json_object_get_string(field);
     if (json_object_object_get_ex(data_obj, "group_id", &field))
         group_id = json_object_get_int(field);
+    if (json_object_object_get_ex(data_obj, "limit", &field)) {
+        limit = json_object_get_int(field);
+        if (limit < 1) limit = 1;
+        if (limit > MEMBER_PAGE_MAX) limit = MEMBER_PAGE_MAX;
+    }
+    if (json_object_object_get_ex(data_obj, "stream", &field))
+        stream = json_object_get_boolean(field);
+    int has_after = get_cursor_string(data_obj, "after", &cursor_text);
+    if (has_after < 0 || (has_after && !parse_member_cursor(cursor_text, &after))) {
+        send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_CURSOR", "Invalid member cursor");
+        return;
+    }
     
     if (!session_token || group_id <= 0) {
         send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Missing required fields");
@@ -167,42 +400,28 @@ void handle_list_group_members(int sock, struct json_object *request) {
         send_error_response(sock, STATUS_FORBIDDEN, "ERROR_FORBIDDEN", "You are not a member of this group");
         return;
     }
+    free(user);
     
-    // Get group members
-    MemberInfo **members = NULL;
-    int count = db_get_group_members(group_id, &members);
-    
-    // Send success response
-    struct json_object *response = json_object_new_object();
-    json_object_object_add(response, "status", json_object_new_int(STATUS_OK));
-    json_object_object_add(response, "code", json_object_new_string("SUCCESS_LIST_MEMBERS"));
-    json_object_object_add(response, "message", json_object_new_string("Members retrieved successfully"));
-    
-    struct json_object *payload = json_object_new_object();
-    json_object_object_add(payload, "group_id", json_object_new_int(group_id));
-    
-    struct json_object *members_array = json_object_new_array();
+    if (stream) {
+        stream_group_members(sock, request, group_id, has_after ? &after : NULL);
+        return;
+    }
     
-    for (int i = 0; i < count; i++) {
-        struct json_object *member_obj = json_object_new_object();
-        json_object_object_add(member_obj, "user_id", json_object_new_int(members[i]->user_id));
-        json_object_object_add(member_obj, "username", json_object_new_string(members[i]->username));
-        json_object_object_add(member_obj, "full_name", json_object_new_string(members[i]->full_name));
-        json_object_object_add(member_obj, "role", json_object_new_string(members[i]->role));
-        json_object_object_add(member_obj, "status", json_object_new_string(members[i]->status));
-        json_object_object_add(member_obj, "joined_at", json_object_new_string(members[i]->joined_at));
-        json_object_array_add(members_array, member_obj);
-        free(members[i]);
+    // Get one page of group members
+    MemberInfo *members = NULL;
+    int has_more = 0;
+    int count = db_get_group_members(group_id, has_after ? &after : NULL, limit, &members, &has_more);
+    if (count < 0) {
+        send_error_response(sock, STATUS_INTERNAL_ERROR, "ERROR_INTERNAL_SERVER", "Failed to list members");
+        return;
     }
-    if (members) free(members);
     
-    json_object_object_add(payload, "members", members_array);
-    json_object_object_add(response, "payload", payload);
+    // Send success response
+    struct json_object *response = member_page_response(group_id, members, count, has_more);
+    free(members);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
-    free(user);
     json_object_put(response);
 }
 
@@ -250,11 +469,8 @@ void handle_request_join_group(int sock, struct json_object *request) {
     }
     
     // Tạo thông báo cho tất cả admin của group
-    int *admin_ids = NULL;
-    int admin_count = db_get_group_admin_ids(group_id, &admin_ids);
-    
-    char *group_name = db_get_group_name_by_id(group_id);
-    char *username = db_get_username_by_id(user->user_id);
+    const char *group_name = db_get_group_name_by_id(group_id);
+    const char *username = db_get_username_by_id(user->user_id);
     char *full_name = user->full_name;
     
     char notif_title[255];
@@ -266,14 +482,11 @@ void handle_request_join_group(int sock, struct json_object *request) {
             username ? username : "Unknown",
             group_name ? group_name : "the group");
     
-    for (int i = 0; i < admin_count; i++) {
-        db_create_notification(admin_ids[i], "JOIN_REQUEST",
-                             notif_title, notif_message, "GROUP", group_id);
-    }
+    db_notify_group_admins(group_id, "JOIN_REQUEST",
+                           notif_title, notif_message, "GROUP", group_id);
     
-    if (admin_ids) free(admin_ids);
-    if (group_name) free(group_name);
-    if (username) free(username);
+    db_release_name(group_name);
+    db_release_name(username);
     
     // Get current time
     time_t now = time(NULL);
@@ -294,8 +507,7 @@ void handle_request_join_group(int sock, struct json_object *request) {
     json_object_object_add(payload, "created_at", json_object_new_string(created_at));
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
     json_object_put(response);
@@ -357,8 +569,7 @@ void handle_list_join_requests(int sock, struct json_object *request) {
     json_object_object_add(payload, "requests", requests_array);
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
     json_object_put(response);
@@ -386,33 +597,33 @@ void handle_approve_join_request(int sock, struct json_object *request) {
         return;
     }
     
-    // Get request info to check group
-    JoinRequestInfo *req_info = db_get_join_request_by_id(request_id);
-    if (!req_info) {
+    // Approve or reject; the admin check and the pending check happen in the
+    // same database call, so a request is only ever reviewed once
+    JoinRequestInfo req_info;
+    int result = db_approve_join_request(request_id, user->user_id, action, &req_info);
+    if (result == -2) {
         send_error_response(sock, STATUS_NOT_FOUND, "ERROR_NOT_FOUND", "Join request not found");
         free(user);
         return;
-    }
-    
-    // Check if user is admin
-    if (!db_is_group_admin(user->user_id, req_info->group_id)) {
+    } else if (result == -3) {
         send_error_response(sock, STATUS_FORBIDDEN, "ERROR_FORBIDDEN", "Only admins can approve/reject requests");
         free(user);
-        free(req_info);
         return;
-    }
-    
-    // Approve or reject
-    if (db_approve_join_request(request_id, user->user_id, action) < 0) {
+    } else if (result == -4) {
+        char message[64];
+        snprintf(message, sizeof(message), "Join request already %s", req_info.status);
+        send_error_response(sock, STATUS_CONFLICT, "ERROR_CONFLICT", message);
+        free(user);
+        return;
+    } else if (result < 0) {
         send_error_response(sock, STATUS_INTERNAL_ERROR, "ERROR_INTERNAL_SERVER", "Failed to process request");
         free(user);
-        free(req_info);
         return;
     }
 
     // Tạo thông báo cho người gửi request
-    char *group_name = db_get_group_name_by_id(req_info->group_id);
-    char *admin_username = db_get_username_by_id(user->user_id);
+    const char *group_name = db_get_group_name_by_id(req_info.group_id);
+    const char *admin_username = db_get_username_by_id(user->user_id);
     
     char notif_title[255];
     char notif_message[512];
@@ -431,11 +642,15 @@ void handle_approve_join_request(int sock, struct json_object *request) {
                 admin_username ? admin_username : "Admin");
     }
     
-    db_create_notification(req_info->user_id, "JOIN_REQUEST_RESPONSE", 
-                          notif_title, notif_message, "GROUP", req_info->group_id);
+    db_create_notification(req_info.user_id, "JOIN_REQUEST_RESPONSE", 
+                          notif_title, notif_message, "GROUP", req_info.group_id);
     
-    if (group_name) free(group_name);
-    if (admin_username) free(admin_username);
+    if (strcmp(action, "approve") == 0) {
+        announce_member_joined(req_info.group_id, req_info.username, group_name);
+    }
+    
+    db_release_name(group_name);
+    db_release_name(admin_username);
     
     // Get current time
     time_t now = time(NULL);
@@ -452,18 +667,16 @@ void handle_approve_join_request(int sock, struct json_object *request) {
     
     struct json_object *payload = json_object_new_object();
     json_object_object_add(payload, "request_id", json_object_new_int(request_id));
-    json_object_object_add(payload, "user_id", json_object_new_int(req_info->user_id));
-    json_object_object_add(payload, "group_id", json_object_new_int(req_info->group_id));
+    json_object_object_add(payload, "user_id", json_object_new_int(req_info.user_id));
+    json_object_object_add(payload, "group_id", json_object_new_int(req_info.group_id));
     json_object_object_add(payload, "status", json_object_new_string(
         strcmp(action, "approve") == 0 ? "approved" : "rejected"));
     json_object_object_add(payload, "reviewed_at", json_object_new_string(reviewed_at));
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
-    free(req_info);
     json_object_put(response);
 }
 
@@ -496,41 +709,30 @@ void handle_invite_to_group(int sock, struct json_object *request) {
         return;
     }
     
-    // Get invitee info
-    UserInfo *invitee = db_get_user_by_username(invitee_username);
-    if (!invitee) {
-        send_error_response(sock, STATUS_NOT_FOUND, "ERROR_NOT_FOUND", "User not found");
-        free(user);
-        return;
-    }
-    
-    // Send invitation
-    int invitation_id = db_invite_to_group(user->user_id, group_id, invitee_username);
+    // Send invitation; looks the invitee up in the same database call
+    int invitee_id = 0;
+    int invitation_id = db_invite_to_group(user->user_id, group_id, invitee_username, &invitee_id);
     if (invitation_id == -2) {
         send_error_response(sock, STATUS_NOT_FOUND, "ERROR_NOT_FOUND", "User not found");
         free(user);
-        free(invitee);
         return;
     } else if (invitation_id == -3) {
         send_error_response(sock, STATUS_CONFLICT, "ERROR_CONFLICT", "User is already a member");
         free(user);
-        free(invitee);
         return;
     } else if (invitation_id == -4) {
         send_error_response(sock, STATUS_CONFLICT, "ERROR_CONFLICT", "Invitation already pending");
         free(user);
-        free(invitee);
         return;
     } else if (invitation_id < 0) {
         send_error_response(sock, STATUS_INTERNAL_ERROR, "ERROR_INTERNAL_SERVER", "Failed to send invitation");
         free(user);
-        free(invitee);
         return;
     }
     
     // Tạo thông báo cho người được mời
-    char *group_name = db_get_group_name_by_id(group_id);
-    char *inviter_username = db_get_username_by_id(user->user_id);
+    const char *group_name = db_get_group_name_by_id(group_id);
+    const char *inviter_username = db_get_username_by_id(user->user_id);
     
     char notif_title[255];
     char notif_message[512];
@@ -540,11 +742,11 @@ void handle_invite_to_group(int sock, struct json_object *request) {
             inviter_username ? inviter_username : "An admin",
             group_name ? group_name : "a group");
     
-    db_create_notification(invitee->user_id, "GROUP_INVITATION",
+    db_create_notification(invitee_id, "GROUP_INVITATION",
                           notif_title, notif_message, "GROUP", group_id);
     
-    if (group_name) free(group_name);
-    if (inviter_username) free(inviter_username);
+    db_release_name(group_name);
+    db_release_name(inviter_username);
     
     // Get current time
     time_t now = time(NULL);
@@ -561,16 +763,14 @@ void handle_invite_to_group(int sock, struct json_object *request) {
     json_object_object_add(payload, "invitation_id", json_object_new_int(invitation_id));
     json_object_object_add(payload, "group_id", json_object_new_int(group_id));
     json_object_object_add(payload, "inviter_id", json_object_new_int(user->user_id));
-    json_object_object_add(payload, "invitee_id", json_object_new_int(invitee->user_id));
+    json_object_object_add(payload, "invitee_id", json_object_new_int(invitee_id));
     json_object_object_add(payload, "status", json_object_new_string("pending"));
     json_object_object_add(payload, "created_at", json_object_new_string(created_at));
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
-    free(invitee);
     json_object_put(response);
 }
 
@@ -621,8 +821,7 @@ void handle_list_my_invitations(int sock, struct json_object *request) {
     json_object_object_add(payload, "invitations", invitations_array);
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
     json_object_put(response);
@@ -650,37 +849,32 @@ void handle_respond_invitation(int sock, struct json_object *request) {
         return;
     }
     
-    // Get invitation info
-    InvitationInfo *inv_info = db_get_invitation_by_id(invitation_id);
-    if (!inv_info) {
+    // Respond to invitation; ownership and the pending check happen in the
+    // same database call, so an invitation is only ever answered once
+    int group_id = 0;
+    int result = db_respond_invitation(invitation_id, user->user_id, action, &group_id);
+    if (result == -2) {
         send_error_response(sock, STATUS_NOT_FOUND, "ERROR_NOT_FOUND", "Invitation not found");
         free(user);
         return;
-    }
-    
-    // Check if user is the invitee
-    if (inv_info->invitee_id != user->user_id) {
+    } else if (result == -3) {
         send_error_response(sock, STATUS_FORBIDDEN, "ERROR_FORBIDDEN", "You can only respond to your own invitations");
         free(user);
-        free(inv_info);
         return;
-    }
-    
-    // Respond to invitation
-    if (db_respond_invitation(invitation_id, action) < 0) {
+    } else if (result == -4) {
+        send_error_response(sock, STATUS_CONFLICT, "ERROR_CONFLICT", "Invitation already answered");
+        free(user);
+        return;
+    } else if (result < 0) {
         send_error_response(sock, STATUS_INTERNAL_ERROR, "ERROR_INTERNAL_SERVER", "Failed to respond to invitation");
         free(user);
-        free(inv_info);
         return;
     }
 
     // Nếu accept -> Gửi thông báo cho admin
     if (strcmp(action, "accept") == 0) {
-        int *admin_ids = NULL;
-        int admin_count = db_get_group_admin_ids(inv_info->group_id, &admin_ids);
-        
-        char *group_name = db_get_group_name_by_id(inv_info->group_id);
-        char *username = db_get_username_by_id(user->user_id);
+        const char *group_name = db_get_group_name_by_id(group_id);
+        const char *username = db_get_username_by_id(user->user_id);
         
         char notif_title[255];
         char notif_message[512];
@@ -690,14 +884,12 @@ void handle_respond_invitation(int sock, struct json_object *request) {
                 username ? username : "A user",
                 group_name ? group_name : "the group");
         
-        for (int i = 0; i < admin_count; i++) {
-            db_create_notification(admin_ids[i], "INVITATION_ACCEPTED",
-                                 notif_title, notif_message, "GROUP", inv_info->group_id);
-        }
+        db_notify_group_admins(group_id, "INVITATION_ACCEPTED",
+                               notif_title, notif_message, "GROUP", group_id);
+        announce_member_joined(group_id, username, group_name);
         
-        if (admin_ids) free(admin_ids);
-        if (group_name) free(group_name);
-        if (username) free(username);
+        db_release_name(group_name);
+        db_release_name(username);
     }
     
     // Get current time
@@ -715,17 +907,15 @@ void handle_respond_invitation(int sock, struct json_object *request) {
     
     struct json_object *payload = json_object_new_object();
     json_object_object_add(payload, "invitation_id", json_object_new_int(invitation_id));
-    json_object_object_add(payload, "group_id", json_object_new_int(inv_info->group_id));
+    json_object_object_add(payload, "group_id", json_object_new_int(group_id));
     json_object_object_add(payload, "status", json_object_new_string(
         strcmp(action, "accept") == 0 ? "accepted" : "rejected"));
     json_object_object_add(payload, "responded_at", json_object_new_string(responded_at));
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
-    free(inv_info);
     json_object_put(response);
 }
 
@@ -764,11 +954,8 @@ void handle_leave_group(int sock, struct json_object *request) {
     }
 
     // Gửi thông báo cho admin
-    int *admin_ids = NULL;
-    int admin_count = db_get_group_admin_ids(group_id, &admin_ids);
-    
-    char *group_name = db_get_group_name_by_id(group_id);
-    char *username = db_get_username_by_id(user->user_id);
+    const char *group_name = db_get_group_name_by_id(group_id);
+    const char *username = db_get_username_by_id(user->user_id);
     
     char notif_title[255];
     char notif_message[512];
@@ -778,14 +965,11 @@ void handle_leave_group(int sock, struct json_object *request) {
             username ? username : "A member",
             group_name ? group_name : "Unknown");
     
-    for (int i = 0; i < admin_count; i++) {
-        db_create_notification(admin_ids[i], "MEMBER_LEFT",
-                             notif_title, notif_message, "GROUP", group_id);
-    }
+    db_notify_group_admins(group_id, "MEMBER_LEFT",
+                           notif_title, notif_message, "GROUP", group_id);
     
-    if (admin_ids) free(admin_ids);
-    if (group_name) free(group_name);
-    if (username) free(username);
+    db_release_name(group_name);
+    db_release_name(username);
     
     // Get current time
     time_t now = time(NULL);
@@ -804,8 +988,7 @@ void handle_leave_group(int sock, struct json_object *request) {
     json_object_object_add(payload, "left_at", json_object_new_string(left_at));
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
     json_object_put(response);
@@ -855,8 +1038,8 @@ void handle_remove_member(int sock, struct json_object *request) {
     }
 
     // Gửi thông báo cho người bị xóa
-    char *group_name = db_get_group_name_by_id(group_id);
-    char *admin_username = db_get_username_by_id(user->user_id);
+    const char *group_name = db_get_group_name_by_id(group_id);
+    const char *admin_username = db_get_username_by_id(user->user_id);
     
     char notif_title[255];
     char notif_message[512];
@@ -869,8 +1052,8 @@ void handle_remove_member(int sock, struct json_object *request) {
     db_create_notification(target_user_id, "REMOVED_FROM_GROUP",
                           notif_title, notif_message, "GROUP", group_id);
     
-    if (group_name) free(group_name);
-    if (admin_username) free(admin_username);
+    db_release_name(group_name);
+    db_release_name(admin_username);
     
     // Get current time
     time_t now = time(NULL);
@@ -889,13 +1072,28 @@ void handle_remove_member(int sock, struct json_object *request) {
     json_object_object_add(payload, "removed_at", json_object_new_string(removed_at));
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
     json_object_put(response);
 }
 // Thêm handler mới cho notifications
+// Notification cursors hold <created_us>-<id>, with the id negated for
+// group notifications
+static void format_notification_cursor(const NotificationInfo *notif, char *buf, size_t size) {
+    format_cursor(notif->created_us, notif->group_id > 0 ? -notif->notification_id : notif->notification_id,
+                  buf, size);
+}
+
+static int parse_notification_cursor(const char *text, NotificationCursor *cursor) {
+    int id;
+    if (!parse_cursor(text, &cursor->created_us, &id) || id == 0) return 0;
+    // Only the scope matters for ordering, not which group
+    cursor->group_id = id < 0 ? 1 : 0;
+    cursor->notification_id = id < 0 ? -id : id;
+    return 1;
+}
+
 void handle_get_notifications(int sock, struct json_object *request) {
     struct json_object *data, *token_obj;
     
@@ -905,6 +1103,29 @@ void handle_get_notifications(int sock, struct json_object *request) {
         return;
     }
     
+    // Optional paging: before/after a cursor from an earlier response,
+    // page size and unread filter
+    struct json_object *limit_obj, *unread_obj;
+    NotificationCursor before, after;
+    const char *before_text, *after_text;
+    int has_before = get_cursor_string(data, "before", &before_text);
+    int has_after = get_cursor_string(data, "after", &after_text);
+    if (has_before < 0 || has_after < 0 || (has_before && has_after) ||
+        (has_before && !parse_notification_cursor(before_text, &before)) ||
+        (has_after && !parse_notification_cursor(after_text, &after))) {
+        send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_CURSOR", "Invalid notification cursor");
+        return;
+    }
+    
+    int limit = NOTIFICATION_PAGE_DEFAULT;
+    if (json_object_object_get_ex(data, "limit", &limit_obj)) {
+        limit = json_object_get_int(limit_obj);
+        if (limit < 1) limit = 1;
+        if (limit > NOTIFICATION_PAGE_MAX) limit = NOTIFICATION_PAGE_MAX;
+    }
+    int unread_only = json_object_object_get_ex(data, "unread_only", &unread_obj) &&
+                      json_object_get_boolean(unread_obj);
+    
     const char *token = json_object_get_string(token_obj);
     
     // Verify session
@@ -915,38 +1136,78 @@ void handle_get_notifications(int sock, struct json_object *request) {
     }
     
     // Get notifications
-    NotificationInfo **notifications = NULL;
-    int count = db_get_user_notifications(user->user_id, &notifications);
+    NotificationInfo *notifications = NULL;
+    int has_more = 0;
+    int count = db_get_user_notifications(user->user_id, has_before ? &before : NULL, has_after ? &after : NULL,
+                                          unread_only, limit, &notifications, &has_more);
+    if (count < 0) {
+        send_error_response(sock, STATUS_INTERNAL_ERROR, "ERROR_INTERNAL_SERVER", "Failed to get notifications");
+        free(user);
+        return;
+    }
     
     struct json_object *response = json_object_new_object();
     json_object_object_add(response, "status", json_object_new_int(STATUS_OK));
+    struct json_object *payload = json_object_new_object();
+    
+    // A poll that finds nothing newer just hands its cursor back
+    if (has_after && count == 0) {
+        json_object_object_add(response, "code", json_object_new_string("SUCCESS_NO_NEW_NOTIFICATIONS"));
+        json_object_object_add(response, "message", json_object_new_string("No new notifications"));
+        json_object_object_add(payload, "newest_cursor", json_object_new_string(after_text));
+        json_object_object_add(response, "payload", payload);
+        
+        send_json_response(sock, response);
+        
+        free(user);
+        json_object_put(response);
+        return;
+    }
+    
     json_object_object_add(response, "code", json_object_new_string("SUCCESS_GET_NOTIFICATIONS"));
     json_object_object_add(response, "message", json_object_new_string("Notifications retrieved successfully"));
     
-    struct json_object *payload = json_object_new_object();
     struct json_object *notif_array = json_object_new_array();
     
     for (int i = 0; i < count; i++) {
+        NotificationInfo *notif = &notifications[i];
         struct json_object *notif_obj = json_object_new_object();
-        json_object_object_add(notif_obj, "notification_id", json_object_new_int(notifications[i]->notification_id));
-        json_object_object_add(notif_obj, "type", json_object_new_string(notifications[i]->type));
-        json_object_object_add(notif_obj, "title", json_object_new_string(notifications[i]->title));
-        json_object_object_add(notif_obj, "message", json_object_new_string(notifications[i]->message));
-        json_object_object_add(notif_obj, "related_type", json_object_new_string(notifications[i]->related_type));
-        json_object_object_add(notif_obj, "related_id", json_object_new_int(notifications[i]->related_id));
-        json_object_object_add(notif_obj, "is_read", json_object_new_boolean(notifications[i]->is_read));
-        json_object_object_add(notif_obj, "created_at", json_object_new_string(notifications[i]->created_at));
+        json_object_object_add(notif_obj, "notification_id", json_object_new_int(notif->notification_id));
+        if (notif->group_id > 0) {
+            json_object_object_add(notif_obj, "scope", json_object_new_string("group"));
+            json_object_object_add(notif_obj, "group_id", json_object_new_int(notif->group_id));
+        } else {
+            json_object_object_add(notif_obj, "scope", json_object_new_string("user"));
+        }
+        json_object_object_add(notif_obj, "type", json_object_new_string(notif->type));
+        json_object_object_add(notif_obj, "title", json_object_new_string(notif->title));
+        json_object_object_add(notif_obj, "message", json_object_new_string(notif->message));
+        json_object_object_add(notif_obj, "related_type", json_object_new_string(notif->related_type));
+        json_object_object_add(notif_obj, "related_id", json_object_new_int(notif->related_id));
+        json_object_object_add(notif_obj, "is_read", json_object_new_boolean(notif->is_read));
+        json_object_object_add(notif_obj, "created_at", json_object_new_string(notif->created_at));
         json_object_array_add(notif_array, notif_obj);
-        free(notifications[i]);
     }
-    if (notifications) free(notifications);
     
     json_object_object_add(payload, "notifications", notif_array);
     json_object_object_add(payload, "total_count", json_object_new_int(count));
+    json_object_object_add(payload, "has_more", json_object_new_boolean(has_more));
+    
+    // newest_cursor is what to poll with next; next_cursor continues into
+    // older notifications
+    char cursor[CURSOR_TEXT_MAX];
+    if (count > 0) {
+        format_notification_cursor(&notifications[0], cursor, sizeof(cursor));
+        json_object_object_add(payload, "newest_cursor", json_object_new_string(cursor));
+        format_notification_cursor(&notifications[count - 1], cursor, sizeof(cursor));
+        json_object_object_add(payload, "next_cursor", json_object_new_string(cursor));
+    } else if (has_before) {
+        json_object_object_add(payload, "next_cursor", json_object_new_string(before_text));
+    }
     json_object_object_add(response, "payload", payload);
+    free(notifications);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
     json_object_put(response);
@@ -965,6 +1226,17 @@ void handle_mark_notification_read(int sock, struct json_object *request) {
     const char *token = json_object_get_string(token_obj);
     int notification_id = json_object_get_int(notif_id_obj);
     
+    // Group-scoped notifications have their own id space
+    struct json_object *scope_obj;
+    int group_scope = 0;
+    if (json_object_object_get_ex(data, "scope", &scope_obj)) {
+        if (!json_object_is_type(scope_obj, json_type_string)) {
+            send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Invalid scope");
+            return;
+        }
+        group_scope = strcmp(json_object_get_string(scope_obj), "group") == 0;
+    }
+    
     // Verify session
     UserInfo *user = db_verify_session(token);
     if (!user) {
@@ -973,7 +1245,9 @@ void handle_mark_notification_read(int sock, struct json_object *request) {
     }
     
     // Mark as read
-    if (db_mark_notification_read(user->user_id, notification_id) < 0) {
+    int marked = group_scope ? db_mark_group_notification_read(user->user_id, notification_id)
+                             : db_mark_notification_read(user->user_id, notification_id);
+    if (marked < 0) {
         send_error_response(sock, STATUS_INTERNAL_ERROR, "ERROR_INTERNAL_SERVER", "Failed to mark as read");
         free(user);
         return;
@@ -986,10 +1260,10 @@ void handle_mark_notification_read(int sock, struct json_object *request) {
     
     struct json_object *payload = json_object_new_object();
     json_object_object_add(payload, "notification_id", json_object_new_int(notification_id));
+    json_object_object_add(payload, "scope", json_object_new_string(group_scope ? "group" : "user"));
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
     json_object_put(response);
@@ -1028,8 +1302,7 @@ void handle_mark_all_notifications_read(int sock, struct json_object *request) {
     struct json_object *payload = json_object_new_object();
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
     json_object_put(response);
@@ -1065,13 +1338,85 @@ void handle_get_unread_count(int sock, struct json_object *request) {
     json_object_object_add(payload, "unread_count", json_object_new_int(count));
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
     json_object_put(response);
 }
 
+void handle_subscribe_notifications(int sock, struct json_object *request) {
+    struct json_object *data, *token_obj;
+    
+    if (!json_object_object_get_ex(request, "data", &data) ||
+        !json_object_object_get_ex(data, "session_token", &token_obj)) {
+        send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Missing required fields");
+        return;
+    }
+    
+    const char *token = json_object_get_string(token_obj);
+    
+    // Verify session
+    UserInfo *user = db_verify_session(token);
+    if (!user) {
+        send_error_response(sock, STATUS_UNAUTHORIZED, "ERROR_UNAUTHORIZED", "Invalid or expired session");
+        return;
+    }
+    
+    // New notifications are pushed on this connection from now on, so the
+    // count is the only thing the client still has to fetch
+    notify_hub_subscribe(sock, user->user_id);
+    int count = db_get_unread_notification_count(user->user_id);
+    
+    struct json_object *response = json_object_new_object();
+    json_object_object_add(response, "status", json_object_new_int(STATUS_OK));
+    json_object_object_add(response, "code", json_object_new_string("SUCCESS_SUBSCRIBE_NOTIFICATIONS"));
+    json_object_object_add(response, "message", json_object_new_string("Subscribed to notifications"));
+    
+    struct json_object *payload = json_object_new_object();
+    json_object_object_add(payload, "unread_count", json_object_new_int(count));
+    json_object_object_add(response, "payload", payload);
+    
+    send_json_response(sock, response);
+    
+    free(user);
+    json_object_put(response);
+}
+
+void handle_unsubscribe_notifications(int sock, struct json_object *request) {
+    struct json_object *data, *token_obj;
+    
+    if (!json_object_object_get_ex(request, "data", &data) ||
+        !json_object_object_get_ex(data, "session_token", &token_obj)) {
+        send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Missing required fields");
+        return;
+    }
+    
+    // Verify session
+    UserInfo *user = db_verify_session(json_object_get_string(token_obj));
+    if (!user) {
+        send_error_response(sock, STATUS_UNAUTHORIZED, "ERROR_UNAUTHORIZED", "Invalid or expired session");
+        return;
+    }
+    
+    notify_hub_unsubscribe(sock);
+    
+    struct json_object *response = json_object_new_object();
+    json_object_object_add(response, "status", json_object_new_int(STATUS_OK));
+    json_object_object_add(response, "code", json_object_new_string("SUCCESS_UNSUBSCRIBE_NOTIFICATIONS"));
+    json_object_object_add(response, "message", json_object_new_string("Unsubscribed from notifications"));
+    json_object_object_add(response, "payload", json_object_new_object());
+    
+    send_json_response(sock, response);
+    
+    free(user);
+    json_object_put(response);
+}
+
+// Group cursors hold <created_us>-<group_id>
+static int parse_group_cursor(const char *text, GroupCursor *cursor) {
+    return parse_cursor(text, &cursor->created_us, &cursor->group_id);
+}
+
 void handle_list_available_groups(int sock, struct json_object *request) {
     struct json_object *data_obj, *field;
     
@@ -1081,9 +1426,22 @@ void handle_list_available_groups(int sock, struct json_object *request) {
     }
     
     const char *session_token = NULL;
+    int limit = GROUP_PAGE_DEFAULT;
+    GroupCursor after;
+    const char *cursor_text;
     
     if (json_object_object_get_ex(data_obj, "session_token", &field))
         session_token = json_object_get_string(field);
+    if (json_object_object_get_ex(data_obj, "limit", &field)) {
+        limit = json_object_get_int(field);
+        if (limit < 1) limit = 1;
+        if (limit > GROUP_PAGE_MAX) limit = GROUP_PAGE_MAX;
+    }
+    int has_after = get_cursor_string(data_obj, "after", &cursor_text);
+    if (has_after < 0 || (has_after && !parse_group_cursor(cursor_text, &after))) {
+        send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_CURSOR", "Invalid group cursor");
+        return;
+    }
     
     if (!session_token) {
         send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Missing session_token");
@@ -1097,9 +1455,15 @@ void handle_list_available_groups(int sock, struct json_object *request) {
         return;
     }
     
-    // Get available groups
-    GroupInfo **groups = NULL;
-    int count = db_get_available_groups(user->user_id, &groups);
+    // Get one page of available groups
+    GroupInfo *groups = NULL;
+    int has_more = 0;
+    int count = db_get_available_groups(user->user_id, has_after ? &after : NULL, limit, &groups, &has_more);
+    free(user);
+    if (count < 0) {
+        send_error_response(sock, STATUS_INTERNAL_ERROR, "ERROR_INTERNAL_SERVER", "Failed to list available groups");
+        return;
+    }
     
     // Send success response
     struct json_object *response = json_object_new_object();
@@ -1112,26 +1476,228 @@ void handle_list_available_groups(int sock, struct json_object *request) {
     
     for (int i = 0; i < count; i++) {
         struct json_object *group_obj = json_object_new_object();
-        json_object_object_add(group_obj, "group_id", json_object_new_int(groups[i]->group_id));
-        json_object_object_add(group_obj, "group_name", json_object_new_string(groups[i]->group_name));
-        json_object_object_add(group_obj, "description", json_object_new_string(groups[i]->description));
-        json_object_object_add(group_obj, "member_count", json_object_new_int(groups[i]->member_count));
-        json_object_object_add(group_obj, "created_at", json_object_new_string(groups[i]->created_at));
+        json_object_object_add(group_obj, "group_id", json_object_new_int(groups[i].group_id));
+        json_object_object_add(group_obj, "group_name", json_object_new_string(groups[i].group_name));
+        json_object_object_add(group_obj, "description", json_object_new_string(groups[i].description));
+        json_object_object_add(group_obj, "member_count", json_object_new_int(groups[i].member_count));
+        json_object_object_add(group_obj, "created_at", json_object_new_string(groups[i].created_at));
         json_object_array_add(groups_array, group_obj);
-        free(groups[i]);
     }
-    if (groups) free(groups);
     
     json_object_object_add(payload, "groups", groups_array);
     json_object_object_add(payload, "total_count", json_object_new_int(count));
+    json_object_object_add(payload, "has_more", json_object_new_boolean(has_more));
+    if (has_more) {
+        char cursor[CURSOR_TEXT_MAX];
+        format_cursor(groups[count - 1].created_us, groups[count - 1].group_id, cursor, sizeof(cursor));
+        json_object_object_add(payload, "next_cursor", json_object_new_string(cursor));
+    }
     json_object_object_add(response, "payload", payload);
+    free(groups);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
-    free(user);
     json_object_put(response);
 }
 
+// Search cursors hold <match>-<group_id>
+static int parse_search_cursor(const char *text, GroupSearchCursor *cursor) {
+    long long match;
+    if (!parse_cursor(text, &match, &cursor->group_id) ||
+        match < GROUP_MATCH_DESCRIPTION || match > GROUP_MATCH_NAME_EXACT) {
+        return 0;
+    }
+    cursor->match = (GroupMatch)match;
+    return 1;
+}
+
+void handle_search_groups(int sock, struct json_object *request) {
+    struct json_object *data_obj, *field;
+    
+    if (!json_object_object_get_ex(request, "data", &data_obj)) {
+        send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Missing data field");
+        return;
+    }
+    
+    const char *session_token = NULL;
+    const char *keyword = NULL;
+    int limit = GROUP_SEARCH_PAGE_DEFAULT;
+    GroupSearchCursor after;
+    const char *cursor_text;
+    
+    if (json_object_object_get_ex(data_obj, "session_token", &field))
+        session_token = json_object_get_string(field);
+    if (json_object_object_get_ex(data_obj, "keyword", &field))
+        keyword = json_object_get_string(field);
+    if (json_object_object_get_ex(data_obj, "limit", &field)) {
+        limit = json_object_get_int(field);
+        if (limit < 1) limit = 1;
+        if (limit > GROUP_SEARCH_PAGE_MAX) limit = GROUP_SEARCH_PAGE_MAX;
+    }
+    int has_after = get_cursor_string(data_obj, "after", &cursor_text);
+    if (has_after < 0 || (has_after && !parse_search_cursor(cursor_text, &after))) {
+        send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_CURSOR", "Invalid search cursor");
+        return;
+    }
+    
+    if (!session_token || !keyword || keyword[0] == '\0') {
+        send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Missing required fields");
+        return;
+    }
+    if (strlen(keyword) > 100) {
+        send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Keyword too long");
+        return;
+    }
+    
+    // Verify session
+    UserInfo *user = db_verify_session(session_token);
+    if (!user) {
+        send_error_response(sock, STATUS_UNAUTHORIZED, "ERROR_UNAUTHORIZED", "Invalid session token or session expired");
+        return;
+    }
+    free(user);
+    
+    // Served from the in-memory index, Postgres is only asked for owner names
+    // the name cache does not hold yet
+    GroupSearchResult *results = calloc(limit, sizeof(GroupSearchResult));
+    if (!results) {
+        send_error_response(sock, STATUS_INTERNAL_ERROR, "ERROR_INTERNAL_SERVER", "Search failed");
+        return;
+    }
+    int has_more = 0;
+    int count = group_search_query(keyword, has_after ? &after : NULL, limit, results, &has_more);
+    
+    struct json_object *response = json_object_new_object();
+    json_object_object_add(response, "status", json_object_new_int(STATUS_OK));
+    json_object_object_add(response, "code", json_object_new_string("SUCCESS_SEARCH_GROUPS"));
+    json_object_object_add(response, "message", json_object_new_string("Search completed"));
+    
+    struct json_object *payload = json_object_new_object();
+    struct json_object *groups_array = json_object_new_array();
+    
+    for (int i = 0; i < count; i++) {
+        struct json_object *group_obj = json_object_new_object();
+        json_object_object_add(group_obj, "group_id", json_object_new_int(results[i].group_id));
+        json_object_object_add(group_obj, "group_name", json_object_new_string(results[i].group_name));
+        json_object_object_add(group_obj, "description", json_object_new_string(results[i].description));
+        
+        const char *owner_name = db_get_username_by_id(results[i].owner_id);
+        json_object_object_add(group_obj, "owner_name", json_object_new_string(owner_name ? owner_name : ""));
+        db_release_name(owner_name);
+        
+        json_object_array_add(groups_array, group_obj);
+    }
+    
+    json_object_object_add(payload, "groups", groups_array);
+    json_object_object_add(payload, "total_count", json_object_new_int(count));
+    json_object_object_add(payload, "has_more", json_object_new_boolean(has_more));
+    if (has_more) {
+        char cursor[CURSOR_TEXT_MAX];
+        format_cursor(results[count - 1].match, results[count - 1].group_id, cursor, sizeof(cursor));
+        json_object_object_add(payload, "next_cursor", json_object_new_string(cursor));
+    }
+    json_object_object_add(response, "payload", payload);
+    free(results);
+    
+    send_json_response(sock, response);
+    
+    json_object_put(response);
+}
 
+// User search cursors hold <user_id>-<key>
+static int parse_user_cursor(const char *text, UserSearchCursor *cursor) {
+    long long user_id;
+    if (!parse_cursor(text, &user_id, &cursor->key) || user_id <= 0 || user_id > INT_MAX ||
+        cursor->key < 0 || cursor->key > USER_SEARCH_MAX_WORDS) {
+        return 0;
+    }
+    cursor->user_id = (int)user_id;
+    return 1;
+}
 
+void handle_search_users(int sock, struct json_object *request) {
+    struct json_object *data_obj, *field;
+    
+    if (!json_object_object_get_ex(request, "data", &data_obj)) {
+        send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Missing data field");
+        return;
+    }
+    
+    const char *session_token = NULL;
+    const char *prefix = NULL;
+    int limit = USER_SEARCH_PAGE_DEFAULT;
+    UserSearchCursor after;
+    const char *cursor_text;
+    
+    if (json_object_object_get_ex(data_obj, "session_token", &field))
+        session_token = json_object_get_string(field);
+    if (json_object_object_get_ex(data_obj, "prefix", &field))
+        prefix = json_object_get_string(field);
+    if (json_object_object_get_ex(data_obj, "limit", &field)) {
+        limit = json_object_get_int(field);
+        if (limit < 1) limit = 1;
+        if (limit > USER_SEARCH_PAGE_MAX) limit = USER_SEARCH_PAGE_MAX;
+    }
+    int has_after = get_cursor_string(data_obj, "after", &cursor_text);
+    if (has_after < 0 || (has_after && !parse_user_cursor(cursor_text, &after))) {
+        send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_CURSOR", "Invalid search cursor");
+        return;
+    }
+    
+    if (!session_token || !prefix || prefix[0] == '\0') {
+        send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Missing required fields");
+        return;
+    }
+    if (strlen(prefix) > 100) {
+        send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Prefix too long");
+        return;
+    }
+    
+    // Verify session
+    UserInfo *user = db_verify_session(session_token);
+    if (!user) {
+        send_error_response(sock, STATUS_UNAUTHORIZED, "ERROR_UNAUTHORIZED", "Invalid session token or session expired");
+        return;
+    }
+    free(user);
+    
+    // Served entirely from the in-memory index
+    UserSearchResult *results = calloc(limit, sizeof(UserSearchResult));
+    if (!results) {
+        send_error_response(sock, STATUS_INTERNAL_ERROR, "ERROR_INTERNAL_SERVER", "Search failed");
+        return;
+    }
+    int has_more = 0;
+    int count = user_search_query(prefix, has_after ? &after : NULL, limit, results, &has_more);
+    
+    struct json_object *response = json_object_new_object();
+    json_object_object_add(response, "status", json_object_new_int(STATUS_OK));
+    json_object_object_add(response, "code", json_object_new_string("SUCCESS_SEARCH_USERS"));
+    json_object_object_add(response, "message", json_object_new_string("Search completed"));
+    
+    struct json_object *payload = json_object_new_object();
+    struct json_object *users_array = json_object_new_array();
+    
+    for (int i = 0; i < count; i++) {
+        struct json_object *user_obj = json_object_new_object();
+        json_object_object_add(user_obj, "user_id", json_object_new_int(results[i].user_id));
+        json_object_object_add(user_obj, "username", json_object_new_string(results[i].username));
+        json_object_object_add(user_obj, "full_name", json_object_new_string(results[i].full_name));
+        json_object_array_add(users_array, user_obj);
+    }
+    
+    json_object_object_add(payload, "users", users_array);
+    json_object_object_add(payload, "total_count", json_object_new_int(count));
+    json_object_object_add(payload, "has_more", json_object_new_boolean(has_more));
+    if (has_more) {
+        char cursor[CURSOR_TEXT_MAX];
+        format_cursor(results[count - 1].user_id, results[count - 1].key, cursor, sizeof(cursor));
+        json_object_object_add(payload, "next_cursor", json_object_new_string(cursor));
+    }
+    json_object_object_add(response, "payload", payload);
+    free(results);
+    
+    send_json_response(sock, response);
+    
+    json_object_put(response);
+}
@@ -19,5 +19,9 @@ void handle_get_notifications(int sock, struct json_object *request);
 void handle_mark_notification_read(int sock, struct json_object *request);
 void handle_mark_all_notifications_read(int sock, struct json_object *request);
 void handle_get_unread_count(int sock, struct json_object *request);
+void handle_subscribe_notifications(int sock, struct json_object *request);
+void handle_unsubscribe_notifications(int sock, struct json_object *request);
 void handle_list_available_groups(int sock, struct json_object *request);
+void handle_search_groups(int sock, struct json_object *request);
+void handle_search_users(int sock, struct json_object *request);
 #endif
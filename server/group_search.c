@@ -0,0 +1,386 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "group_search.h"
+
+#define MAX_KEYWORD 256
+#define TABLE_MIN_CAPACITY 1024     // Power of two
+#define COMPACT_MIN_STALE 1024      // Replaced documents before the index is rebuilt without them
+#define COMPACT_STALE_SHARE 4       // ... once they are also 1/4 of all documents
+
+// A group edited after it was indexed gets a new document; the old one stays
+// in the posting lists with its text freed and is skipped until compact()
+// rebuilds the index without it.
+typedef struct {
+    int group_id;
+    int owner_id;
+    char *name;             // As stored, returned to clients, NULL once replaced
+    char *description;
+    char *name_folded;      // Lower-cased copies the keyword is matched against
+    char *description_folded;
+} Doc;
+
+// Documents a trigram occurs in, by index into docs. Documents are only
+// appended, so every list is sorted.
+typedef struct {
+    unsigned int key;       // 0 marks an empty slot
+    int count;
+    int capacity;
+    int *docs;
+} Posting;
+
+static pthread_rwlock_t index_lock = PTHREAD_RWLOCK_INITIALIZER;
+static Doc *docs = NULL;
+static int doc_count = 0;
+static int doc_capacity = 0;
+static int stale_count = 0;         // Replaced documents
+static int *group_docs = NULL;      // Current document of each group_id, plus one; 0 if none
+static int group_docs_capacity = 0;
+static Posting *table = NULL;       // Open addressing, linear probing
+static int table_capacity = 0;
+static int table_count = 0;
+static long long posting_total = 0;
+static GroupSearchStats stats;      // compactions under the write lock, searches and scans with atomic builtins
+
+static char *fold_copy(const char *text) {
+    size_t len = strlen(text);
+    char *copy = malloc(len + 1);
+    if (!copy) return NULL;
+    for (size_t i = 0; i <= len; i++) copy[i] = (char)tolower((unsigned char)text[i]);
+    return copy;
+}
+
+// Bit 24 keeps a trigram of NUL-free bytes from ever being 0
+static unsigned int trigram_key(const char *p) {
+    return (1u << 24) | ((unsigned char)p[0] << 16) | ((unsigned char)p[1] << 8) | (unsigned char)p[2];
+}
+
+static unsigned int slot_for(unsigned int key, int capacity) {
+    unsigned int h = key * 0x9e3779b1u;
+    return (h ^ (h >> 16)) & (unsigned int)(capacity - 1);
+}
+
+static Posting *find_posting(unsigned int key) {
+    if (table_capacity == 0) return NULL;
+    for (unsigned int i = slot_for(key, table_capacity); ; i = (i + 1) & (table_capacity - 1)) {
+        if (table[i].key == key) return &table[i];
+        if (table[i].key == 0) return NULL;
+    }
+}
+
+static int grow_table() {
+    int new_capacity = table_capacity ? table_capacity * 2 : TABLE_MIN_CAPACITY;
+    Posting *new_table = calloc(new_capacity, sizeof(Posting));
+    if (!new_table) return 0;
+
+    for (int i = 0; i < table_capacity; i++) {
+        if (table[i].key == 0) continue;
+        unsigned int j = slot_for(table[i].key, new_capacity);
+        while (new_table[j].key != 0) j = (j + 1) & (new_capacity - 1);
+        new_table[j] = table[i];
+    }
+    free(table);
+    table = new_table;
+    table_capacity = new_capacity;
+    return 1;
+}
+
+// Appends doc to the posting list of every trigram of text. Caller holds the write lock.
+static void index_text(const char *text, int doc) {
+    size_t len = strlen(text);
+    for (size_t i = 0; i + 3 <= len; i++) {
+        unsigned int key = trigram_key(text + i);
+        Posting *posting = find_posting(key);
+
+        if (!posting) {
+            if ((table_count + 1) * 10 > table_capacity * 7 && !grow_table()) return;
+            unsigned int j = slot_for(key, table_capacity);
+            while (table[j].key != 0) j = (j + 1) & (table_capacity - 1);
+            posting = &table[j];
+            posting->key = key;
+            table_count++;
+        }
+
+        // Name and description, or a repeated trigram, may list doc already
+        if (posting->count > 0 && posting->docs[posting->count - 1] == doc) continue;
+
+        if (posting->count == posting->capacity) {
+            int new_capacity = posting->capacity ? posting->capacity * 2 : 4;
+            int *new_docs = realloc(posting->docs, new_capacity * sizeof(int));
+            if (!new_docs) continue;
+            posting->docs = new_docs;
+            posting->capacity = new_capacity;
+        }
+        posting->docs[posting->count++] = doc;
+        posting_total++;
+    }
+}
+
+static void free_doc_text(Doc *doc) {
+    free(doc->name);
+    free(doc->description);
+    free(doc->name_folded);
+    free(doc->description_folded);
+    doc->name = doc->description = doc->name_folded = doc->description_folded = NULL;
+}
+
+// Caller holds the write lock
+static int reserve_group(int group_id) {
+    if (group_id < group_docs_capacity) return 1;
+    int new_capacity = group_docs_capacity ? group_docs_capacity : 1024;
+    while (new_capacity <= group_id) new_capacity *= 2;
+    int *grown = realloc(group_docs, new_capacity * sizeof(int));
+    if (!grown) return 0;
+    memset(grown + group_docs_capacity, 0, (new_capacity - group_docs_capacity) * sizeof(int));
+    group_docs = grown;
+    group_docs_capacity = new_capacity;
+    return 1;
+}
+
+// Drops replaced documents and rebuilds the posting lists over the rest. The
+// documents keep their order, so the lists come out sorted. Caller holds the
+// write lock.
+static void compact() {
+    int live = doc_count - stale_count;
+    Doc *kept = malloc((live > 0 ? live : 1) * sizeof(Doc));
+    if (!kept) return;
+
+    int count = 0;
+    for (int i = 0; i < doc_count; i++) {
+        if (!docs[i].name) continue;
+        kept[count] = docs[i];
+        group_docs[docs[i].group_id] = count + 1;
+        count++;
+    }
+    free(docs);
+    docs = kept;
+    doc_count = doc_capacity = count;
+    stale_count = 0;
+
+    for (int i = 0; i < table_capacity; i++) free(table[i].docs);
+    free(table);
+    table = NULL;
+    table_capacity = table_count = 0;
+    posting_total = 0;
+    for (int i = 0; i < doc_count; i++) {
+        index_text(docs[i].name_folded, i);
+        index_text(docs[i].description_folded, i);
+    }
+    stats.compactions++;
+}
+
+void group_search_add(int group_id, int owner_id, const char *group_name, const char *description) {
+    if (group_id <= 0) return;
+    Doc doc;
+    doc.group_id = group_id;
+    doc.owner_id = owner_id;
+    doc.name = strdup(group_name ? group_name : "");
+    doc.description = strdup(description ? description : "");
+    doc.name_folded = doc.name ? fold_copy(doc.name) : NULL;
+    doc.description_folded = doc.description ? fold_copy(doc.description) : NULL;
+    if (!doc.name_folded || !doc.description_folded) {
+        free_doc_text(&doc);
+        return;
+    }
+
+    pthread_rwlock_wrlock(&index_lock);
+    if (!reserve_group(group_id)) {
+        pthread_rwlock_unlock(&index_lock);
+        free_doc_text(&doc);
+        return;
+    }
+
+    // Groups also arrive back through NOTIFY; keep the current document
+    Doc *current = group_docs[group_id] ? &docs[group_docs[group_id] - 1] : NULL;
+    if (current && current->owner_id == owner_id && strcmp(current->name, doc.name) == 0 &&
+        strcmp(current->description, doc.description) == 0) {
+        pthread_rwlock_unlock(&index_lock);
+        free_doc_text(&doc);
+        return;
+    }
+
+    if (doc_count == doc_capacity) {
+        int new_capacity = doc_capacity ? doc_capacity * 2 : 256;
+        Doc *new_docs = realloc(docs, new_capacity * sizeof(Doc));
+        if (!new_docs) {
+            pthread_rwlock_unlock(&index_lock);
+            free_doc_text(&doc);
+            return;
+        }
+        docs = new_docs;
+        doc_capacity = new_capacity;
+    }
+    if (group_docs[group_id]) {
+        free_doc_text(&docs[group_docs[group_id] - 1]);
+        stale_count++;
+    }
+    int index = doc_count++;
+    docs[index] = doc;
+    group_docs[group_id] = index + 1;
+    index_text(doc.name_folded, index);
+    index_text(doc.description_folded, index);
+    if (stale_count >= COMPACT_MIN_STALE && stale_count * COMPACT_STALE_SHARE >= doc_count) compact();
+    pthread_rwlock_unlock(&index_lock);
+}
+
+static int contains_doc(const Posting *posting, int doc) {
+    int lo = 0, hi = posting->count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (posting->docs[mid] == doc) return 1;
+        if (posting->docs[mid] < doc) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return 0;
+}
+
+static GroupMatch match_doc(const Doc *doc, const char *keyword, size_t keyword_len) {
+    const char *hit = strstr(doc->name_folded, keyword);
+    if (hit == doc->name_folded) {
+        return doc->name_folded[keyword_len] == '\0' ? GROUP_MATCH_NAME_EXACT : GROUP_MATCH_NAME_PREFIX;
+    }
+    if (hit) return GROUP_MATCH_NAME;
+    if (strstr(doc->description_folded, keyword)) return GROUP_MATCH_DESCRIPTION;
+    return 0;
+}
+
+// A hit ranks above another if (match, group_id) is larger
+typedef struct {
+    GroupMatch match;
+    int doc;
+} Hit;
+
+static int ranks_above(GroupMatch match_a, int group_a, GroupMatch match_b, int group_b) {
+    return match_a != match_b ? match_a > match_b : group_a > group_b;
+}
+
+static int hit_above(const Hit *a, const Hit *b) {
+    return ranks_above(a->match, docs[a->doc].group_id, b->match, docs[b->doc].group_id);
+}
+
+// Keeps the best `capacity` hits in a min-heap: heap[0] is the weakest kept.
+typedef struct {
+    Hit *heap;
+    int count;
+    int capacity;
+} TopHits;
+
+static void top_hits_offer(TopHits *top, Hit hit) {
+    if (top->count == top->capacity) {
+        if (!hit_above(&hit, &top->heap[0])) return;
+        // Replace the weakest and sift down
+        int i = 0;
+        while (1) {
+            int child = 2 * i + 1;
+            if (child >= top->count) break;
+            if (child + 1 < top->count && hit_above(&top->heap[child], &top->heap[child + 1])) child++;
+            if (!hit_above(&hit, &top->heap[child])) break;
+            top->heap[i] = top->heap[child];
+            i = child;
+        }
+        top->heap[i] = hit;
+        return;
+    }
+
+    int i = top->count++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!hit_above(&top->heap[parent], &hit)) break;
+        top->heap[i] = top->heap[parent];
+        i = parent;
+    }
+    top->heap[i] = hit;
+}
+
+static int compare_hits(const void *a, const void *b) {
+    return hit_above((const Hit *)a, (const Hit *)b) ? -1 : 1;
+}
+
+static void consider(TopHits *top, int doc, const char *keyword, size_t keyword_len,
+                     const GroupSearchCursor *after) {
+    if (!docs[doc].name) return;    // Replaced
+    GroupMatch match = match_doc(&docs[doc], keyword, keyword_len);
+    if (!match) return;
+    if (after && !ranks_above(after->match, after->group_id, match, docs[doc].group_id)) return;
+    Hit hit = { match, doc };
+    top_hits_offer(top, hit);
+}
+
+int group_search_query(const char *keyword, const GroupSearchCursor *after, int limit,
+                       GroupSearchResult *results, int *has_more) {
+    *has_more = 0;
+
+    char folded[MAX_KEYWORD];
+    size_t keyword_len = strlen(keyword);
+    if (keyword_len == 0 || keyword_len >= sizeof(folded) || limit <= 0) return 0;
+    for (size_t i = 0; i <= keyword_len; i++) folded[i] = (char)tolower((unsigned char)keyword[i]);
+
+    // One extra hit tells whether there is more
+    TopHits top = { malloc((limit + 1) * sizeof(Hit)), 0, limit + 1 };
+    if (!top.heap) return 0;
+
+    __atomic_add_fetch(&stats.searches, 1, __ATOMIC_RELAXED);
+    pthread_rwlock_rdlock(&index_lock);
+
+    if (keyword_len < 3) {
+        // Too short for a trigram: check every group
+        __atomic_add_fetch(&stats.scans, 1, __ATOMIC_RELAXED);
+        for (int doc = 0; doc < doc_count; doc++) {
+            consider(&top, doc, folded, keyword_len, after);
+        }
+    } else {
+        // Walk the rarest trigram's list, keep documents every other
+        // trigram lists too, then confirm the keyword really occurs
+        int trigram_count = (int)keyword_len - 2;
+        const Posting *postings[MAX_KEYWORD];
+        const Posting *rarest = NULL;
+        int missing = 0;
+        for (int i = 0; i < trigram_count; i++) {
+            postings[i] = find_posting(trigram_key(folded + i));
+            if (!postings[i]) {
+                missing = 1;
+                break;
+            }
+            if (!rarest || postings[i]->count < rarest->count) rarest = postings[i];
+        }
+
+        for (int k = 0; !missing && k < rarest->count; k++) {
+            int doc = rarest->docs[k];
+            int in_all = 1;
+            for (int i = 0; i < trigram_count && in_all; i++) {
+                if (postings[i] != rarest && !contains_doc(postings[i], doc)) in_all = 0;
+            }
+            if (in_all) consider(&top, doc, folded, keyword_len, after);
+        }
+    }
+
+    qsort(top.heap, top.count, sizeof(Hit), compare_hits);
+    int count = top.count > limit ? limit : top.count;
+    *has_more = top.count > limit;
+    for (int i = 0; i < count; i++) {
+        const Doc *doc = &docs[top.heap[i].doc];
+        results[i].group_id = doc->group_id;
+        results[i].owner_id = doc->owner_id;
+        results[i].match = top.heap[i].match;
+        snprintf(results[i].group_name, sizeof(results[i].group_name), "%s", doc->name);
+        snprintf(results[i].description, sizeof(results[i].description), "%s", doc->description);
+    }
+
+    pthread_rwlock_unlock(&index_lock);
+    free(top.heap);
+    return count;
+}
+
+void group_search_get_stats(GroupSearchStats *out) {
+    pthread_rwlock_rdlock(&index_lock);
+    out->groups = doc_count - stale_count;
+    out->stale = stale_count;
+    out->trigrams = table_count;
+    out->postings = posting_total;
+    out->compactions = stats.compactions;
+    pthread_rwlock_unlock(&index_lock);
+    out->searches = __atomic_load_n(&stats.searches, __ATOMIC_RELAXED);
+    out->scans = __atomic_load_n(&stats.scans, __ATOMIC_RELAXED);
+}
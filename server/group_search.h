@@ -0,0 +1,55 @@
+#ifndef GROUP_SEARCH_H
+#define GROUP_SEARCH_H
+
+#define GROUP_SEARCH_PAGE_DEFAULT 20
+#define GROUP_SEARCH_PAGE_MAX 100
+
+// How a group matched a keyword, best first
+typedef enum {
+    GROUP_MATCH_DESCRIPTION = 1,    // Only the description contains it
+    GROUP_MATCH_NAME,               // The name contains it
+    GROUP_MATCH_NAME_PREFIX,        // The name starts with it
+    GROUP_MATCH_NAME_EXACT
+} GroupMatch;
+
+typedef struct {
+    int group_id;
+    int owner_id;
+    GroupMatch match;
+    char group_name[101];
+    char description[256];
+} GroupSearchResult;
+
+// Results are ordered by (match, group_id), both descending
+typedef struct {
+    GroupMatch match;
+    int group_id;
+} GroupSearchCursor;
+
+typedef struct {
+    int groups;
+    int stale;                      // Documents left behind by edited groups
+    unsigned long long compactions; // Rebuilds that dropped them
+    int trigrams;
+    long long postings;
+    unsigned long long searches;
+    unsigned long long scans;       // Keywords under three bytes, matched without the index
+} GroupSearchStats;
+
+// In-memory trigram index over group names and descriptions. Matching is
+// case-insensitive for ASCII and byte-wise otherwise. Safe to use from any
+// thread.
+
+// Adds a group, or replaces everything known about one. Adding a group again
+// unchanged costs nothing.
+void group_search_add(int group_id, int owner_id, const char *group_name, const char *description);
+
+// Fills results with up to limit groups whose name or description contains
+// keyword, ranked after the cursor (or from the top when after is NULL).
+// *has_more says whether more follow. Returns the count.
+int group_search_query(const char *keyword, const GroupSearchCursor *after, int limit,
+                       GroupSearchResult *results, int *has_more);
+
+void group_search_get_stats(GroupSearchStats *stats);
+
+#endif
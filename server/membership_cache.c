@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "membership_cache.h"
+
+#define SHARD_CAPACITY (MEMBERSHIP_CACHE_CAPACITY / MEMBERSHIP_CACHE_SHARDS)
+#define SHARD_BUCKETS 256   // Power of two
+
+typedef struct CacheEntry {
+    int user_id;
+    int group_id;
+    unsigned int hash;
+    MembershipRole role;
+    time_t valid_until;
+    struct CacheEntry *bucket_next;
+    struct CacheEntry *lru_prev;    // Towards the most recently used
+    struct CacheEntry *lru_next;
+} CacheEntry;
+
+// Same layout as the session cache: independent shards, each with its own
+// lock, hash table and LRU list. version is bumped by every write so a load
+// that started before the write cannot put the old role back.
+typedef struct {
+    pthread_mutex_t lock;
+    CacheEntry *buckets[SHARD_BUCKETS];
+    CacheEntry *lru_head;           // Most recently used
+    CacheEntry *lru_tail;           // Next to evict
+    int count;
+    unsigned long long version;
+} Shard;
+
+static Shard shards[MEMBERSHIP_CACHE_SHARDS];
+static MembershipCacheStats stats;  // Counters updated with atomic builtins
+
+static unsigned int hash_key(int user_id, int group_id) {
+    unsigned long long key = ((unsigned long long)(unsigned int)user_id << 32) | (unsigned int)group_id;
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (unsigned int)key;
+}
+
+static Shard *shard_for(unsigned int hash) {
+    return &shards[hash % MEMBERSHIP_CACHE_SHARDS];
+}
+
+static CacheEntry **bucket_for(Shard *shard, unsigned int hash) {
+    return &shard->buckets[(hash / MEMBERSHIP_CACHE_SHARDS) & (SHARD_BUCKETS - 1)];
+}
+
+static void lru_unlink(Shard *shard, CacheEntry *entry) {
+    if (entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+    else shard->lru_head = entry->lru_next;
+    if (entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+    else shard->lru_tail = entry->lru_prev;
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void lru_push_front(Shard *shard, CacheEntry *entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = shard->lru_head;
+    if (shard->lru_head) shard->lru_head->lru_prev = entry;
+    shard->lru_head = entry;
+    if (!shard->lru_tail) shard->lru_tail = entry;
+}
+
+static CacheEntry *find_entry(Shard *shard, int user_id, int group_id, unsigned int hash) {
+    for (CacheEntry *entry = *bucket_for(shard, hash); entry; entry = entry->bucket_next) {
+        if (entry->user_id == user_id && entry->group_id == group_id) return entry;
+    }
+    return NULL;
+}
+
+// Unlinks and frees an entry. Caller holds the shard lock.
+static void remove_entry(Shard *shard, CacheEntry *entry) {
+    CacheEntry **link = bucket_for(shard, entry->hash);
+    while (*link != entry) link = &(*link)->bucket_next;
+    *link = entry->bucket_next;
+
+    lru_unlink(shard, entry);
+    shard->count--;
+    free(entry);
+}
+
+// Inserts or refreshes an entry. Caller holds the shard lock.
+static void store_entry(Shard *shard, int user_id, int group_id, unsigned int hash, MembershipRole role) {
+    CacheEntry *entry = find_entry(shard, user_id, group_id, hash);
+    if (entry) {
+        lru_unlink(shard, entry);
+    } else {
+        if (shard->count >= SHARD_CAPACITY) {
+            remove_entry(shard, shard->lru_tail);
+            __atomic_add_fetch(&stats.evictions, 1, __ATOMIC_RELAXED);
+        }
+
+        entry = calloc(1, sizeof(CacheEntry));
+        if (!entry) return;
+        entry->user_id = user_id;
+        entry->group_id = group_id;
+        entry->hash = hash;
+
+        CacheEntry **bucket = bucket_for(shard, hash);
+        entry->bucket_next = *bucket;
+        *bucket = entry;
+        shard->count++;
+    }
+
+    entry->role = role;
+    entry->valid_until = time(NULL) + MEMBERSHIP_CACHE_TTL;
+    lru_push_front(shard, entry);
+}
+
+void membership_cache_init() {
+    for (int i = 0; i < MEMBERSHIP_CACHE_SHARDS; i++) {
+        pthread_mutex_init(&shards[i].lock, NULL);
+    }
+    memset(&stats, 0, sizeof(stats));
+    stats.capacity = SHARD_CAPACITY * MEMBERSHIP_CACHE_SHARDS;
+}
+
+int membership_cache_get(int user_id, int group_id, MembershipRole *role, unsigned long long *version) {
+    unsigned int hash = hash_key(user_id, group_id);
+    Shard *shard = shard_for(hash);
+    int hit = 0;
+
+    pthread_mutex_lock(&shard->lock);
+    CacheEntry *entry = find_entry(shard, user_id, group_id, hash);
+    if (entry && entry->valid_until <= time(NULL)) {
+        remove_entry(shard, entry);
+        entry = NULL;
+    }
+    if (entry) {
+        lru_unlink(shard, entry);
+        lru_push_front(shard, entry);
+        *role = entry->role;
+        hit = 1;
+    } else {
+        *version = shard->version;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    if (hit) __atomic_add_fetch(&stats.hits, 1, __ATOMIC_RELAXED);
+    else __atomic_add_fetch(&stats.misses, 1, __ATOMIC_RELAXED);
+    return hit;
+}
+
+void membership_cache_fill(int user_id, int group_id, MembershipRole role, unsigned long long version) {
+    unsigned int hash = hash_key(user_id, group_id);
+    Shard *shard = shard_for(hash);
+
+    pthread_mutex_lock(&shard->lock);
+    if (shard->version == version) {
+        store_entry(shard, user_id, group_id, hash, role);
+    } else {
+        __atomic_add_fetch(&stats.stale_fills, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+void membership_cache_set(int user_id, int group_id, MembershipRole role) {
+    unsigned int hash = hash_key(user_id, group_id);
+    Shard *shard = shard_for(hash);
+
+    pthread_mutex_lock(&shard->lock);
+    shard->version++;
+    store_entry(shard, user_id, group_id, hash, role);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+void membership_cache_invalidate(int user_id, int group_id) {
+    unsigned int hash = hash_key(user_id, group_id);
+    Shard *shard = shard_for(hash);
+
+    pthread_mutex_lock(&shard->lock);
+    shard->version++;
+    CacheEntry *entry = find_entry(shard, user_id, group_id, hash);
+    if (entry) remove_entry(shard, entry);
+    pthread_mutex_unlock(&shard->lock);
+
+    __atomic_add_fetch(&stats.invalidations, 1, __ATOMIC_RELAXED);
+}
+
+void membership_cache_clear() {
+    for (int i = 0; i < MEMBERSHIP_CACHE_SHARDS; i++) {
+        Shard *shard = &shards[i];
+        pthread_mutex_lock(&shard->lock);
+        shard->version++;
+        while (shard->lru_head) remove_entry(shard, shard->lru_head);
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    __atomic_add_fetch(&stats.clears, 1, __ATOMIC_RELAXED);
+}
+
+void membership_cache_get_stats(MembershipCacheStats *out) {
+    out->size = 0;
+    for (int i = 0; i < MEMBERSHIP_CACHE_SHARDS; i++) {
+        pthread_mutex_lock(&shards[i].lock);
+        out->size += shards[i].count;
+        pthread_mutex_unlock(&shards[i].lock);
+    }
+    out->capacity = stats.capacity;
+    out->hits = __atomic_load_n(&stats.hits, __ATOMIC_RELAXED);
+    out->misses = __atomic_load_n(&stats.misses, __ATOMIC_RELAXED);
+    out->evictions = __atomic_load_n(&stats.evictions, __ATOMIC_RELAXED);
+    out->invalidations = __atomic_load_n(&stats.invalidations, __ATOMIC_RELAXED);
+    out->stale_fills = __atomic_load_n(&stats.stale_fills, __ATOMIC_RELAXED);
+    out->clears = __atomic_load_n(&stats.clears, __ATOMIC_RELAXED);
+}
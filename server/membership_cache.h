@@ -0,0 +1,49 @@
+#ifndef MEMBERSHIP_CACHE_H
+#define MEMBERSHIP_CACHE_H
+
+#define MEMBERSHIP_CACHE_SHARDS 16
+#define MEMBERSHIP_CACHE_CAPACITY 16384     // Entries across all shards
+#define MEMBERSHIP_CACHE_TTL 300            // Seconds, safety net behind the notifications other servers send
+
+// What a user is in a group. The group owner counts as an admin; pending and
+// rejected members count as none.
+typedef enum {
+    MEMBERSHIP_NONE = 0,
+    MEMBERSHIP_MEMBER,
+    MEMBERSHIP_ADMIN
+} MembershipRole;
+
+typedef struct {
+    int size;
+    int capacity;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+    unsigned long long invalidations;
+    unsigned long long stale_fills;     // Loads dropped because a write raced with them
+    unsigned long long clears;
+} MembershipCacheStats;
+
+// Must run before the first lookup.
+void membership_cache_init();
+
+// Returns 1 and sets *role on a hit. On a miss, *version is set to the value
+// to pass to membership_cache_fill() once the role has been read from the
+// database.
+int membership_cache_get(int user_id, int group_id, MembershipRole *role, unsigned long long *version);
+
+// Caches a role loaded from the database, unless a write to the same shard
+// happened since membership_cache_get() handed out version.
+void membership_cache_fill(int user_id, int group_id, MembershipRole role, unsigned long long version);
+
+// Write paths: record a role the caller just committed, or drop the entry so
+// the next check reloads it.
+void membership_cache_set(int user_id, int group_id, MembershipRole role);
+void membership_cache_invalidate(int user_id, int group_id);
+
+// Drops every entry, for when membership changes may have gone unnoticed.
+void membership_cache_clear();
+
+void membership_cache_get_stats(MembershipCacheStats *stats);
+
+#endif
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+#include <pthread.h>
+#include "name_cache.h"
+
+#define SHARD_CAPACITY (NAME_CACHE_CAPACITY / NAME_CACHE_SHARDS)
+#define SHARD_BUCKETS 256   // Power of two
+
+// The string handed to callers is str; the header in front of it carries the
+// reference count.
+typedef struct {
+    int refs;
+    char str[];
+} InternedName;
+
+typedef struct CacheEntry {
+    NameKind kind;
+    int id;
+    unsigned int hash;
+    InternedName *name;             // The cache holds one reference
+    time_t valid_until;
+    struct CacheEntry *bucket_next;
+    struct CacheEntry *lru_prev;    // Towards the most recently used
+    struct CacheEntry *lru_next;
+} CacheEntry;
+
+// Same layout as the membership cache: independent shards, each with its own
+// lock, hash table and LRU list, and a version bumped by every write.
+typedef struct {
+    pthread_mutex_t lock;
+    CacheEntry *buckets[SHARD_BUCKETS];
+    CacheEntry *lru_head;           // Most recently used
+    CacheEntry *lru_tail;           // Next to evict
+    int count;
+    unsigned long long version;
+} Shard;
+
+static Shard shards[NAME_CACHE_SHARDS];
+static NameCacheStats stats;        // Counters updated with atomic builtins
+
+static InternedName *interned_from(const char *str) {
+    return (InternedName *)(str - offsetof(InternedName, str));
+}
+
+static InternedName *intern(const char *str) {
+    size_t len = strlen(str);
+    InternedName *name = malloc(sizeof(InternedName) + len + 1);
+    if (!name) return NULL;
+    name->refs = 1;
+    memcpy(name->str, str, len + 1);
+    return name;
+}
+
+static void name_acquire(InternedName *name) {
+    __atomic_add_fetch(&name->refs, 1, __ATOMIC_RELAXED);
+}
+
+void name_release(const char *str) {
+    if (!str) return;
+    InternedName *name = interned_from(str);
+    if (__atomic_sub_fetch(&name->refs, 1, __ATOMIC_ACQ_REL) == 0) free(name);
+}
+
+static unsigned int hash_key(NameKind kind, int id) {
+    unsigned long long key = ((unsigned long long)kind << 32) | (unsigned int)id;
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (unsigned int)key;
+}
+
+static Shard *shard_for(unsigned int hash) {
+    return &shards[hash % NAME_CACHE_SHARDS];
+}
+
+static CacheEntry **bucket_for(Shard *shard, unsigned int hash) {
+    return &shard->buckets[(hash / NAME_CACHE_SHARDS) & (SHARD_BUCKETS - 1)];
+}
+
+static void lru_unlink(Shard *shard, CacheEntry *entry) {
+    if (entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+    else shard->lru_head = entry->lru_next;
+    if (entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+    else shard->lru_tail = entry->lru_prev;
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void lru_push_front(Shard *shard, CacheEntry *entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = shard->lru_head;
+    if (shard->lru_head) shard->lru_head->lru_prev = entry;
+    shard->lru_head = entry;
+    if (!shard->lru_tail) shard->lru_tail = entry;
+}
+
+static CacheEntry *find_entry(Shard *shard, NameKind kind, int id, unsigned int hash) {
+    for (CacheEntry *entry = *bucket_for(shard, hash); entry; entry = entry->bucket_next) {
+        if (entry->kind == kind && entry->id == id) return entry;
+    }
+    return NULL;
+}
+
+// Unlinks and frees an entry, dropping the cache's reference to its name.
+// Caller holds the shard lock.
+static void remove_entry(Shard *shard, CacheEntry *entry) {
+    CacheEntry **link = bucket_for(shard, entry->hash);
+    while (*link != entry) link = &(*link)->bucket_next;
+    *link = entry->bucket_next;
+
+    lru_unlink(shard, entry);
+    shard->count--;
+    name_release(entry->name->str);
+    free(entry);
+}
+
+// Inserts or replaces an entry, taking a new reference to name. Caller holds
+// the shard lock.
+static void store_entry(Shard *shard, NameKind kind, int id, unsigned int hash, InternedName *name) {
+    CacheEntry *entry = find_entry(shard, kind, id, hash);
+    if (entry) {
+        lru_unlink(shard, entry);
+        name_release(entry->name->str);
+    } else {
+        if (shard->count >= SHARD_CAPACITY) {
+            remove_entry(shard, shard->lru_tail);
+            __atomic_add_fetch(&stats.evictions, 1, __ATOMIC_RELAXED);
+        }
+
+        entry = calloc(1, sizeof(CacheEntry));
+        if (!entry) return;
+        entry->kind = kind;
+        entry->id = id;
+        entry->hash = hash;
+
+        CacheEntry **bucket = bucket_for(shard, hash);
+        entry->bucket_next = *bucket;
+        *bucket = entry;
+        shard->count++;
+    }
+
+    name_acquire(name);
+    entry->name = name;
+    entry->valid_until = time(NULL) + NAME_CACHE_TTL;
+    lru_push_front(shard, entry);
+}
+
+void name_cache_init() {
+    for (int i = 0; i < NAME_CACHE_SHARDS; i++) {
+        pthread_mutex_init(&shards[i].lock, NULL);
+    }
+    memset(&stats, 0, sizeof(stats));
+    stats.capacity = SHARD_CAPACITY * NAME_CACHE_SHARDS;
+}
+
+const char *name_cache_get(NameKind kind, int id, unsigned long long *version) {
+    unsigned int hash = hash_key(kind, id);
+    Shard *shard = shard_for(hash);
+    const char *result = NULL;
+
+    pthread_mutex_lock(&shard->lock);
+    CacheEntry *entry = find_entry(shard, kind, id, hash);
+    if (entry && entry->valid_until <= time(NULL)) {
+        remove_entry(shard, entry);
+        entry = NULL;
+    }
+    if (entry) {
+        lru_unlink(shard, entry);
+        lru_push_front(shard, entry);
+        name_acquire(entry->name);
+        result = entry->name->str;
+    } else {
+        *version = shard->version;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    if (result) __atomic_add_fetch(&stats.hits, 1, __ATOMIC_RELAXED);
+    else __atomic_add_fetch(&stats.misses, 1, __ATOMIC_RELAXED);
+    return result;
+}
+
+const char *name_cache_fill(NameKind kind, int id, const char *str, unsigned long long version) {
+    InternedName *name = intern(str);
+    if (!name) return NULL;
+
+    unsigned int hash = hash_key(kind, id);
+    Shard *shard = shard_for(hash);
+
+    pthread_mutex_lock(&shard->lock);
+    if (shard->version == version) {
+        store_entry(shard, kind, id, hash, name);
+    } else {
+        __atomic_add_fetch(&stats.stale_fills, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    return name->str;
+}
+
+void name_cache_invalidate(NameKind kind, int id) {
+    unsigned int hash = hash_key(kind, id);
+    Shard *shard = shard_for(hash);
+
+    pthread_mutex_lock(&shard->lock);
+    shard->version++;
+    CacheEntry *entry = find_entry(shard, kind, id, hash);
+    if (entry) remove_entry(shard, entry);
+    pthread_mutex_unlock(&shard->lock);
+
+    __atomic_add_fetch(&stats.invalidations, 1, __ATOMIC_RELAXED);
+}
+
+void name_cache_get_stats(NameCacheStats *out) {
+    out->size = 0;
+    for (int i = 0; i < NAME_CACHE_SHARDS; i++) {
+        pthread_mutex_lock(&shards[i].lock);
+        out->size += shards[i].count;
+        pthread_mutex_unlock(&shards[i].lock);
+    }
+    out->capacity = stats.capacity;
+    out->hits = __atomic_load_n(&stats.hits, __ATOMIC_RELAXED);
+    out->misses = __atomic_load_n(&stats.misses, __ATOMIC_RELAXED);
+    out->evictions = __atomic_load_n(&stats.evictions, __ATOMIC_RELAXED);
+    out->invalidations = __atomic_load_n(&stats.invalidations, __ATOMIC_RELAXED);
+    out->stale_fills = __atomic_load_n(&stats.stale_fills, __ATOMIC_RELAXED);
+}
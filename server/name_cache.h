@@ -0,0 +1,50 @@
+#ifndef NAME_CACHE_H
+#define NAME_CACHE_H
+
+#define NAME_CACHE_SHARDS 16
+#define NAME_CACHE_CAPACITY 16384   // Entries across all shards
+#define NAME_CACHE_TTL 600          // Seconds, bounds staleness from writes made outside this server
+
+// Display names resolved from ids for notification text
+typedef enum {
+    NAME_USER = 0,      // users.username
+    NAME_GROUP          // groups.group_name
+} NameKind;
+
+typedef struct {
+    int size;
+    int capacity;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+    unsigned long long invalidations;
+    unsigned long long stale_fills;     // Loads dropped because a write raced with them
+} NameCacheStats;
+
+// Names are handed out as shared, refcounted strings: one copy per (kind, id)
+// whoever asks for it. Every non-NULL name returned below is a reference the
+// caller gives back with name_release(). The string stays valid until then,
+// even if the entry is invalidated or evicted meanwhile.
+
+// Must run before the first lookup.
+void name_cache_init();
+
+// Returns a reference on a hit. On a miss returns NULL and sets *version to
+// the value to pass to name_cache_fill() once the name has been read from
+// the database.
+const char *name_cache_get(NameKind kind, int id, unsigned long long *version);
+
+// Interns a name loaded from the database and returns a reference to it.
+// The cache keeps it too, unless a write to the same shard happened since
+// name_cache_get() handed out version. Returns NULL if out of memory.
+const char *name_cache_fill(NameKind kind, int id, const char *name, unsigned long long version);
+
+// Write paths: drop the entry so the next lookup reloads it.
+void name_cache_invalidate(NameKind kind, int id);
+
+// Accepts NULL.
+void name_release(const char *name);
+
+void name_cache_get_stats(NameCacheStats *stats);
+
+#endif
@@ -0,0 +1,425 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <libpq-fe.h>
+#include <json-c/json.h>
+#include "notify_hub.h"
+#include "event_loop.h"
+#include "database.h"
+#include "db_statements.h"
+#include "unread_cache.h"
+#include "membership_cache.h"
+#include "session_cache.h"
+#include "name_cache.h"
+#include "permission_table.h"
+#include "user_search.h"
+#include "group_search.h"
+#include "username_filter.h"
+
+typedef struct {
+    int sock;
+    unsigned long long conn_id;
+    int user_id;
+} Subscriber;
+
+// Flat list, scanned per notification. Entries leave through the event
+// loop's close handler, so a (sock, conn_id) here always names a live
+// connection or one the loop is about to drop.
+static Subscriber *subscribers = NULL;
+static int subscriber_count = 0;
+static int subscriber_cap = 0;
+static pthread_mutex_t hub_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static NotifyHubStats stats;        // Counters updated with atomic builtins
+static char *listener_conninfo = NULL;
+
+// Outcome of the listener's first connect and load: -1 until it is known
+static int first_load = -1;
+static pthread_mutex_t first_load_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t first_load_cond = PTHREAD_COND_INITIALIZER;
+
+// Caller holds hub_lock.
+static int find_subscriber(int sock, unsigned long long conn_id) {
+    for (int i = 0; i < subscriber_count; i++) {
+        if (subscribers[i].sock == sock && subscribers[i].conn_id == conn_id) return i;
+    }
+    return -1;
+}
+
+static void remove_subscriber(int sock, unsigned long long conn_id) {
+    pthread_mutex_lock(&hub_lock);
+    int i = find_subscriber(sock, conn_id);
+    if (i >= 0) subscribers[i] = subscribers[--subscriber_count];
+    pthread_mutex_unlock(&hub_lock);
+}
+
+void notify_hub_subscribe(int sock, int user_id) {
+    unsigned long long conn_id = net_connection_id(sock);
+
+    pthread_mutex_lock(&hub_lock);
+    int i = find_subscriber(sock, conn_id);
+    if (i < 0) {
+        if (subscriber_count == subscriber_cap) {
+            int new_cap = subscriber_cap ? subscriber_cap * 2 : 64;
+            Subscriber *grown = realloc(subscribers, new_cap * sizeof(Subscriber));
+            if (!grown) {
+                pthread_mutex_unlock(&hub_lock);
+                fprintf(stderr, "Out of memory adding notification subscriber\n");
+                return;
+            }
+            subscribers = grown;
+            subscriber_cap = new_cap;
+        }
+        i = subscriber_count++;
+        subscribers[i].sock = sock;
+        subscribers[i].conn_id = conn_id;
+    }
+    subscribers[i].user_id = user_id;
+    pthread_mutex_unlock(&hub_lock);
+}
+
+void notify_hub_unsubscribe(int sock) {
+    remove_subscriber(sock, net_connection_id(sock));
+}
+
+// Adds a user registered by any server process to the username filter and
+// the user search index
+static void index_registration(struct json_object *registered) {
+    struct json_object *id_obj, *username_obj, *full_name_obj;
+    if (!json_object_object_get_ex(registered, "user_id", &id_obj) ||
+        !json_object_object_get_ex(registered, "username", &username_obj)) {
+        __atomic_add_fetch(&stats.bad_payloads, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    const char *full_name = json_object_object_get_ex(registered, "full_name", &full_name_obj)
+                          ? json_object_get_string(full_name_obj) : NULL;
+
+    username_filter_add(json_object_get_string(username_obj));
+    user_search_add(json_object_get_int(id_obj), json_object_get_string(username_obj), full_name);
+}
+
+// Applies a full name changed by any server process to the user search index
+static void index_profile(struct json_object *profile) {
+    struct json_object *id_obj, *full_name_obj;
+    if (!json_object_object_get_ex(profile, "user_id", &id_obj)) {
+        __atomic_add_fetch(&stats.bad_payloads, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    const char *full_name = json_object_object_get_ex(profile, "full_name", &full_name_obj)
+                          ? json_object_get_string(full_name_obj) : NULL;
+
+    user_search_update_full_name(json_object_get_int(id_obj), full_name);
+}
+
+// Indexes a group created or edited by any server process for search, and
+// drops its cached name
+static void index_group(struct json_object *group) {
+    struct json_object *id_obj, *owner_obj, *name_obj, *description_obj;
+    if (!json_object_object_get_ex(group, "group_id", &id_obj) ||
+        !json_object_object_get_ex(group, "owner_id", &owner_obj) ||
+        !json_object_object_get_ex(group, "group_name", &name_obj)) {
+        __atomic_add_fetch(&stats.bad_payloads, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    const char *description = json_object_object_get_ex(group, "description", &description_obj)
+                            ? json_object_get_string(description_obj) : NULL;
+
+    int group_id = json_object_get_int(id_obj);
+    name_cache_invalidate(NAME_GROUP, group_id);
+    group_search_add(group_id, json_object_get_int(owner_obj), json_object_get_string(name_obj), description);
+}
+
+// Applies a permissions row change made by any server process. The writer
+// applied it already; applying it again is harmless.
+static void apply_permission(struct json_object *permission) {
+    struct json_object *id_obj, *user_obj, *group_obj, *mask_obj, *removed_obj;
+    if (!json_object_object_get_ex(permission, "permission_id", &id_obj) ||
+        !json_object_object_get_ex(permission, "user_id", &user_obj) ||
+        !json_object_object_get_ex(permission, "group_id", &group_obj)) {
+        __atomic_add_fetch(&stats.bad_payloads, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    int user_id = json_object_get_int(user_obj);
+    int group_id = json_object_get_int(group_obj);
+
+    if (json_object_object_get_ex(permission, "removed", &removed_obj) &&
+        json_object_get_boolean(removed_obj)) {
+        permission_table_remove(user_id, group_id);
+        return;
+    }
+    if (!json_object_object_get_ex(permission, "mask", &mask_obj)) {
+        __atomic_add_fetch(&stats.bad_payloads, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    PermissionEntry entry = { user_id, group_id, json_object_get_int(id_obj),
+                              (unsigned int)json_object_get_int(mask_obj) & PERM_ALL };
+    permission_table_set(&entry);
+}
+
+// Drops a group_members row change made by any server process from the
+// membership cache; the next check reloads the role
+static void apply_membership(struct json_object *membership) {
+    struct json_object *user_obj, *group_obj;
+    if (!json_object_object_get_ex(membership, "user_id", &user_obj) ||
+        !json_object_object_get_ex(membership, "group_id", &group_obj)) {
+        __atomic_add_fetch(&stats.bad_payloads, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    int user_id = json_object_get_int(user_obj);
+    membership_cache_invalidate(user_id, json_object_get_int(group_obj));
+    // The groups counted in the user's unread count may have changed too
+    unread_cache_invalidate(user_id);
+}
+
+// Drops sessions logged out on any server process ({"session_token": ...}),
+// or all sessions of a user whose password, username or role changed
+// ({"user_id": ...}), from the session cache
+static void apply_session(struct json_object *session) {
+    struct json_object *token_obj, *user_obj;
+    if (json_object_object_get_ex(session, "session_token", &token_obj)) {
+        session_cache_remove(json_object_get_string(token_obj));
+    } else if (json_object_object_get_ex(session, "user_id", &user_obj)) {
+        session_cache_remove_user(json_object_get_int(user_obj));
+    } else {
+        __atomic_add_fetch(&stats.bad_payloads, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// Pushes one NOTIFY payload to the subscribers it concerns. The payload is
+// {"user_id": ..., "group_id": ..., "seq": ..., "notification": {...}} with
+// group_id 0 for personal notifications, {"registered": {...}} for a new user,
+// {"profile": {...}} for a changed full name,
+// {"group": {...}} for a new or edited group, {"permission": {...}} for a
+// permissions row change, {"membership": {...}} for a group_members row
+// change or {"session": {...}} for a logout or account change.
+static void dispatch(const char *payload) {
+    struct json_object *event = json_tokener_parse(payload);
+    struct json_object *user_obj, *group_obj, *notif_obj, *registered_obj, *permission_obj, *membership_obj,
+                      *session_obj, *profile_obj;
+    if (event && json_object_object_get_ex(event, "registered", &registered_obj)) {
+        index_registration(registered_obj);
+        json_object_put(event);
+        return;
+    }
+    if (event && json_object_object_get_ex(event, "profile", &profile_obj)) {
+        index_profile(profile_obj);
+        json_object_put(event);
+        return;
+    }
+    if (event && json_object_object_get_ex(event, "group", &group_obj)) {
+        index_group(group_obj);
+        json_object_put(event);
+        return;
+    }
+    if (event && json_object_object_get_ex(event, "permission", &permission_obj)) {
+        apply_permission(permission_obj);
+        json_object_put(event);
+        return;
+    }
+    if (event && json_object_object_get_ex(event, "membership", &membership_obj)) {
+        apply_membership(membership_obj);
+        json_object_put(event);
+        return;
+    }
+    if (event && json_object_object_get_ex(event, "session", &session_obj)) {
+        apply_session(session_obj);
+        json_object_put(event);
+        return;
+    }
+    if (!event ||
+        !json_object_object_get_ex(event, "user_id", &user_obj) ||
+        !json_object_object_get_ex(event, "group_id", &group_obj) ||
+        !json_object_object_get_ex(event, "notification", &notif_obj)) {
+        __atomic_add_fetch(&stats.bad_payloads, 1, __ATOMIC_RELAXED);
+        if (event) json_object_put(event);
+        return;
+    }
+    int user_id = json_object_get_int(user_obj);
+    int group_id = json_object_get_int(group_obj);
+
+    // Every server sees every insert here, after it committed, so this is
+    // where cached counts are brought up to date. A group notification only
+    // raises the group's seq, whoever its members are. A personal one drops
+    // the recipient's count; invalidating rather than adding one also stops
+    // fills that read the count before the insert from caching it.
+    if (group_id > 0) {
+        struct json_object *seq_obj;
+        int seq = json_object_object_get_ex(event, "seq", &seq_obj) ? json_object_get_int(seq_obj) : 0;
+        if (seq > 0) unread_cache_group_seq(group_id, seq);
+        else unread_cache_clear();
+    } else {
+        unread_cache_invalidate(user_id);
+    }
+
+    // Copy the candidates out so membership checks and pushes run without
+    // the lock
+    pthread_mutex_lock(&hub_lock);
+    Subscriber *targets = subscriber_count ? malloc(subscriber_count * sizeof(Subscriber)) : NULL;
+    int target_count = 0;
+    for (int i = 0; targets && i < subscriber_count; i++) {
+        if (group_id > 0 || subscribers[i].user_id == user_id) targets[target_count++] = subscribers[i];
+    }
+    pthread_mutex_unlock(&hub_lock);
+
+    // Only this process's subscribers are checked, mostly from the
+    // membership cache, rather than loading every member of the group
+    if (group_id > 0) {
+        int kept = 0;
+        for (int i = 0; i < target_count; i++) {
+            if (db_is_group_member(targets[i].user_id, group_id)) targets[kept++] = targets[i];
+        }
+        target_count = kept;
+        db_release_connection();
+    }
+
+    if (target_count > 0) {
+        struct json_object *push = json_object_new_object();
+        json_object_object_add(push, "event", json_object_new_string("NOTIFICATION"));
+        json_object_object_add(push, "payload", json_object_get(notif_obj));
+        const char *frame = json_object_to_json_string(push);
+        size_t frame_len = strlen(frame);
+
+        for (int i = 0; i < target_count; i++) {
+            if (net_push(targets[i].sock, targets[i].conn_id, frame, frame_len) == 0) {
+                __atomic_add_fetch(&stats.pushed, 1, __ATOMIC_RELAXED);
+            }
+        }
+        json_object_put(push);
+    }
+
+    free(targets);
+    json_object_put(event);
+}
+
+// Waits for notifications until the connection fails.
+static void receive_notifications(PGconn *conn) {
+    int fd = PQsocket(conn);
+
+    while (1) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("Notification listener poll failed");
+            return;
+        }
+        if (!PQconsumeInput(conn)) {
+            fprintf(stderr, "Notification listener lost connection: %s", PQerrorMessage(conn));
+            return;
+        }
+
+        PGnotify *notify;
+        while ((notify = PQnotifies(conn)) != NULL) {
+            __atomic_add_fetch(&stats.received, 1, __ATOMIC_RELAXED);
+            dispatch(notify->extra);
+            PQfreemem(notify);
+        }
+    }
+}
+
+// Wakes notify_hub_init() with the outcome of the first attempt; later ones
+// are ignored
+static void report_first_load(int ok) {
+    pthread_mutex_lock(&first_load_lock);
+    if (first_load < 0) {
+        first_load = ok;
+        pthread_cond_broadcast(&first_load_cond);
+    }
+    pthread_mutex_unlock(&first_load_lock);
+}
+
+// Owns a dedicated connection, outside the pool since it stays in LISTEN for
+// good. Notifications raised while it is reconnecting are not replayed;
+// clients still get them from GET_NOTIFICATIONS.
+static void *listener_main(void *arg) {
+    (void)arg;
+
+    while (1) {
+        PGconn *conn = PQconnectdb(listener_conninfo);
+        if (PQstatus(conn) == CONNECTION_OK) {
+            PGresult *res = PQexec(conn, "LISTEN " DB_NOTIFY_CHANNEL);
+            int ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+            PQclear(res);
+
+            if (ok) {
+                // Counts, roles and sessions cached while nobody was
+                // listening may have missed changes
+                unread_cache_clear();
+                membership_cache_clear();
+                session_cache_clear();
+                // Load permissions, groups and users only now: with LISTEN
+                // up, anything committed after these scans arrives as a
+                // notification, so none is missed. This is also the
+                // startup load.
+                int loaded = 1;
+                if (!db_load_permissions()) {
+                    fprintf(stderr, "Permission table may be stale until the listener reconnects\n");
+                    loaded = 0;
+                }
+                if (!db_load_groups()) {
+                    fprintf(stderr, "Group search may miss groups until the listener reconnects\n");
+                    loaded = 0;
+                }
+                if (db_load_users()) {
+                    username_filter_set_complete(1);
+                } else {
+                    fprintf(stderr, "Username filter stays incomplete until the listener reconnects\n");
+                    loaded = 0;
+                }
+                db_release_connection();
+                report_first_load(loaded);
+                __atomic_store_n(&stats.listening, 1, __ATOMIC_RELAXED);
+                receive_notifications(conn);
+                __atomic_store_n(&stats.listening, 0, __ATOMIC_RELAXED);
+                username_filter_set_complete(0);
+            } else {
+                fprintf(stderr, "LISTEN failed: %s", PQerrorMessage(conn));
+                report_first_load(0);
+            }
+        } else {
+            fprintf(stderr, "Notification listener cannot connect: %s", PQerrorMessage(conn));
+            report_first_load(0);
+        }
+        PQfinish(conn);
+
+        __atomic_add_fetch(&stats.reconnects, 1, __ATOMIC_RELAXED);
+        sleep(NOTIFY_RECONNECT_SECONDS);
+    }
+
+    return NULL;
+}
+
+int notify_hub_init(const char *conninfo) {
+    memset(&stats, 0, sizeof(stats));
+    listener_conninfo = strdup(conninfo);
+    if (!listener_conninfo) return 0;
+
+    net_set_close_handler(remove_subscriber);
+
+    pthread_t thread_id;
+    if (pthread_create(&thread_id, NULL, listener_main, NULL) != 0) {
+        perror("Notification listener thread creation failed");
+        return 0;
+    }
+    pthread_detach(thread_id);
+
+    pthread_mutex_lock(&first_load_lock);
+    while (first_load < 0) pthread_cond_wait(&first_load_cond, &first_load_lock);
+    int loaded = first_load;
+    pthread_mutex_unlock(&first_load_lock);
+    return loaded;
+}
+
+void notify_hub_get_stats(NotifyHubStats *out) {
+    pthread_mutex_lock(&hub_lock);
+    out->subscribers = subscriber_count;
+    pthread_mutex_unlock(&hub_lock);
+    out->listening = __atomic_load_n(&stats.listening, __ATOMIC_RELAXED);
+    out->received = __atomic_load_n(&stats.received, __ATOMIC_RELAXED);
+    out->pushed = __atomic_load_n(&stats.pushed, __ATOMIC_RELAXED);
+    out->bad_payloads = __atomic_load_n(&stats.bad_payloads, __ATOMIC_RELAXED);
+    out->reconnects = __atomic_load_n(&stats.reconnects, __ATOMIC_RELAXED);
+}
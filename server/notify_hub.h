@@ -0,0 +1,34 @@
+#ifndef NOTIFY_HUB_H
+#define NOTIFY_HUB_H
+
+#define NOTIFY_RECONNECT_SECONDS 5     // Delay before the listener retries a lost connection
+
+typedef struct {
+    int subscribers;
+    int listening;                      // Listener connection is up
+    unsigned long long received;        // Notifications delivered by Postgres
+    unsigned long long pushed;          // Frames queued for subscribers
+    unsigned long long bad_payloads;
+    unsigned long long reconnects;
+} NotifyHubStats;
+
+// Live notification delivery. Every notification insert also raises a
+// Postgres NOTIFY (see DB_NOTIFY_CHANNEL in db_statements.h). Each server
+// process LISTENs on its own connection and pushes what it receives to its
+// subscribed clients, so a notification created by any process reaches
+// subscribers connected to any other.
+
+// Starts the listener thread and waits for its first LISTEN and the load of
+// permissions, groups and users that follows it. Returns 0 if that failed.
+// The caches must be initialised first. Pushes go through the event loop, so
+// subscriptions only take effect once it runs.
+int notify_hub_init(const char *conninfo);
+
+// Subscribes the connection a request arrived on. Call from its handler.
+// A connection has at most one subscription; subscribing again replaces it.
+void notify_hub_subscribe(int sock, int user_id);
+void notify_hub_unsubscribe(int sock);
+
+void notify_hub_get_stats(NotifyHubStats *stats);
+
+#endif
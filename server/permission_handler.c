@@ -38,8 +38,8 @@ void handle_get_permissions(int sock, struct json_object *request) {
     }
     
     // Get permissions
-    PermissionInfo *perm = db_get_permissions(user->user_id, group_id);
-    if (!perm) {
+    PermissionInfo perm;
+    if (!db_get_permissions(user->user_id, group_id, &perm)) {
         free(user);
         send_error_response(sock, STATUS_NOT_FOUND, "ERROR_NOT_FOUND", "Permissions not found");
         return;
@@ -54,17 +54,15 @@ void handle_get_permissions(int sock, struct json_object *request) {
     struct json_object *payload = json_object_new_object();
     json_object_object_add(payload, "user_id", json_object_new_int(user->user_id));
     json_object_object_add(payload, "group_id", json_object_new_int(group_id));
-    json_object_object_add(payload, "can_read", json_object_new_boolean(perm->can_read));
-    json_object_object_add(payload, "can_write", json_object_new_boolean(perm->can_write));
-    json_object_object_add(payload, "can_delete", json_object_new_boolean(perm->can_delete));
-    json_object_object_add(payload, "can_manage", json_object_new_boolean(perm->can_manage));
+    json_object_object_add(payload, "can_read", json_object_new_boolean(perm.can_read));
+    json_object_object_add(payload, "can_write", json_object_new_boolean(perm.can_write));
+    json_object_object_add(payload, "can_delete", json_object_new_boolean(perm.can_delete));
+    json_object_object_add(payload, "can_manage", json_object_new_boolean(perm.can_manage));
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
-    free(perm);
     json_object_put(response);
 }
 
@@ -136,8 +134,7 @@ void handle_update_permissions(int sock, struct json_object *request) {
     json_object_object_add(payload, "can_manage", json_object_new_boolean(can_manage));
     json_object_object_add(response, "payload", payload);
     
-    const char *json_str = json_object_to_json_string(response);
-    send(sock, json_str, strlen(json_str), 0);
+    send_json_response(sock, response);
     
     free(user);
     json_object_put(response);
@@ -0,0 +1,223 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "permission_table.h"
+#include "qsbr.h"
+
+#define ROOT_SLOTS 256      // Power of two
+#define PAGE_SLOTS 256      // Power of two
+#define BUCKET_COUNT (ROOT_SLOTS * PAGE_SLOTS)
+
+// A snapshot is a two-level radix tree over the hash: the root points to
+// pages, pages point to buckets and buckets hold the entries. All three are
+// immutable once published, so a write copies one root, one page and one
+// bucket and shares everything else with the previous snapshot. Each of
+// those has a fixed size (a bucket holds count / BUCKET_COUNT entries on
+// average), so a write costs the same however large the table is.
+typedef struct {
+    int count;
+    PermissionEntry entries[];
+} Bucket;
+
+typedef struct {
+    Bucket *buckets[PAGE_SLOTS];
+} Page;
+
+typedef struct {
+    int count;
+    unsigned long long version;
+    Page *pages[ROOT_SLOTS];
+} Snapshot;
+
+static Snapshot *current = NULL;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int hash_key(int user_id, int group_id) {
+    unsigned long long key = ((unsigned long long)(unsigned int)user_id << 32) | (unsigned int)group_id;
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (unsigned int)key;
+}
+
+static unsigned int root_slot(unsigned int hash) {
+    return (hash >> 8) & (ROOT_SLOTS - 1);
+}
+
+static unsigned int page_slot(unsigned int hash) {
+    return hash & (PAGE_SLOTS - 1);
+}
+
+static const PermissionEntry *snapshot_find(const Snapshot *snap, int user_id, int group_id) {
+    unsigned int hash = hash_key(user_id, group_id);
+    const Page *page = snap->pages[root_slot(hash)];
+    if (!page) return NULL;
+    const Bucket *bucket = page->buckets[page_slot(hash)];
+    if (!bucket) return NULL;
+
+    for (int i = 0; i < bucket->count; i++) {
+        const PermissionEntry *entry = &bucket->entries[i];
+        if (entry->user_id == user_id && entry->group_id == group_id) return entry;
+    }
+    return NULL;
+}
+
+// New bucket holding old's entries except (user_id, group_id), plus entry if
+// it is not NULL. Sets *result to NULL and returns 0 when nothing is left.
+// Returns -1 when out of memory.
+static int bucket_with(const Bucket *old, int user_id, int group_id, const PermissionEntry *entry,
+                       Bucket **result) {
+    int old_count = old ? old->count : 0;
+    Bucket *next = malloc(sizeof(Bucket) + (old_count + 1) * sizeof(PermissionEntry));
+    if (!next) return -1;
+
+    next->count = 0;
+    for (int i = 0; i < old_count; i++) {
+        const PermissionEntry *existing = &old->entries[i];
+        if (existing->user_id == user_id && existing->group_id == group_id) continue;
+        next->entries[next->count++] = *existing;
+    }
+    if (entry) next->entries[next->count++] = *entry;
+
+    if (next->count == 0) {
+        free(next);
+        next = NULL;
+    }
+    *result = next;
+    return 0;
+}
+
+static void free_page_tree(Page *page) {
+    for (int i = 0; i < PAGE_SLOTS; i++) free(page->buckets[i]);
+    free(page);
+}
+
+// Frees a snapshot with every page and bucket it points to. Only for one
+// that shares nothing with the current snapshot.
+static void snapshot_free_all(void *ptr) {
+    Snapshot *snap = ptr;
+    for (int i = 0; i < ROOT_SLOTS; i++) {
+        if (snap->pages[i]) free_page_tree(snap->pages[i]);
+    }
+    free(snap);
+}
+
+// Publishes next in place of the current snapshot. Caller holds writer_lock.
+static void publish(Snapshot *next) {
+    Snapshot *old = current;
+    next->version = old ? old->version + 1 : 1;
+    __atomic_store_n(&current, next, __ATOMIC_RELEASE);
+}
+
+// Stores entry for (user_id, group_id), or removes the row if entry is NULL,
+// copying only the path to its bucket. Caller holds writer_lock.
+static int snapshot_update(int user_id, int group_id, const PermissionEntry *entry) {
+    Snapshot *old = current;
+    unsigned int hash = hash_key(user_id, group_id);
+    Page *old_page = old ? old->pages[root_slot(hash)] : NULL;
+    Bucket *old_bucket = old_page ? old_page->buckets[page_slot(hash)] : NULL;
+    int found = old && snapshot_find(old, user_id, group_id) != NULL;
+
+    Snapshot *next = malloc(sizeof(Snapshot));
+    Page *page = malloc(sizeof(Page));
+    Bucket *bucket;
+    if (!next || !page || bucket_with(old_bucket, user_id, group_id, entry, &bucket) < 0) {
+        free(next);
+        free(page);
+        return -1;
+    }
+
+    if (old) memcpy(next, old, sizeof(Snapshot));
+    else memset(next, 0, sizeof(Snapshot));
+    if (old_page) memcpy(page, old_page, sizeof(Page));
+    else memset(page, 0, sizeof(Page));
+
+    page->buckets[page_slot(hash)] = bucket;
+    next->pages[root_slot(hash)] = page;
+    next->count += (entry ? 1 : 0) - found;
+    publish(next);
+
+    // Readers may still be in the replaced path; the rest lives on in next
+    if (old) qsbr_retire(old, free);
+    if (old_page) qsbr_retire(old_page, free);
+    if (old_bucket) qsbr_retire(old_bucket, free);
+    return 0;
+}
+
+void permission_table_load(const PermissionEntry *entries, int count) {
+    Snapshot *next = calloc(1, sizeof(Snapshot));
+    if (!next) {
+        fprintf(stderr, "Out of memory loading %d permissions\n", count);
+        return;
+    }
+    // Nobody sees next yet, so its buckets can be rebuilt in place
+    for (int i = 0; i < count; i++) {
+        unsigned int hash = hash_key(entries[i].user_id, entries[i].group_id);
+        Page **page = &next->pages[root_slot(hash)];
+        if (!*page) *page = calloc(1, sizeof(Page));
+        Bucket *bucket = NULL;
+        if (!*page || bucket_with((*page)->buckets[page_slot(hash)], entries[i].user_id,
+                                  entries[i].group_id, &entries[i], &bucket) < 0) {
+            fprintf(stderr, "Out of memory loading %d permissions\n", count);
+            snapshot_free_all(next);
+            return;
+        }
+        Bucket *old_bucket = (*page)->buckets[page_slot(hash)];
+        next->count += bucket->count - (old_bucket ? old_bucket->count : 0);
+        free(old_bucket);
+        (*page)->buckets[page_slot(hash)] = bucket;
+    }
+
+    pthread_mutex_lock(&writer_lock);
+    Snapshot *old = current;
+    publish(next);
+    if (old) qsbr_retire(old, snapshot_free_all);
+    pthread_mutex_unlock(&writer_lock);
+}
+
+int permission_table_get(int user_id, int group_id, PermissionEntry *out) {
+    const Snapshot *snap = __atomic_load_n(&current, __ATOMIC_ACQUIRE);
+    if (!snap) return 0;
+
+    const PermissionEntry *entry = snapshot_find(snap, user_id, group_id);
+    if (!entry) return 0;
+    *out = *entry;
+    return 1;
+}
+
+int permission_table_check(int user_id, int group_id, unsigned int mask) {
+    const Snapshot *snap = __atomic_load_n(&current, __ATOMIC_ACQUIRE);
+    if (!snap) return 0;
+
+    const PermissionEntry *entry = snapshot_find(snap, user_id, group_id);
+    return entry && (entry->mask & mask) == mask;
+}
+
+void permission_table_set(const PermissionEntry *entry) {
+    pthread_mutex_lock(&writer_lock);
+    // The writer's own process sees the change again through the notify hub
+    const PermissionEntry *existing = current ? snapshot_find(current, entry->user_id, entry->group_id) : NULL;
+    int same = existing && existing->permission_id == entry->permission_id && existing->mask == entry->mask;
+    if (!same && snapshot_update(entry->user_id, entry->group_id, entry) < 0) {
+        fprintf(stderr, "Out of memory updating permissions\n");
+    }
+    pthread_mutex_unlock(&writer_lock);
+}
+
+void permission_table_remove(int user_id, int group_id) {
+    pthread_mutex_lock(&writer_lock);
+    if (current && snapshot_find(current, user_id, group_id) &&
+        snapshot_update(user_id, group_id, NULL) < 0) {
+        fprintf(stderr, "Out of memory updating permissions\n");
+    }
+    pthread_mutex_unlock(&writer_lock);
+}
+
+void permission_table_get_stats(PermissionTableStats *out) {
+    pthread_mutex_lock(&writer_lock);
+    out->size = current ? current->count : 0;
+    out->capacity = BUCKET_COUNT;
+    out->version = current ? current->version : 0;
+    pthread_mutex_unlock(&writer_lock);
+}
@@ -0,0 +1,51 @@
+#ifndef PERMISSION_TABLE_H
+#define PERMISSION_TABLE_H
+
+// Permission bits, one per column of the permissions table
+#define PERM_READ   0x01
+#define PERM_WRITE  0x02
+#define PERM_DELETE 0x04
+#define PERM_MANAGE 0x08
+#define PERM_ALL    (PERM_READ | PERM_WRITE | PERM_DELETE | PERM_MANAGE)
+
+typedef struct {
+    int user_id;
+    int group_id;
+    int permission_id;
+    unsigned int mask;
+} PermissionEntry;
+
+typedef struct {
+    int size;
+    int capacity;                   // Hash buckets, fixed
+    unsigned long long version;     // Snapshots published so far
+} PermissionTableStats;
+
+// In-memory copy of the permissions table, one packed mask per (user, group).
+// Readers never lock: they look up in an immutable snapshot. Writers copy the
+// few fixed-size blocks on the path to the changed row, publish the result
+// and retire the replaced blocks through qsbr.h. Lookups must therefore come
+// from QSBR-registered threads.
+//
+// Every db_* path that changes the permissions table also updates this table
+// right away. Changes made by other server processes (or by hand) arrive
+// through the notify hub, which applies each row change and reloads the
+// whole table whenever it (re)connects.
+
+// Publishes the table loaded at startup. Later rows for the same
+// (user, group) win.
+void permission_table_load(const PermissionEntry *entries, int count);
+
+// Returns 0 if there is no row for (user, group).
+int permission_table_get(int user_id, int group_id, PermissionEntry *out);
+
+// True if every bit in mask is granted.
+int permission_table_check(int user_id, int group_id, unsigned int mask);
+
+// Publishes nothing if the row is already there unchanged
+void permission_table_set(const PermissionEntry *entry);
+void permission_table_remove(int user_id, int group_id);
+
+void permission_table_get_stats(PermissionTableStats *stats);
+
+#endif
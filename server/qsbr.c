@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "qsbr.h"
+
+#define EPOCH_OFFLINE 0     // Real epochs start at 1
+
+typedef struct Retired {
+    void *ptr;
+    void (*free_fn)(void *);
+    unsigned long long epoch;
+    struct Retired *next;
+} Retired;
+
+// Each registered thread publishes the global epoch it last saw while
+// quiescent. Anything retired at epoch E is safe to free once every online
+// thread has published an epoch >= E.
+static unsigned long long global_epoch = 1;
+static unsigned long long thread_epochs[QSBR_MAX_THREADS];
+static int thread_count = 0;
+static __thread int thread_slot = -1;
+
+static Retired *retired_list = NULL;
+static int retired_pending = 0;
+static unsigned long long retired_total = 0;
+static unsigned long long reclaimed_total = 0;
+static pthread_mutex_t retire_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int qsbr_register_thread() {
+    if (thread_slot >= 0) return 1;
+
+    int slot = __atomic_fetch_add(&thread_count, 1, __ATOMIC_SEQ_CST);
+    if (slot >= QSBR_MAX_THREADS) {
+        fprintf(stderr, "Too many QSBR reader threads (max %d)\n", QSBR_MAX_THREADS);
+        return 0;
+    }
+    thread_slot = slot;
+    __atomic_store_n(&thread_epochs[slot], __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST),
+                     __ATOMIC_SEQ_CST);
+    return 1;
+}
+
+// Frees whatever every online thread has moved past. Caller holds retire_lock.
+static void reclaim_locked() {
+    int threads = __atomic_load_n(&thread_count, __ATOMIC_SEQ_CST);
+    if (threads > QSBR_MAX_THREADS) threads = QSBR_MAX_THREADS;
+
+    unsigned long long oldest = ~0ULL;
+    for (int i = 0; i < threads; i++) {
+        unsigned long long epoch = __atomic_load_n(&thread_epochs[i], __ATOMIC_SEQ_CST);
+        if (epoch != EPOCH_OFFLINE && epoch < oldest) oldest = epoch;
+    }
+
+    Retired **link = &retired_list;
+    while (*link) {
+        Retired *item = *link;
+        if (item->epoch <= oldest) {
+            *link = item->next;
+            item->free_fn(item->ptr);
+            free(item);
+            __atomic_sub_fetch(&retired_pending, 1, __ATOMIC_RELAXED);
+            reclaimed_total++;
+        } else {
+            link = &item->next;
+        }
+    }
+}
+
+void qsbr_quiescent() {
+    if (thread_slot < 0) return;
+
+    __atomic_store_n(&thread_epochs[thread_slot], __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST),
+                     __ATOMIC_SEQ_CST);
+
+    // Cheap check first; whoever gets the lock does the freeing
+    if (__atomic_load_n(&retired_pending, __ATOMIC_RELAXED) > 0 &&
+        pthread_mutex_trylock(&retire_lock) == 0) {
+        reclaim_locked();
+        pthread_mutex_unlock(&retire_lock);
+    }
+}
+
+void qsbr_thread_offline() {
+    if (thread_slot < 0) return;
+    __atomic_store_n(&thread_epochs[thread_slot], EPOCH_OFFLINE, __ATOMIC_SEQ_CST);
+}
+
+void qsbr_thread_online() {
+    if (thread_slot < 0) return;
+    __atomic_store_n(&thread_epochs[thread_slot], __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST),
+                     __ATOMIC_SEQ_CST);
+}
+
+void qsbr_retire(void *ptr, void (*free_fn)(void *)) {
+    if (!ptr) return;
+
+    Retired *item = malloc(sizeof(Retired));
+    if (!item) {
+        // Leaking beats freeing under a reader
+        fprintf(stderr, "qsbr_retire: out of memory, leaking %p\n", ptr);
+        return;
+    }
+    item->ptr = ptr;
+    item->free_fn = free_fn;
+
+    pthread_mutex_lock(&retire_lock);
+    // The new pointer was published before this, so a thread that reports
+    // this epoch or later can no longer see ptr
+    item->epoch = __atomic_add_fetch(&global_epoch, 1, __ATOMIC_SEQ_CST);
+    item->next = retired_list;
+    retired_list = item;
+    retired_total++;
+    __atomic_add_fetch(&retired_pending, 1, __ATOMIC_RELAXED);
+    reclaim_locked();
+    pthread_mutex_unlock(&retire_lock);
+}
+
+void qsbr_get_stats(QsbrStats *out) {
+    pthread_mutex_lock(&retire_lock);
+    out->threads = __atomic_load_n(&thread_count, __ATOMIC_RELAXED);
+    if (out->threads > QSBR_MAX_THREADS) out->threads = QSBR_MAX_THREADS;
+    out->retired = retired_total;
+    out->reclaimed = reclaimed_total;
+    out->pending = retired_pending;
+    pthread_mutex_unlock(&retire_lock);
+}
@@ -0,0 +1,39 @@
+#ifndef QSBR_H
+#define QSBR_H
+
+// Quiescent-state based reclamation for read-mostly structures that are
+// replaced wholesale (RCU style). Readers load the current pointer with
+// __atomic_load_n(..., __ATOMIC_ACQUIRE) and use it without locks; writers
+// publish a new copy and hand the old one to qsbr_retire(). It is freed once
+// every registered thread has passed a quiescent state, i.e. finished the
+// request it was working on.
+//
+// Only registered threads may read such structures.
+
+#define QSBR_MAX_THREADS 256
+
+typedef struct {
+    int threads;
+    unsigned long long retired;     // Objects handed to qsbr_retire()
+    unsigned long long reclaimed;
+    int pending;                    // Retired but not yet freed
+} QsbrStats;
+
+// Called once by each reader thread before its first read. Returns 0 if
+// there are no free slots.
+int qsbr_register_thread();
+
+// The calling thread holds no references into protected structures.
+void qsbr_quiescent();
+
+// Brackets a stretch where the thread blocks without reading (e.g. waiting
+// for work), so it does not hold up reclamation meanwhile.
+void qsbr_thread_offline();
+void qsbr_thread_online();
+
+// Frees ptr with free_fn after the current grace period.
+void qsbr_retire(void *ptr, void (*free_fn)(void *));
+
+void qsbr_get_stats(QsbrStats *stats);
+
+#endif
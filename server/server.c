@@ -3,116 +3,104 @@
 #include <string.h>
 #include <unistd.h>
 #include <arpa/inet.h>
-#include <pthread.h>
 #include <libpq-fe.h>
 #include <json-c/json.h>
 #include "../common/protocol.h"
 #include "auth_handler.h"
-#include "permission_handler.h"
-#include "group_handler.h"
 #include "database.h"
+#include "db_pool.h"
+#include "event_loop.h"
+#include "worker_pool.h"
+#include "command_table.h"
+#include "session_cache.h"
+#include "membership_cache.h"
+#include "name_cache.h"
+#include "unread_cache.h"
+#include "notify_hub.h"
 
-typedef struct {
-    int sock;
-    char ip[46];
-} ClientInfo;
+// Looks up the request's command. Returns NULL if it is missing or the server
+// does not implement it.
+static const CommandInfo *resolve_command(struct json_object *request) {
+    struct json_object *cmd_obj;
+    if (!json_object_object_get_ex(request, "command", &cmd_obj) ||
+        !json_object_is_type(cmd_obj, json_type_string)) return NULL;
 
-void *handle_client(void *arg) {
-    ClientInfo *client_info = (ClientInfo *)arg;
-    int client_sock = client_info->sock;
-    char *client_ip = client_info->ip;
-    free(client_info);
-    
-    char buffer[BUFFER_SIZE];
-    int bytes_received;
-    
-    while ((bytes_received = recv(client_sock, buffer, BUFFER_SIZE - 1, 0)) > 0) {
-        buffer[bytes_received] = '\0';
-        
-        printf("Received from %s: %s\n", client_ip, buffer);
-        
-        // Parse JSON request
-        struct json_object *request = json_tokener_parse(buffer);
-        if (!request) {
-            send_error_response(client_sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Invalid JSON format");
-            continue;
-        }
-        
-        // Get command
-        struct json_object *cmd_obj;
-        if (!json_object_object_get_ex(request, "command", &cmd_obj)) {
-            send_error_response(client_sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Missing command field");
-            json_object_put(request);
-            continue;
-        }
-        
-        const char *command = json_object_get_string(cmd_obj);
-        
-        // Route to appropriate handler
-        if (strcmp(command, "REGISTER") == 0) {
-            handle_register(client_sock, request);
-        } else if (strcmp(command, "LOGIN") == 0) {
-            handle_login(client_sock, request, client_ip);
-        } else if (strcmp(command, "LOGOUT") == 0) {
-            handle_logout(client_sock, request);
-        } else if (strcmp(command, "VERIFY_SESSION") == 0) {
-            handle_verify_session(client_sock, request);
-        } else if (strcmp(command, "UPDATE_PROFILE") == 0) {
-            handle_update_profile(client_sock, request);
-        } else if (strcmp(command, "CHANGE_PASSWORD") == 0) {
-            handle_change_password(client_sock, request);
-        } else if (strcmp(command, "GET_PERMISSIONS") == 0) {
-            handle_get_permissions(client_sock, request);
-        } else if (strcmp(command, "UPDATE_PERMISSIONS") == 0) {
-            handle_update_permissions(client_sock, request);
-        } else if (strcmp(command, "CREATE_GROUP") == 0) {
-            handle_create_group(client_sock, request);
-        } else if (strcmp(command, "LIST_MY_GROUPS") == 0) {
-            handle_list_my_groups(client_sock, request);
-        } else if (strcmp(command, "LIST_GROUP_MEMBERS") == 0) {
-            handle_list_group_members(client_sock, request);
-        } else if (strcmp(command, "REQUEST_JOIN_GROUP") == 0) {
-            handle_request_join_group(client_sock, request);
-        } else if (strcmp(command, "LIST_JOIN_REQUESTS") == 0) {
-            handle_list_join_requests(client_sock, request);
-        } else if (strcmp(command, "APPROVE_JOIN_REQUEST") == 0) {
-            handle_approve_join_request(client_sock, request);
-        } else if (strcmp(command, "INVITE_TO_GROUP") == 0) {
-            handle_invite_to_group(client_sock, request);
-        } else if (strcmp(command, "LIST_MY_INVITATIONS") == 0) {
-            handle_list_my_invitations(client_sock, request);
-        } else if (strcmp(command, "RESPOND_INVITATION") == 0) {
-            handle_respond_invitation(client_sock, request);
-        } else if (strcmp(command, "LEAVE_GROUP") == 0) {
-            handle_leave_group(client_sock, request);
-        } else if (strcmp(command, "REMOVE_MEMBER") == 0) {
-            handle_remove_member(client_sock, request);
-        } else if (strcmp(command, "GET_NOTIFICATIONS") == 0) {
-            handle_get_notifications(client_sock, request);
-        } else if (strcmp(command, "MARK_NOTIFICATION_READ") == 0) {
-            handle_mark_notification_read(client_sock, request);
-        } else if (strcmp(command, "MARK_ALL_NOTIFICATIONS_READ") == 0) {
-            handle_mark_all_notifications_read(client_sock, request);
-        } else if (strcmp(command, "GET_UNREAD_COUNT") == 0) {
-            handle_get_unread_count(client_sock, request);
-        } 
-        else {
-            send_error_response(client_sock, STATUS_BAD_REQUEST, "ERROR_INVALID_COMMAND", "Unknown command");
-        }
-        
+    const CommandInfo *cmd = command_lookup(json_object_get_string(cmd_obj));
+    if (!cmd || !cmd->handler) return NULL;
+    return cmd;
+}
+
+static int has_session_token(struct json_object *request) {
+    struct json_object *data_obj, *token_obj;
+    return json_object_object_get_ex(request, "data", &data_obj) &&
+           json_object_object_get_ex(data_obj, "session_token", &token_obj) &&
+           json_object_is_type(token_obj, json_type_string);
+}
+
+// Routes one complete request to its handler. Runs on a worker thread;
+// the event loop keeps ownership of the socket.
+static void dispatch_request(int client_sock, const char *client_ip, struct json_object *request) {
+    printf("Received from %s: %s\n", client_ip, json_object_to_json_string(request));
+    
+    if (!json_object_object_get_ex(request, "command", NULL)) {
+        send_error_response(client_sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Missing command field");
         json_object_put(request);
+        return;
     }
     
-    close(client_sock);
-    printf("Client disconnected: %s\n", client_ip);
-    return NULL;
+    const CommandInfo *cmd = resolve_command(request);
+    if (!cmd) {
+        send_error_response(client_sock, STATUS_BAD_REQUEST, "ERROR_INVALID_COMMAND", "Unknown command");
+        json_object_put(request);
+        return;
+    }
+    
+    // Commands that need a session are refused before touching the database
+    if (cmd->auth == AUTH_SESSION && !has_session_token(request)) {
+        command_record_rejected(cmd->id);
+        send_error_response(client_sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Missing session_token");
+        json_object_put(request);
+        return;
+    }
+    
+    command_execute(cmd, client_sock, request);
+    
+    json_object_put(request);
+}
+
+static void process_request(int client_sock, const char *client_ip, struct json_object *request) {
+    int pipelined = net_request_is_pipelined(request);
+
+    set_request_context(request, client_ip);
+    dispatch_request(client_sock, client_ip, request);
+    set_request_context(NULL, NULL);
+    db_release_connection();
+
+    // A streaming handler finishes the request itself
+    if (!net_request_held()) net_request_done(client_sock, pipelined);
+}
+
+// Called by the event loop for each request; never blocks on handlers.
+static void queue_request(int client_sock, const char *client_ip, struct json_object *request) {
+    const CommandInfo *cmd = resolve_command(request);
+    int bulk = cmd && cmd->priority == PRIORITY_BULK;
+
+    if (worker_pool_submit(client_sock, client_ip, request, bulk) < 0) {
+        int pipelined = net_request_is_pipelined(request);
+        if (cmd) command_record_rejected(cmd->id);
+
+        set_request_context(request, client_ip);
+        send_error_response(client_sock, STATUS_SERVICE_UNAVAILABLE, "ERROR_SERVER_BUSY", "Server is overloaded, try again later");
+        set_request_context(NULL, NULL);
+
+        json_object_put(request);
+        net_request_done(client_sock, pipelined);
+    }
 }
 
 int main() {
-    int server_sock, *client_sock;
-    struct sockaddr_in server_addr, client_addr;
-    socklen_t client_len = sizeof(client_addr);
-    pthread_t thread_id;
+    int server_sock;
+    struct sockaddr_in server_addr;
     
     // Initialize database connection
     if (!init_database()) {
@@ -143,7 +131,7 @@ int main() {
     }
     
     // Listen
-    if (listen(server_sock, 10) < 0) {
+    if (listen(server_sock, SOMAXCONN) < 0) {
         perror("Listen failed");
         close(server_sock);
         return 1;
@@ -151,35 +139,33 @@ int main() {
     
     printf("Server listening on 172.18.38.233:%d\n", PORT);
     
-    // Accept connections
-    while (1) {
-        client_sock = malloc(sizeof(int));
-        *client_sock = accept(server_sock, (struct sockaddr *)&client_addr, &client_len);
-        
-        if (*client_sock < 0) {
-            perror("Accept failed");
-            free(client_sock);
-            continue;
-        }
-        
-        // Prepare client info
-        ClientInfo *client_info = malloc(sizeof(ClientInfo));
-        client_info->sock = *client_sock;
-        strncpy(client_info->ip, inet_ntoa(client_addr.sin_addr), 45);
-        client_info->ip[45] = '\0';
-        free(client_sock);
-        
-        printf("New client connected from %s:%d\n", 
-               client_info->ip, 
-               ntohs(client_addr.sin_port));
-        
-        if (pthread_create(&thread_id, NULL, handle_client, client_info) != 0) {
-            perror("Thread creation failed");
-            close(client_info->sock);
-            free(client_info);
-        }
-        
-        pthread_detach(thread_id);
+    command_table_init();
+    session_cache_init();
+    membership_cache_init();
+    name_cache_init();
+    unread_cache_init();
+    
+    // Also loads permissions, groups and users, once it is listening for changes
+    if (!notify_hub_init(db_conninfo())) {
+        fprintf(stderr, "Failed to start notification listener\n");
+        close(server_sock);
+        return 1;
+    }
+    
+    // Handlers run on a fixed pool of workers fed by the event loop. More
+    // workers than pooled connections would only queue up on the pool.
+    int num_workers = worker_pool_default_size();
+    if (num_workers > db_pool_size()) num_workers = db_pool_size();
+    
+    if (!worker_pool_init(num_workers, WORKER_QUEUE_CAPACITY, process_request)) {
+        fprintf(stderr, "Failed to start worker pool\n");
+        close(server_sock);
+        return 1;
+    }
+    
+    // Serve all clients from the event loop
+    if (event_loop_run(server_sock, queue_request) < 0) {
+        fprintf(stderr, "Event loop terminated\n");
     }
     
     close(server_sock);
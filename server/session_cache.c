@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "session_cache.h"
+
+#define SESSION_TOKEN_MAX 64
+#define SHARD_CAPACITY (SESSION_CACHE_CAPACITY / SESSION_CACHE_SHARDS)
+#define SHARD_BUCKETS 64    // Power of two
+
+typedef struct CacheEntry {
+    char token[SESSION_TOKEN_MAX + 1];
+    unsigned int hash;
+    int user_id;
+    char username[51];
+    char role[21];
+    time_t expires_at;              // sessions.expires_at
+    time_t valid_until;
+    struct CacheEntry *bucket_next;
+    struct CacheEntry *lru_prev;    // Towards the most recently used
+    struct CacheEntry *lru_next;
+} CacheEntry;
+
+// Each shard is an independent hash table with its own lock and LRU list,
+// so lookups for different tokens rarely contend. version is bumped by every
+// write so a verification that read the row before a logout cannot put the
+// session back.
+typedef struct {
+    pthread_mutex_t lock;
+    CacheEntry *buckets[SHARD_BUCKETS];
+    CacheEntry *lru_head;           // Most recently used
+    CacheEntry *lru_tail;           // Next to evict
+    int count;
+    unsigned long long version;
+} Shard;
+
+static Shard shards[SESSION_CACHE_SHARDS];
+static SessionCacheStats stats;     // Counters updated with atomic builtins
+
+static unsigned int hash_token(const char *token) {
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)token; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static Shard *shard_for(unsigned int hash) {
+    return &shards[hash % SESSION_CACHE_SHARDS];
+}
+
+static CacheEntry **bucket_for(Shard *shard, unsigned int hash) {
+    return &shard->buckets[(hash / SESSION_CACHE_SHARDS) & (SHARD_BUCKETS - 1)];
+}
+
+static void lru_unlink(Shard *shard, CacheEntry *entry) {
+    if (entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+    else shard->lru_head = entry->lru_next;
+    if (entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+    else shard->lru_tail = entry->lru_prev;
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void lru_push_front(Shard *shard, CacheEntry *entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = shard->lru_head;
+    if (shard->lru_head) shard->lru_head->lru_prev = entry;
+    shard->lru_head = entry;
+    if (!shard->lru_tail) shard->lru_tail = entry;
+}
+
+static CacheEntry *find_entry(Shard *shard, const char *token, unsigned int hash) {
+    for (CacheEntry *entry = *bucket_for(shard, hash); entry; entry = entry->bucket_next) {
+        if (entry->hash == hash && strcmp(entry->token, token) == 0) return entry;
+    }
+    return NULL;
+}
+
+// Unlinks and frees an entry. Caller holds the shard lock.
+static void remove_entry(Shard *shard, CacheEntry *entry) {
+    CacheEntry **link = bucket_for(shard, entry->hash);
+    while (*link != entry) link = &(*link)->bucket_next;
+    *link = entry->bucket_next;
+
+    lru_unlink(shard, entry);
+    shard->count--;
+    free(entry);
+}
+
+void session_cache_init() {
+    for (int i = 0; i < SESSION_CACHE_SHARDS; i++) {
+        pthread_mutex_init(&shards[i].lock, NULL);
+    }
+    memset(&stats, 0, sizeof(stats));
+    stats.capacity = SHARD_CAPACITY * SESSION_CACHE_SHARDS;
+}
+
+int session_cache_get(const char *token, UserInfo *out, time_t *expires_at, unsigned long long *version) {
+    *version = 0;
+    if (!token || strlen(token) > SESSION_TOKEN_MAX) return 0;
+
+    unsigned int hash = hash_token(token);
+    Shard *shard = shard_for(hash);
+    int hit = 0;
+
+    pthread_mutex_lock(&shard->lock);
+    CacheEntry *entry = find_entry(shard, token, hash);
+    if (entry && entry->valid_until <= time(NULL)) {
+        remove_entry(shard, entry);
+        entry = NULL;
+        __atomic_add_fetch(&stats.expired, 1, __ATOMIC_RELAXED);
+    }
+    if (entry) {
+        lru_unlink(shard, entry);
+        lru_push_front(shard, entry);
+
+        memset(out, 0, sizeof(*out));
+        out->user_id = entry->user_id;
+        strcpy(out->username, entry->username);
+        strcpy(out->role, entry->role);
+        if (expires_at) *expires_at = entry->expires_at;
+        hit = 1;
+    } else {
+        *version = shard->version;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    if (hit) __atomic_add_fetch(&stats.hits, 1, __ATOMIC_RELAXED);
+    else __atomic_add_fetch(&stats.misses, 1, __ATOMIC_RELAXED);
+    return hit;
+}
+
+// Inserts or refreshes an entry. Caller holds the shard lock.
+static void store_entry(Shard *shard, const char *token, unsigned int hash, const UserInfo *user,
+                        time_t expires_at, time_t valid_until) {
+    CacheEntry *entry = find_entry(shard, token, hash);
+    if (entry) {
+        lru_unlink(shard, entry);
+    } else {
+        if (shard->count >= SHARD_CAPACITY) {
+            remove_entry(shard, shard->lru_tail);
+            __atomic_add_fetch(&stats.evictions, 1, __ATOMIC_RELAXED);
+        }
+
+        entry = calloc(1, sizeof(CacheEntry));
+        if (!entry) return;
+        strcpy(entry->token, token);
+        entry->hash = hash;
+
+        CacheEntry **bucket = bucket_for(shard, hash);
+        entry->bucket_next = *bucket;
+        *bucket = entry;
+        shard->count++;
+    }
+
+    entry->user_id = user->user_id;
+    strncpy(entry->username, user->username, 50);
+    entry->username[50] = '\0';
+    strncpy(entry->role, user->role, 20);
+    entry->role[20] = '\0';
+    entry->expires_at = expires_at;
+    entry->valid_until = valid_until;
+    lru_push_front(shard, entry);
+}
+
+// How long a session may be cached, 0 if not at all
+static time_t cache_until(const char *token, time_t expires_at) {
+    if (!token || strlen(token) > SESSION_TOKEN_MAX) return 0;
+
+    time_t now = time(NULL);
+    time_t valid_until = now + SESSION_CACHE_TTL;
+    if (expires_at < valid_until) valid_until = expires_at;
+    return valid_until > now ? valid_until : 0;
+}
+
+void session_cache_fill(const char *token, const UserInfo *user, time_t expires_at, unsigned long long version) {
+    time_t valid_until = cache_until(token, expires_at);
+    if (!valid_until) return;
+
+    unsigned int hash = hash_token(token);
+    Shard *shard = shard_for(hash);
+
+    pthread_mutex_lock(&shard->lock);
+    if (shard->version == version) {
+        store_entry(shard, token, hash, user, expires_at, valid_until);
+    } else {
+        __atomic_add_fetch(&stats.stale_fills, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+void session_cache_put(const char *token, const UserInfo *user, time_t expires_at) {
+    time_t valid_until = cache_until(token, expires_at);
+    if (!valid_until) return;
+
+    unsigned int hash = hash_token(token);
+    Shard *shard = shard_for(hash);
+
+    pthread_mutex_lock(&shard->lock);
+    shard->version++;
+    store_entry(shard, token, hash, user, expires_at, valid_until);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+void session_cache_remove(const char *token) {
+    if (!token || strlen(token) > SESSION_TOKEN_MAX) return;
+
+    unsigned int hash = hash_token(token);
+    Shard *shard = shard_for(hash);
+
+    pthread_mutex_lock(&shard->lock);
+    shard->version++;
+    CacheEntry *entry = find_entry(shard, token, hash);
+    if (entry) {
+        remove_entry(shard, entry);
+        __atomic_add_fetch(&stats.invalidations, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+void session_cache_remove_user(int user_id) {
+    // Entries are keyed by token, so every shard has to be walked
+    for (int i = 0; i < SESSION_CACHE_SHARDS; i++) {
+        Shard *shard = &shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+        shard->version++;
+        CacheEntry *entry = shard->lru_head;
+        while (entry) {
+            CacheEntry *next = entry->lru_next;
+            if (entry->user_id == user_id) {
+                remove_entry(shard, entry);
+                __atomic_add_fetch(&stats.invalidations, 1, __ATOMIC_RELAXED);
+            }
+            entry = next;
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+void session_cache_clear() {
+    for (int i = 0; i < SESSION_CACHE_SHARDS; i++) {
+        Shard *shard = &shards[i];
+        pthread_mutex_lock(&shard->lock);
+        shard->version++;
+        while (shard->lru_head) remove_entry(shard, shard->lru_head);
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    __atomic_add_fetch(&stats.clears, 1, __ATOMIC_RELAXED);
+}
+
+void session_cache_get_stats(SessionCacheStats *out) {
+    out->size = 0;
+    for (int i = 0; i < SESSION_CACHE_SHARDS; i++) {
+        pthread_mutex_lock(&shards[i].lock);
+        out->size += shards[i].count;
+        pthread_mutex_unlock(&shards[i].lock);
+    }
+    out->capacity = stats.capacity;
+    out->hits = __atomic_load_n(&stats.hits, __ATOMIC_RELAXED);
+    out->misses = __atomic_load_n(&stats.misses, __ATOMIC_RELAXED);
+    out->expired = __atomic_load_n(&stats.expired, __ATOMIC_RELAXED);
+    out->evictions = __atomic_load_n(&stats.evictions, __ATOMIC_RELAXED);
+    out->invalidations = __atomic_load_n(&stats.invalidations, __ATOMIC_RELAXED);
+    out->stale_fills = __atomic_load_n(&stats.stale_fills, __ATOMIC_RELAXED);
+    out->clears = __atomic_load_n(&stats.clears, __ATOMIC_RELAXED);
+}
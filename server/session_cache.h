@@ -0,0 +1,51 @@
+#ifndef SESSION_CACHE_H
+#define SESSION_CACHE_H
+
+#include <time.h>
+#include "database.h"
+
+#define SESSION_CACHE_SHARDS 16
+#define SESSION_CACHE_CAPACITY 4096     // Entries across all shards
+#define SESSION_CACHE_TTL 60            // Seconds before an entry is re-checked against the database,
+                                        // a safety net behind the notifications other servers send
+
+typedef struct {
+    int size;
+    int capacity;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long expired;         // Found but past their TTL or expires_at
+    unsigned long long evictions;       // Dropped to make room (least recently used first)
+    unsigned long long invalidations;   // Removed by logout or password change, on any server
+    unsigned long long stale_fills;     // Loads dropped because a logout raced with them
+    unsigned long long clears;
+} SessionCacheStats;
+
+// Must run before the first lookup.
+void session_cache_init();
+
+// Copies the cached user for token into out and, if expires_at is not NULL,
+// the session's expiry into it. On a miss returns 0 and sets *version to the
+// value to pass to session_cache_fill() once the session has been verified
+// against the database.
+int session_cache_get(const char *token, UserInfo *out, time_t *expires_at, unsigned long long *version);
+
+// Remembers a session verified against the database until expires_at (the
+// sessions.expires_at of the row) or SESSION_CACHE_TTL from now, whichever
+// comes first, unless a removal in the same shard happened since
+// session_cache_get() handed out version.
+void session_cache_fill(const char *token, const UserInfo *user, time_t expires_at, unsigned long long version);
+
+// Write path: remembers a session the caller just created, with the same
+// lifetime as session_cache_fill()
+void session_cache_put(const char *token, const UserInfo *user, time_t expires_at);
+
+void session_cache_remove(const char *token);
+void session_cache_remove_user(int user_id);
+
+// Drops every entry, for when logouts may have gone unnoticed.
+void session_cache_clear();
+
+void session_cache_get_stats(SessionCacheStats *stats);
+
+#endif
@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <json-c/json.h>
+#include "stats_handler.h"
+#include "auth_handler.h"
+#include "database.h"
+#include "worker_pool.h"
+#include "command_table.h"
+#include "db_pool.h"
+#include "db_statements.h"
+#include "session_cache.h"
+#include "membership_cache.h"
+#include "name_cache.h"
+#include "unread_cache.h"
+#include "group_search.h"
+#include "user_search.h"
+#include "username_filter.h"
+#include "notify_hub.h"
+#include "permission_table.h"
+#include "qsbr.h"
+#include "../common/protocol.h"
+
+static struct json_object *worker_pool_stats_json() {
+    WorkerPoolStats stats;
+    worker_pool_get_stats(&stats);
+
+    struct json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "workers", json_object_new_int(stats.num_workers));
+    json_object_object_add(obj, "queue_capacity", json_object_new_int(stats.queue_capacity));
+    json_object_object_add(obj, "queue_depth", json_object_new_int(stats.queue_depth));
+    json_object_object_add(obj, "queue_high_water", json_object_new_int(stats.queue_high_water));
+    json_object_object_add(obj, "submitted", json_object_new_int64(stats.submitted));
+    json_object_object_add(obj, "rejected", json_object_new_int64(stats.rejected));
+    json_object_object_add(obj, "shed", json_object_new_int64(stats.shed));
+    json_object_object_add(obj, "completed", json_object_new_int64(stats.completed));
+    json_object_object_add(obj, "total_wait_us", json_object_new_int64(stats.total_wait_us));
+    json_object_object_add(obj, "max_wait_us", json_object_new_int64(stats.max_wait_us));
+    json_object_object_add(obj, "avg_wait_us", json_object_new_int64(
+        stats.completed ? stats.total_wait_us / stats.completed : 0));
+    return obj;
+}
+
+static struct json_object *db_pool_stats_json() {
+    DbPoolStats stats;
+    db_pool_get_stats(&stats);
+
+    struct json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "size", json_object_new_int(stats.size));
+    json_object_object_add(obj, "in_use", json_object_new_int(stats.in_use));
+    json_object_object_add(obj, "high_water", json_object_new_int(stats.high_water));
+    json_object_object_add(obj, "checkouts", json_object_new_int64(stats.checkouts));
+    json_object_object_add(obj, "waited", json_object_new_int64(stats.waited));
+    json_object_object_add(obj, "total_wait_us", json_object_new_int64(stats.total_wait_us));
+    json_object_object_add(obj, "max_wait_us", json_object_new_int64(stats.max_wait_us));
+    json_object_object_add(obj, "avg_wait_us", json_object_new_int64(
+        stats.checkouts ? stats.total_wait_us / stats.checkouts : 0));
+    json_object_object_add(obj, "health_checks", json_object_new_int64(stats.health_checks));
+    json_object_object_add(obj, "reconnects", json_object_new_int64(stats.reconnects));
+    json_object_object_add(obj, "failures", json_object_new_int64(stats.failures));
+    return obj;
+}
+
+// Per-command counters, only for commands that have seen traffic
+static struct json_object *command_stats_json() {
+    struct json_object *obj = json_object_new_object();
+
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        CommandStats stats;
+        command_get_stats((CommandId)i, &stats);
+        if (stats.calls == 0 && stats.rejected == 0) continue;
+
+        struct json_object *entry = json_object_new_object();
+        json_object_object_add(entry, "calls", json_object_new_int64(stats.calls));
+        json_object_object_add(entry, "rejected", json_object_new_int64(stats.rejected));
+        json_object_object_add(entry, "total_us", json_object_new_int64(stats.total_us));
+        json_object_object_add(entry, "max_us", json_object_new_int64(stats.max_us));
+        json_object_object_add(entry, "avg_us", json_object_new_int64(
+            stats.calls ? stats.total_us / stats.calls : 0));
+        json_object_object_add(obj, command_info((CommandId)i)->name, entry);
+    }
+    return obj;
+}
+
+static struct json_object *session_cache_stats_json() {
+    SessionCacheStats stats;
+    session_cache_get_stats(&stats);
+
+    struct json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "size", json_object_new_int(stats.size));
+    json_object_object_add(obj, "capacity", json_object_new_int(stats.capacity));
+    json_object_object_add(obj, "hits", json_object_new_int64(stats.hits));
+    json_object_object_add(obj, "misses", json_object_new_int64(stats.misses));
+    json_object_object_add(obj, "expired", json_object_new_int64(stats.expired));
+    json_object_object_add(obj, "evictions", json_object_new_int64(stats.evictions));
+    json_object_object_add(obj, "invalidations", json_object_new_int64(stats.invalidations));
+    json_object_object_add(obj, "stale_fills", json_object_new_int64(stats.stale_fills));
+    json_object_object_add(obj, "clears", json_object_new_int64(stats.clears));
+    return obj;
+}
+
+static struct json_object *membership_cache_stats_json() {
+    MembershipCacheStats stats;
+    membership_cache_get_stats(&stats);
+
+    struct json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "size", json_object_new_int(stats.size));
+    json_object_object_add(obj, "capacity", json_object_new_int(stats.capacity));
+    json_object_object_add(obj, "hits", json_object_new_int64(stats.hits));
+    json_object_object_add(obj, "misses", json_object_new_int64(stats.misses));
+    json_object_object_add(obj, "evictions", json_object_new_int64(stats.evictions));
+    json_object_object_add(obj, "invalidations", json_object_new_int64(stats.invalidations));
+    json_object_object_add(obj, "stale_fills", json_object_new_int64(stats.stale_fills));
+    json_object_object_add(obj, "clears", json_object_new_int64(stats.clears));
+    return obj;
+}
+
+static struct json_object *name_cache_stats_json() {
+    NameCacheStats stats;
+    name_cache_get_stats(&stats);
+
+    struct json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "size", json_object_new_int(stats.size));
+    json_object_object_add(obj, "capacity", json_object_new_int(stats.capacity));
+    json_object_object_add(obj, "hits", json_object_new_int64(stats.hits));
+    json_object_object_add(obj, "misses", json_object_new_int64(stats.misses));
+    json_object_object_add(obj, "evictions", json_object_new_int64(stats.evictions));
+    json_object_object_add(obj, "invalidations", json_object_new_int64(stats.invalidations));
+    json_object_object_add(obj, "stale_fills", json_object_new_int64(stats.stale_fills));
+    return obj;
+}
+
+static struct json_object *unread_cache_stats_json() {
+    UnreadCacheStats stats;
+    unread_cache_get_stats(&stats);
+
+    struct json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "size", json_object_new_int(stats.size));
+    json_object_object_add(obj, "capacity", json_object_new_int(stats.capacity));
+    json_object_object_add(obj, "hits", json_object_new_int64(stats.hits));
+    json_object_object_add(obj, "misses", json_object_new_int64(stats.misses));
+    json_object_object_add(obj, "evictions", json_object_new_int64(stats.evictions));
+    json_object_object_add(obj, "adjustments", json_object_new_int64(stats.adjustments));
+    json_object_object_add(obj, "invalidations", json_object_new_int64(stats.invalidations));
+    json_object_object_add(obj, "group_updates", json_object_new_int64(stats.group_updates));
+    json_object_object_add(obj, "clears", json_object_new_int64(stats.clears));
+    json_object_object_add(obj, "stale_fills", json_object_new_int64(stats.stale_fills));
+    return obj;
+}
+
+static struct json_object *group_search_stats_json() {
+    GroupSearchStats stats;
+    group_search_get_stats(&stats);
+
+    struct json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "groups", json_object_new_int(stats.groups));
+    json_object_object_add(obj, "stale", json_object_new_int(stats.stale));
+    json_object_object_add(obj, "compactions", json_object_new_int64(stats.compactions));
+    json_object_object_add(obj, "trigrams", json_object_new_int(stats.trigrams));
+    json_object_object_add(obj, "postings", json_object_new_int64(stats.postings));
+    json_object_object_add(obj, "searches", json_object_new_int64(stats.searches));
+    json_object_object_add(obj, "scans", json_object_new_int64(stats.scans));
+    return obj;
+}
+
+static struct json_object *user_search_stats_json() {
+    UserSearchStats stats;
+    user_search_get_stats(&stats);
+
+    struct json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "users", json_object_new_int(stats.users));
+    json_object_object_add(obj, "entries", json_object_new_int64(stats.entries));
+    json_object_object_add(obj, "pending", json_object_new_int(stats.pending));
+    json_object_object_add(obj, "stale", json_object_new_int64(stats.stale));
+    json_object_object_add(obj, "merges", json_object_new_int64(stats.merges));
+    json_object_object_add(obj, "searches", json_object_new_int64(stats.searches));
+    return obj;
+}
+
+static struct json_object *username_filter_stats_json() {
+    UsernameFilterStats stats;
+    username_filter_get_stats(&stats);
+
+    struct json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "stages", json_object_new_int(stats.stages));
+    json_object_object_add(obj, "names", json_object_new_int64(stats.names));
+    json_object_object_add(obj, "bytes", json_object_new_int64(stats.bytes));
+    json_object_object_add(obj, "complete", json_object_new_boolean(stats.complete));
+    json_object_object_add(obj, "checks", json_object_new_int64(stats.checks));
+    json_object_object_add(obj, "rejects", json_object_new_int64(stats.rejects));
+    return obj;
+}
+
+static struct json_object *notify_hub_stats_json() {
+    NotifyHubStats stats;
+    notify_hub_get_stats(&stats);
+
+    struct json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "subscribers", json_object_new_int(stats.subscribers));
+    json_object_object_add(obj, "listening", json_object_new_boolean(stats.listening));
+    json_object_object_add(obj, "received", json_object_new_int64(stats.received));
+    json_object_object_add(obj, "pushed", json_object_new_int64(stats.pushed));
+    json_object_object_add(obj, "bad_payloads", json_object_new_int64(stats.bad_payloads));
+    json_object_object_add(obj, "reconnects", json_object_new_int64(stats.reconnects));
+    return obj;
+}
+
+static struct json_object *permission_table_stats_json() {
+    PermissionTableStats stats;
+    permission_table_get_stats(&stats);
+    QsbrStats reclaim;
+    qsbr_get_stats(&reclaim);
+
+    struct json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "size", json_object_new_int(stats.size));
+    json_object_object_add(obj, "capacity", json_object_new_int(stats.capacity));
+    json_object_object_add(obj, "version", json_object_new_int64(stats.version));
+    json_object_object_add(obj, "reader_threads", json_object_new_int(reclaim.threads));
+    json_object_object_add(obj, "retired", json_object_new_int64(reclaim.retired));
+    json_object_object_add(obj, "reclaimed", json_object_new_int64(reclaim.reclaimed));
+    json_object_object_add(obj, "pending_reclaim", json_object_new_int(reclaim.pending));
+    return obj;
+}
+
+// Prepared statement cache, only for statements that have run
+static struct json_object *statement_stats_json() {
+    struct json_object *obj = json_object_new_object();
+
+    for (int i = 0; i < STMT_COUNT; i++) {
+        DbStatementStats stats;
+        db_statement_get_stats((DbStatement)i, &stats);
+        if (stats.hits == 0 && stats.misses == 0) continue;
+
+        struct json_object *entry = json_object_new_object();
+        json_object_object_add(entry, "hits", json_object_new_int64(stats.hits));
+        json_object_object_add(entry, "misses", json_object_new_int64(stats.misses));
+        json_object_object_add(entry, "failures", json_object_new_int64(stats.failures));
+        json_object_object_add(obj, db_statement_name((DbStatement)i), entry);
+    }
+    return obj;
+}
+
+void handle_get_server_stats(int sock, struct json_object *request) {
+    struct json_object *data_obj, *field;
+    
+    if (!json_object_object_get_ex(request, "data", &data_obj)) {
+        send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Missing data field");
+        return;
+    }
+    
+    const char *session_token = NULL;
+    
+    if (json_object_object_get_ex(data_obj, "session_token", &field))
+        session_token = json_object_get_string(field);
+    
+    if (!session_token) {
+        send_error_response(sock, STATUS_BAD_REQUEST, "ERROR_INVALID_REQUEST", "Missing session_token");
+        return;
+    }
+    
+    // Verify session
+    UserInfo *user = db_verify_session(session_token);
+    if (!user) {
+        send_error_response(sock, STATUS_UNAUTHORIZED, "ERROR_UNAUTHORIZED", "Invalid session token or session expired");
+        return;
+    }
+    
+    // Server counters are for operators only
+    if (strcmp(user->role, "admin") != 0) {
+        free(user);
+        send_error_response(sock, STATUS_FORBIDDEN, "ERROR_FORBIDDEN", "Only administrators can view server stats");
+        return;
+    }
+    
+    struct json_object *response = json_object_new_object();
+    json_object_object_add(response, "status", json_object_new_int(STATUS_OK));
+    json_object_object_add(response, "code", json_object_new_string("SUCCESS_GET_SERVER_STATS"));
+    json_object_object_add(response, "message", json_object_new_string("Server stats retrieved"));
+    
+    struct json_object *payload = json_object_new_object();
+    json_object_object_add(payload, "worker_pool", worker_pool_stats_json());
+    json_object_object_add(payload, "db_pool", db_pool_stats_json());
+    json_object_object_add(payload, "session_cache", session_cache_stats_json());
+    json_object_object_add(payload, "membership_cache", membership_cache_stats_json());
+    json_object_object_add(payload, "name_cache", name_cache_stats_json());
+    json_object_object_add(payload, "permission_table", permission_table_stats_json());
+    json_object_object_add(payload, "unread_cache", unread_cache_stats_json());
+    json_object_object_add(payload, "group_search", group_search_stats_json());
+    json_object_object_add(payload, "user_search", user_search_stats_json());
+    json_object_object_add(payload, "username_filter", username_filter_stats_json());
+    json_object_object_add(payload, "notifications", notify_hub_stats_json());
+    json_object_object_add(payload, "commands", command_stats_json());
+    json_object_object_add(payload, "statements", statement_stats_json());
+    json_object_object_add(response, "payload", payload);
+    
+    send_json_response(sock, response);
+    
+    free(user);
+    json_object_put(response);
+}
@@ -0,0 +1,8 @@
+#ifndef STATS_HANDLER_H
+#define STATS_HANDLER_H
+
+#include <json-c/json.h>
+
+void handle_get_server_stats(int sock, struct json_object *request);
+
+#endif
@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "unread_cache.h"
+
+#define SHARD_CAPACITY (UNREAD_CACHE_CAPACITY / UNREAD_CACHE_SHARDS)
+#define SHARD_BUCKETS 256   // Power of two
+
+typedef struct CacheEntry {
+    int user_id;
+    unsigned int hash;
+    int personal;
+    int group_count;
+    UnreadGroup *groups;            // last_seq is the value read with the cursor
+    time_t valid_until;
+    struct CacheEntry *bucket_next;
+    struct CacheEntry *lru_prev;    // Towards the most recently used
+    struct CacheEntry *lru_next;
+} CacheEntry;
+
+// Same layout as the membership cache: independent shards, each with its own
+// lock, hash table and LRU list. version is bumped by every write so a count
+// loaded before the write cannot overwrite the adjusted one. Group seqs are
+// not versioned: they only ever rise, so the larger value is always right.
+typedef struct {
+    pthread_mutex_t lock;
+    CacheEntry *buckets[SHARD_BUCKETS];
+    CacheEntry *lru_head;           // Most recently used
+    CacheEntry *lru_tail;           // Next to evict
+    int count;
+    unsigned long long version;
+} Shard;
+
+static Shard shards[UNREAD_CACHE_SHARDS];
+static UnreadCacheStats stats;      // Counters updated with atomic builtins
+
+// Newest seq per group, direct mapped: group_id in the high half, seq in the
+// low half, 0 when empty. A slot taken over by another group just makes the
+// counts of the first group's members miss and reload.
+static unsigned long long group_seqs[UNREAD_GROUP_SLOTS];
+
+static unsigned long long *group_slot(int group_id) {
+    unsigned int key = (unsigned int)group_id * 0x9e3779b1U;
+    return &group_seqs[(key >> 16) & (UNREAD_GROUP_SLOTS - 1)];
+}
+
+// Returns 0 if the slot no longer holds group_id
+static int group_seq_get(int group_id, int *seq) {
+    unsigned long long value = __atomic_load_n(group_slot(group_id), __ATOMIC_ACQUIRE);
+    if ((int)(value >> 32) != group_id) return 0;
+    *seq = (int)(unsigned int)value;
+    return 1;
+}
+
+// Raises the seq kept for group_id. With take_over, a slot holding another
+// group is given to this one; without, only an empty slot is. Fills must not
+// take over: what they read may predate a notification whose seq was in the
+// slot before another group displaced it.
+static void group_seq_raise(int group_id, int seq, int take_over) {
+    unsigned long long *slot = group_slot(group_id);
+    unsigned long long next = ((unsigned long long)(unsigned int)group_id << 32) | (unsigned int)seq;
+    unsigned long long value = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    do {
+        if ((int)(value >> 32) == group_id) {
+            if ((int)(unsigned int)value >= seq) return;
+        } else if (value != 0 && !take_over) {
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(slot, &value, next, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+}
+
+// Personal count plus every group's notifications past the user's cursor.
+// Returns -1 if the seq of one of the groups is no longer kept.
+static int entry_count(const CacheEntry *entry) {
+    int count = entry->personal;
+    for (int i = 0; i < entry->group_count; i++) {
+        const UnreadGroup *group = &entry->groups[i];
+        int seq;
+        if (!group_seq_get(group->group_id, &seq)) return -1;
+        if (seq < group->last_seq) seq = group->last_seq;
+        if (seq > group->last_read_seq) count += seq - group->last_read_seq;
+    }
+    return count;
+}
+
+static unsigned int hash_key(int user_id) {
+    unsigned int key = (unsigned int)user_id;
+    key ^= key >> 16;
+    key *= 0x45d9f3bU;
+    key ^= key >> 16;
+    return key;
+}
+
+static Shard *shard_for(unsigned int hash) {
+    return &shards[hash % UNREAD_CACHE_SHARDS];
+}
+
+static CacheEntry **bucket_for(Shard *shard, unsigned int hash) {
+    return &shard->buckets[(hash / UNREAD_CACHE_SHARDS) & (SHARD_BUCKETS - 1)];
+}
+
+static void lru_unlink(Shard *shard, CacheEntry *entry) {
+    if (entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+    else shard->lru_head = entry->lru_next;
+    if (entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+    else shard->lru_tail = entry->lru_prev;
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void lru_push_front(Shard *shard, CacheEntry *entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = shard->lru_head;
+    if (shard->lru_head) shard->lru_head->lru_prev = entry;
+    shard->lru_head = entry;
+    if (!shard->lru_tail) shard->lru_tail = entry;
+}
+
+static CacheEntry *find_entry(Shard *shard, int user_id, unsigned int hash) {
+    for (CacheEntry *entry = *bucket_for(shard, hash); entry; entry = entry->bucket_next) {
+        if (entry->user_id == user_id) return entry;
+    }
+    return NULL;
+}
+
+// Unlinks and frees an entry. Caller holds the shard lock.
+static void remove_entry(Shard *shard, CacheEntry *entry) {
+    CacheEntry **link = bucket_for(shard, entry->hash);
+    while (*link != entry) link = &(*link)->bucket_next;
+    *link = entry->bucket_next;
+
+    lru_unlink(shard, entry);
+    shard->count--;
+    free(entry->groups);
+    free(entry);
+}
+
+// Inserts or refreshes an entry. Caller holds the shard lock.
+static void store_entry(Shard *shard, int user_id, unsigned int hash, int personal,
+                        const UnreadGroup *groups, int group_count) {
+    UnreadGroup *copy = NULL;
+    if (group_count > 0) {
+        copy = malloc(group_count * sizeof(UnreadGroup));
+        if (!copy) return;
+        memcpy(copy, groups, group_count * sizeof(UnreadGroup));
+    }
+
+    CacheEntry *entry = find_entry(shard, user_id, hash);
+    if (entry) {
+        lru_unlink(shard, entry);
+    } else {
+        if (shard->count >= SHARD_CAPACITY) {
+            remove_entry(shard, shard->lru_tail);
+            __atomic_add_fetch(&stats.evictions, 1, __ATOMIC_RELAXED);
+        }
+
+        entry = calloc(1, sizeof(CacheEntry));
+        if (!entry) {
+            free(copy);
+            return;
+        }
+        entry->user_id = user_id;
+        entry->hash = hash;
+
+        CacheEntry **bucket = bucket_for(shard, hash);
+        entry->bucket_next = *bucket;
+        *bucket = entry;
+        shard->count++;
+    }
+
+    free(entry->groups);
+    entry->personal = personal;
+    entry->groups = copy;
+    entry->group_count = group_count;
+    entry->valid_until = time(NULL) + UNREAD_CACHE_TTL;
+    lru_push_front(shard, entry);
+}
+
+void unread_cache_init() {
+    for (int i = 0; i < UNREAD_CACHE_SHARDS; i++) {
+        pthread_mutex_init(&shards[i].lock, NULL);
+    }
+    memset(&stats, 0, sizeof(stats));
+    memset(group_seqs, 0, sizeof(group_seqs));
+    stats.capacity = SHARD_CAPACITY * UNREAD_CACHE_SHARDS;
+}
+
+int unread_cache_get(int user_id, int *count, unsigned long long *version) {
+    unsigned int hash = hash_key(user_id);
+    Shard *shard = shard_for(hash);
+    int hit = 0;
+
+    pthread_mutex_lock(&shard->lock);
+    CacheEntry *entry = find_entry(shard, user_id, hash);
+    int total = entry ? entry_count(entry) : -1;
+    if (entry && (total < 0 || entry->valid_until <= time(NULL))) {
+        remove_entry(shard, entry);
+        entry = NULL;
+    }
+    if (entry) {
+        lru_unlink(shard, entry);
+        lru_push_front(shard, entry);
+        *count = total;
+        hit = 1;
+    } else {
+        *version = shard->version;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    if (hit) __atomic_add_fetch(&stats.hits, 1, __ATOMIC_RELAXED);
+    else __atomic_add_fetch(&stats.misses, 1, __ATOMIC_RELAXED);
+    return hit;
+}
+
+void unread_cache_fill(int user_id, int personal, const UnreadGroup *groups, int group_count,
+                       unsigned long long version) {
+    unsigned int hash = hash_key(user_id);
+    Shard *shard = shard_for(hash);
+
+    pthread_mutex_lock(&shard->lock);
+    if (shard->version == version) {
+        for (int i = 0; i < group_count; i++) {
+            group_seq_raise(groups[i].group_id, groups[i].last_seq, 0);
+        }
+        store_entry(shard, user_id, hash, personal, groups, group_count);
+    } else {
+        __atomic_add_fetch(&stats.stale_fills, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+void unread_cache_add(int user_id, int delta) {
+    unsigned int hash = hash_key(user_id);
+    Shard *shard = shard_for(hash);
+
+    pthread_mutex_lock(&shard->lock);
+    shard->version++;
+    CacheEntry *entry = find_entry(shard, user_id, hash);
+    if (entry) {
+        entry->personal += delta;
+        if (entry->personal < 0) entry->personal = 0;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    __atomic_add_fetch(&stats.adjustments, 1, __ATOMIC_RELAXED);
+}
+
+void unread_cache_invalidate(int user_id) {
+    unsigned int hash = hash_key(user_id);
+    Shard *shard = shard_for(hash);
+
+    pthread_mutex_lock(&shard->lock);
+    shard->version++;
+    CacheEntry *entry = find_entry(shard, user_id, hash);
+    if (entry) remove_entry(shard, entry);
+    pthread_mutex_unlock(&shard->lock);
+
+    __atomic_add_fetch(&stats.invalidations, 1, __ATOMIC_RELAXED);
+}
+
+void unread_cache_group_seq(int group_id, int seq) {
+    group_seq_raise(group_id, seq, 1);
+    __atomic_add_fetch(&stats.group_updates, 1, __ATOMIC_RELAXED);
+}
+
+void unread_cache_clear() {
+    for (int i = 0; i < UNREAD_CACHE_SHARDS; i++) {
+        Shard *shard = &shards[i];
+        pthread_mutex_lock(&shard->lock);
+        shard->version++;
+        while (shard->lru_head) remove_entry(shard, shard->lru_head);
+        pthread_mutex_unlock(&shard->lock);
+    }
+    // After the versions moved on, so no fill from before the clear puts a
+    // seq back
+    for (int i = 0; i < UNREAD_GROUP_SLOTS; i++) {
+        __atomic_store_n(&group_seqs[i], 0, __ATOMIC_RELEASE);
+    }
+
+    __atomic_add_fetch(&stats.clears, 1, __ATOMIC_RELAXED);
+}
+
+void unread_cache_get_stats(UnreadCacheStats *out) {
+    out->size = 0;
+    for (int i = 0; i < UNREAD_CACHE_SHARDS; i++) {
+        pthread_mutex_lock(&shards[i].lock);
+        out->size += shards[i].count;
+        pthread_mutex_unlock(&shards[i].lock);
+    }
+    out->capacity = stats.capacity;
+    out->hits = __atomic_load_n(&stats.hits, __ATOMIC_RELAXED);
+    out->misses = __atomic_load_n(&stats.misses, __ATOMIC_RELAXED);
+    out->evictions = __atomic_load_n(&stats.evictions, __ATOMIC_RELAXED);
+    out->adjustments = __atomic_load_n(&stats.adjustments, __ATOMIC_RELAXED);
+    out->invalidations = __atomic_load_n(&stats.invalidations, __ATOMIC_RELAXED);
+    out->group_updates = __atomic_load_n(&stats.group_updates, __ATOMIC_RELAXED);
+    out->clears = __atomic_load_n(&stats.clears, __ATOMIC_RELAXED);
+    out->stale_fills = __atomic_load_n(&stats.stale_fills, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,64 @@
+#ifndef UNREAD_CACHE_H
+#define UNREAD_CACHE_H
+
+#define UNREAD_CACHE_SHARDS 16
+#define UNREAD_CACHE_CAPACITY 16384         // Entries across all shards
+#define UNREAD_CACHE_TTL 30                 // Seconds, bounds staleness from reads marked by other servers
+#define UNREAD_GROUP_SLOTS 65536            // Newest seq per group, power of two
+
+// One group the user is an approved member of, as read with the count
+typedef struct {
+    int group_id;
+    int last_read_seq;
+    int last_seq;
+} UnreadGroup;
+
+typedef struct {
+    int size;
+    int capacity;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+    unsigned long long adjustments;     // Cached counts moved by a known delta
+    unsigned long long invalidations;
+    unsigned long long group_updates;   // Newest seq of a group raised by a group notification
+    unsigned long long clears;
+    unsigned long long stale_fills;     // Loads dropped because a write raced with them
+} UnreadCacheStats;
+
+// Must run before the first lookup.
+void unread_cache_init();
+
+// A user's count is kept in two parts: the personal unread count with the
+// read cursor of each of the user's groups, cached per user, and the newest
+// seq of each group, kept per group. A group notification only raises the
+// group's seq, so it needs no list of the group's members; the count is
+// summed on lookup.
+
+// Returns 1 and sets *count on a hit. On a miss, *version is set to the value
+// to pass to unread_cache_fill() once the count has been read from the
+// database.
+int unread_cache_get(int user_id, int *count, unsigned long long *version);
+
+// Caches the personal count and group cursors loaded from the database,
+// unless a write to the same shard happened since unread_cache_get() handed
+// out version.
+void unread_cache_fill(int user_id, int personal, const UnreadGroup *groups, int group_count,
+                       unsigned long long version);
+
+// Moves a cached personal count by delta. Users without an entry are left
+// alone: their next read loads the count the database already has.
+void unread_cache_add(int user_id, int delta);
+
+// A group notification numbered seq was created in group_id.
+void unread_cache_group_seq(int group_id, int seq);
+
+void unread_cache_invalidate(int user_id);
+
+// Drops every entry, for changes whose recipients cannot be looked up or when
+// notification events may have been missed.
+void unread_cache_clear();
+
+void unread_cache_get_stats(UnreadCacheStats *stats);
+
+#endif
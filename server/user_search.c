@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "user_search.h"
+
+#define MAX_PREFIX 256
+#define PENDING_MIN 4096            // Keys added before they are merged into the sorted array
+#define PENDING_SHARE 32            // ... or 1/32 of the sorted array, whichever is larger
+
+// Everything known about one user, in a single allocation. Blocks are never
+// modified: a profile edit publishes a new one and keys pointing at the old
+// block are dropped at the next merge.
+typedef struct {
+    int user_id;
+    unsigned short full_name;           // Offsets into text; the username starts at 0
+    unsigned short username_folded;     // Lower-cased copies share the original when it has no upper case
+    unsigned short full_name_folded;
+    unsigned char words;
+    unsigned char word_start[USER_SEARCH_MAX_WORDS];   // Offsets into the folded full name
+    char text[];
+} UserBlock;
+
+// One searchable string: the folded username (key 0) or the folded full
+// name from its key-th word on
+typedef struct {
+    const UserBlock *block;
+    int key;
+} Entry;
+
+static pthread_rwlock_t index_lock = PTHREAD_RWLOCK_INITIALIZER;
+static UserBlock **users = NULL;    // By user_id
+static int users_capacity = 0;
+static int user_count = 0;
+static Entry *sorted = NULL;
+static int sorted_count = 0;
+static int sorted_capacity = 0;
+static Entry *pending = NULL;       // Sorted too, small enough to insert into
+static int pending_count = 0;
+static int pending_capacity = 0;
+static UserBlock **retired = NULL;  // Replaced blocks still referenced by keys
+static int retired_count = 0;
+static int retired_capacity = 0;
+static long long stale_count = 0;
+static int built = 0;
+static UserSearchStats stats;       // merges under the write lock, searches with atomic builtins
+
+static const char *entry_text(const Entry *entry) {
+    const UserBlock *block = entry->block;
+    if (entry->key == 0) return block->text + block->username_folded;
+    return block->text + block->full_name_folded + block->word_start[entry->key - 1];
+}
+
+static int entry_live(const Entry *entry) {
+    return users[entry->block->user_id] == entry->block;
+}
+
+// Orders by text, then user_id, then key
+static int compare_entries(const Entry *a, const Entry *b) {
+    int c = strcmp(entry_text(a), entry_text(b));
+    if (c != 0) return c;
+    if (a->block->user_id != b->block->user_id) return a->block->user_id < b->block->user_id ? -1 : 1;
+    return a->key - b->key;
+}
+
+static int compare_entries_qsort(const void *a, const void *b) {
+    return compare_entries((const Entry *)a, (const Entry *)b);
+}
+
+static int has_upper(const char *text) {
+    for (; *text; text++) {
+        if (isupper((unsigned char)*text)) return 1;
+    }
+    return 0;
+}
+
+static size_t append_folded(char *dest, const char *text, size_t len) {
+    for (size_t i = 0; i < len; i++) dest[i] = (char)tolower((unsigned char)text[i]);
+    dest[len] = '\0';
+    return len + 1;
+}
+
+// Usernames and full names are cut to their column widths
+static UserBlock *make_block(int user_id, const char *username, const char *full_name) {
+    if (!username) username = "";
+    if (!full_name) full_name = "";
+    size_t username_len = strnlen(username, 50);
+    size_t full_name_len = strnlen(full_name, 100);
+    int fold_username = has_upper(username);
+    int fold_full_name = has_upper(full_name);
+
+    size_t text_len = username_len + 1 + full_name_len + 1;
+    if (fold_username) text_len += username_len + 1;
+    if (fold_full_name) text_len += full_name_len + 1;
+
+    UserBlock *block = malloc(sizeof(UserBlock) + text_len);
+    if (!block) return NULL;
+    block->user_id = user_id;
+
+    size_t offset = 0;
+    memcpy(block->text, username, username_len);
+    block->text[username_len] = '\0';
+    offset += username_len + 1;
+    block->full_name = (unsigned short)offset;
+    memcpy(block->text + offset, full_name, full_name_len);
+    block->text[offset + full_name_len] = '\0';
+    offset += full_name_len + 1;
+
+    block->username_folded = 0;
+    if (fold_username) {
+        block->username_folded = (unsigned short)offset;
+        offset += append_folded(block->text + offset, username, username_len);
+    }
+    block->full_name_folded = block->full_name;
+    if (fold_full_name) {
+        block->full_name_folded = (unsigned short)offset;
+        offset += append_folded(block->text + offset, full_name, full_name_len);
+    }
+
+    const char *name = block->text + block->full_name_folded;
+    block->words = 0;
+    for (size_t i = 0; name[i] && block->words < USER_SEARCH_MAX_WORDS; i++) {
+        if (!isspace((unsigned char)name[i]) && (i == 0 || isspace((unsigned char)name[i - 1]))) {
+            block->word_start[block->words++] = (unsigned char)i;
+        }
+    }
+    return block;
+}
+
+static int reserve(void **array, int *capacity, int needed, size_t size, int minimum) {
+    if (needed <= *capacity) return 1;
+    int new_capacity = *capacity ? *capacity : minimum;
+    while (new_capacity < needed) new_capacity *= 2;
+    void *grown = realloc(*array, (size_t)new_capacity * size);
+    if (!grown) return 0;
+    *array = grown;
+    *capacity = new_capacity;
+    return 1;
+}
+
+// Folds pending into sorted, dropping stale keys, then frees retired
+// blocks. Caller holds the write lock.
+static int merge_pending() {
+    long long live = (long long)sorted_count + pending_count - stale_count;
+    Entry *merged = malloc((size_t)(live > 0 ? live : 1) * sizeof(Entry));
+    if (!merged) return 0;
+
+    int i = 0, j = 0, count = 0;
+    while (i < sorted_count || j < pending_count) {
+        const Entry *next;
+        if (j == pending_count || (i < sorted_count && compare_entries(&sorted[i], &pending[j]) < 0)) {
+            next = &sorted[i++];
+        } else {
+            next = &pending[j++];
+        }
+        if (entry_live(next)) merged[count++] = *next;
+    }
+
+    free(sorted);
+    sorted = merged;
+    sorted_count = count;
+    sorted_capacity = (int)(live > 0 ? live : 1);
+    pending_count = 0;
+    for (int k = 0; k < retired_count; k++) free(retired[k]);
+    retired_count = 0;
+    stale_count = 0;
+    stats.merges++;
+    return 1;
+}
+
+static void insert_pending(Entry entry) {
+    int lo = 0, hi = pending_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (compare_entries(&pending[mid], &entry) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    memmove(&pending[lo + 1], &pending[lo], (size_t)(pending_count - lo) * sizeof(Entry));
+    pending[lo] = entry;
+    pending_count++;
+}
+
+// Publishes block as the user's current one. Caller holds the write lock.
+static void publish(UserBlock *block) {
+    int user_id = block->user_id;
+    int keys = 1 + block->words;
+
+    if (user_id >= users_capacity) {
+        int old_capacity = users_capacity;
+        if (!reserve((void **)&users, &users_capacity, user_id + 1, sizeof(UserBlock *), 1024)) {
+            free(block);
+            return;
+        }
+        memset(users + old_capacity, 0, (size_t)(users_capacity - old_capacity) * sizeof(UserBlock *));
+    }
+
+    // Registrations also arrive back through NOTIFY; keep the current block
+    UserBlock *current = users[user_id];
+    if (current && strcmp(current->text, block->text) == 0 &&
+        strcmp(current->text + current->full_name, block->text + block->full_name) == 0) {
+        free(block);
+        return;
+    }
+
+    Entry **target = built ? &pending : &sorted;
+    int *target_count = built ? &pending_count : &sorted_count;
+    int *target_capacity = built ? &pending_capacity : &sorted_capacity;
+
+    if (built) {
+        int limit = sorted_count / PENDING_SHARE > PENDING_MIN ? sorted_count / PENDING_SHARE : PENDING_MIN;
+        if (pending_count + keys > limit) merge_pending();
+    }
+    if (!reserve((void **)target, target_capacity, *target_count + keys, sizeof(Entry), 1024) ||
+        !reserve((void **)&retired, &retired_capacity, retired_count + 1, sizeof(UserBlock *), 64)) {
+        free(block);
+        return;
+    }
+
+    UserBlock *old = users[user_id];
+    if (old) {
+        retired[retired_count++] = old;
+        stale_count += 1 + old->words;
+    } else {
+        user_count++;
+    }
+    users[user_id] = block;
+
+    for (int key = 0; key < keys; key++) {
+        Entry entry = { block, key };
+        if (built) insert_pending(entry);
+        else sorted[sorted_count++] = entry;
+    }
+}
+
+void user_search_add(int user_id, const char *username, const char *full_name) {
+    if (user_id <= 0) return;
+    UserBlock *block = make_block(user_id, username, full_name);
+    if (!block) return;
+
+    pthread_rwlock_wrlock(&index_lock);
+    publish(block);
+    pthread_rwlock_unlock(&index_lock);
+}
+
+void user_search_update_full_name(int user_id, const char *full_name) {
+    if (user_id <= 0) return;
+
+    // The username comes from the current block, so build under the lock
+    pthread_rwlock_wrlock(&index_lock);
+    // The writer's server hears of its own edit again from the NOTIFY
+    if (user_id < users_capacity && users[user_id] &&
+        strncmp(users[user_id]->text + users[user_id]->full_name, full_name ? full_name : "", 100) != 0) {
+        UserBlock *block = make_block(user_id, users[user_id]->text, full_name);
+        if (block) publish(block);
+    }
+    pthread_rwlock_unlock(&index_lock);
+}
+
+void user_search_build() {
+    pthread_rwlock_wrlock(&index_lock);
+    if (built) {
+        pthread_rwlock_unlock(&index_lock);
+        return;
+    }
+    qsort(sorted, sorted_count, sizeof(Entry), compare_entries_qsort);
+    built = 1;
+    if (stale_count > 0) merge_pending();
+    pthread_rwlock_unlock(&index_lock);
+}
+
+// True for keys before the place a search starts: under the prefix, or not
+// past the cursor
+static int before_start(const Entry *entry, const char *prefix, const Entry *after) {
+    if (strcmp(entry_text(entry), prefix) < 0) return 1;
+    return after && compare_entries(entry, after) <= 0;
+}
+
+static int lower_bound(const Entry *array, int count, const char *prefix, const Entry *after) {
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (before_start(&array[mid], prefix, after)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// A user is reported once, at the first of their keys that matches
+static int first_match(const Entry *entry, const char *prefix, size_t prefix_len) {
+    const char *text = entry_text(entry);
+    for (int key = 0; key <= entry->block->words; key++) {
+        if (key == entry->key) continue;
+        Entry other = { entry->block, key };
+        const char *other_text = entry_text(&other);
+        if (strncmp(other_text, prefix, prefix_len) != 0) continue;
+        int c = strcmp(other_text, text);
+        if (c < 0 || (c == 0 && key < entry->key)) return 0;
+    }
+    return 1;
+}
+
+int user_search_query(const char *prefix, const UserSearchCursor *after, int limit,
+                      UserSearchResult *results, int *has_more) {
+    *has_more = 0;
+
+    char folded[MAX_PREFIX];
+    size_t prefix_len = strlen(prefix);
+    if (prefix_len == 0 || prefix_len >= sizeof(folded) || limit <= 0) return 0;
+    append_folded(folded, prefix, prefix_len);
+
+    __atomic_add_fetch(&stats.searches, 1, __ATOMIC_RELAXED);
+    pthread_rwlock_rdlock(&index_lock);
+
+    Entry cursor;
+    if (after) {
+        // The cursor's text is whatever its key says now
+        const UserBlock *block = after->user_id > 0 && after->user_id < users_capacity ? users[after->user_id] : NULL;
+        if (!built || !block || after->key < 0 || after->key > block->words) {
+            pthread_rwlock_unlock(&index_lock);
+            return 0;
+        }
+        cursor.block = block;
+        cursor.key = after->key;
+    }
+    const Entry *bound = after ? &cursor : NULL;
+
+    int count = 0;
+    int i = built ? lower_bound(sorted, sorted_count, folded, bound) : sorted_count;
+    int j = lower_bound(pending, pending_count, folded, bound);
+    while (1) {
+        int sorted_ok = i < sorted_count && strncmp(entry_text(&sorted[i]), folded, prefix_len) == 0;
+        int pending_ok = j < pending_count && strncmp(entry_text(&pending[j]), folded, prefix_len) == 0;
+        if (!sorted_ok && !pending_ok) break;
+
+        const Entry *entry;
+        if (!pending_ok || (sorted_ok && compare_entries(&sorted[i], &pending[j]) < 0)) {
+            entry = &sorted[i++];
+        } else {
+            entry = &pending[j++];
+        }
+        if (!entry_live(entry) || !first_match(entry, folded, prefix_len)) continue;
+
+        // One extra match tells whether there is more
+        if (count == limit) {
+            *has_more = 1;
+            break;
+        }
+        const UserBlock *block = entry->block;
+        results[count].user_id = block->user_id;
+        results[count].key = entry->key;
+        snprintf(results[count].username, sizeof(results[count].username), "%s", block->text);
+        snprintf(results[count].full_name, sizeof(results[count].full_name), "%s", block->text + block->full_name);
+        count++;
+    }
+
+    pthread_rwlock_unlock(&index_lock);
+    return count;
+}
+
+void user_search_get_stats(UserSearchStats *out) {
+    pthread_rwlock_rdlock(&index_lock);
+    out->users = user_count;
+    out->entries = (long long)sorted_count + pending_count;
+    out->pending = pending_count;
+    out->stale = stale_count;
+    out->merges = stats.merges;
+    pthread_rwlock_unlock(&index_lock);
+    out->searches = __atomic_load_n(&stats.searches, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,55 @@
+#ifndef USER_SEARCH_H
+#define USER_SEARCH_H
+
+#define USER_SEARCH_PAGE_DEFAULT 10
+#define USER_SEARCH_PAGE_MAX 50
+#define USER_SEARCH_MAX_WORDS 4     // Full-name words a user can be found by
+
+typedef struct {
+    int user_id;
+    int key;                        // 0 matched the username, n the n-th full-name word
+    char username[51];
+    char full_name[101];
+} UserSearchResult;
+
+// Results are ordered by the matched text, then user_id. A cursor names the
+// last result returned; the text is looked up again from the index.
+typedef struct {
+    int user_id;
+    int key;
+} UserSearchCursor;
+
+typedef struct {
+    int users;
+    long long entries;              // Sorted keys, live or not
+    int pending;                    // Keys added since the last merge
+    long long stale;                // Keys left behind by profile edits
+    unsigned long long merges;
+    unsigned long long searches;
+} UserSearchStats;
+
+// In-memory prefix index over usernames and full-name words. Matching is
+// case-insensitive for ASCII and byte-wise otherwise. Safe to use from any
+// thread.
+
+// Adds a user, or replaces everything known about one. Adding a user again
+// unchanged costs nothing.
+void user_search_add(int user_id, const char *username, const char *full_name);
+
+// Replaces the full name of a user already in the index, unless it is unchanged
+void user_search_update_full_name(int user_id, const char *full_name);
+
+// Sorts users added so far in one pass. Call after the startup load; until
+// then additions are only appended and searches find nothing. Later calls
+// do nothing.
+void user_search_build();
+
+// Fills results with up to limit users whose username or a full-name word
+// starts with prefix, after the cursor (or from the top when after is NULL).
+// *has_more says whether more follow. Returns the count.
+int user_search_query(const char *prefix, const UserSearchCursor *after, int limit,
+                      UserSearchResult *results, int *has_more);
+
+void user_search_get_stats(UserSearchStats *stats);
+
+#endif
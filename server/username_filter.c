@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "username_filter.h"
+
+#define MAX_STAGES 24
+#define FIRST_HASHES 8          // Probes per name in the first stage, one more each stage after
+
+typedef struct {
+    unsigned long long *bits;
+    unsigned long long bit_mask;    // Bit count minus one, a power of two
+    int hashes;
+    long long capacity;
+    long long count;
+} Stage;
+
+// Stages are only appended and never freed. Readers load stage_count with
+// acquire ordering and probe bits without a lock; writers serialize on
+// add_lock and set bits atomically.
+static pthread_mutex_t add_lock = PTHREAD_MUTEX_INITIALIZER;
+static Stage stages[MAX_STAGES];
+static int stage_count = 0;
+static long long total_bytes = 0;
+static int complete = 0;
+static UsernameFilterStats stats;   // checks and rejects updated with atomic builtins
+
+// FNV-1a with a 64-bit finalizer; the two halves drive double hashing
+static unsigned long long hash_name(const char *name) {
+    unsigned long long hash = 14695981039346656037ull;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ull;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static unsigned long long probe(unsigned long long hash, int i, unsigned long long mask) {
+    unsigned long long h1 = hash & 0xffffffffull;
+    unsigned long long h2 = (hash >> 32) | 1;
+    return (h1 + (unsigned long long)i * h2 * 0x9e3779b97f4a7c15ull) & mask;
+}
+
+static int stage_has(const Stage *stage, unsigned long long hash) {
+    for (int i = 0; i < stage->hashes; i++) {
+        unsigned long long bit = probe(hash, i, stage->bit_mask);
+        if (!(__atomic_load_n(&stage->bits[bit / 64], __ATOMIC_RELAXED) & (1ull << (bit % 64)))) return 0;
+    }
+    return 1;
+}
+
+// Caller holds add_lock
+static Stage *writable_stage() {
+    if (stage_count > 0 && stages[stage_count - 1].count < stages[stage_count - 1].capacity) {
+        return &stages[stage_count - 1];
+    }
+    if (stage_count == MAX_STAGES) return &stages[stage_count - 1];     // Overfill the last one
+
+    Stage *stage = &stages[stage_count];
+    stage->capacity = stage_count ? stages[stage_count - 1].capacity * 2 : USERNAME_FILTER_FIRST_CAPACITY;
+    stage->hashes = FIRST_HASHES + stage_count;
+    unsigned long long bit_count = (unsigned long long)stage->capacity * USERNAME_FILTER_BITS_PER_NAME;
+    stage->bits = calloc(bit_count / 64, sizeof(unsigned long long));
+    if (!stage->bits) {
+        fprintf(stderr, "Username filter cannot grow past %d stages\n", stage_count);
+        return stage_count ? &stages[stage_count - 1] : NULL;
+    }
+    stage->bit_mask = bit_count - 1;
+    stage->count = 0;
+    total_bytes += bit_count / 8;
+    __atomic_store_n(&stage_count, stage_count + 1, __ATOMIC_RELEASE);
+    return stage;
+}
+
+void username_filter_add(const char *username) {
+    if (!username) return;
+    unsigned long long hash = hash_name(username);
+
+    pthread_mutex_lock(&add_lock);
+    // A name the filter already answers yes for gains nothing from another
+    // copy, and skipping it keeps rescans from using up stage capacity
+    for (int s = 0; s < stage_count; s++) {
+        if (stage_has(&stages[s], hash)) {
+            pthread_mutex_unlock(&add_lock);
+            return;
+        }
+    }
+    Stage *stage = writable_stage();
+    if (stage) {
+        for (int i = 0; i < stage->hashes; i++) {
+            unsigned long long bit = probe(hash, i, stage->bit_mask);
+            __atomic_fetch_or(&stage->bits[bit / 64], 1ull << (bit % 64), __ATOMIC_RELAXED);
+        }
+        stage->count++;
+        stats.names++;
+    }
+    pthread_mutex_unlock(&add_lock);
+}
+
+int username_filter_may_exist(const char *username) {
+    if (!username) return 0;
+    __atomic_add_fetch(&stats.checks, 1, __ATOMIC_RELAXED);
+    if (!__atomic_load_n(&complete, __ATOMIC_ACQUIRE)) return 1;
+
+    unsigned long long hash = hash_name(username);
+    int count = __atomic_load_n(&stage_count, __ATOMIC_ACQUIRE);
+    for (int s = 0; s < count; s++) {
+        if (stage_has(&stages[s], hash)) return 1;
+    }
+    __atomic_add_fetch(&stats.rejects, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+void username_filter_set_complete(int value) {
+    __atomic_store_n(&complete, value ? 1 : 0, __ATOMIC_RELEASE);
+}
+
+void username_filter_get_stats(UsernameFilterStats *out) {
+    pthread_mutex_lock(&add_lock);
+    out->stages = stage_count;
+    out->names = stats.names;
+    out->bytes = total_bytes;
+    pthread_mutex_unlock(&add_lock);
+    out->complete = __atomic_load_n(&complete, __ATOMIC_ACQUIRE);
+    out->checks = __atomic_load_n(&stats.checks, __ATOMIC_RELAXED);
+    out->rejects = __atomic_load_n(&stats.rejects, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,33 @@
+#ifndef USERNAME_FILTER_H
+#define USERNAME_FILTER_H
+
+#define USERNAME_FILTER_FIRST_CAPACITY 65536   // Usernames the first stage is sized for
+#define USERNAME_FILTER_BITS_PER_NAME 16
+
+typedef struct {
+    int stages;
+    long long names;                // Additions the filter did not already answer yes for
+    long long bytes;
+    int complete;                   // Negative answers are trusted
+    unsigned long long checks;
+    unsigned long long rejects;     // Checks answered "does not exist"
+} UsernameFilterStats;
+
+// Bloom filter over every registered username, so lookups of names that were
+// never registered skip Postgres. It grows by adding a stage twice the size
+// of the last and never forgets a name. Safe to use from any thread.
+
+void username_filter_add(const char *username);
+
+// 0 means no user has this username. 1 means one may, including whenever the
+// filter is not complete.
+int username_filter_may_exist(const char *username);
+
+// The filter only knows names it was given. It is complete while every
+// registration, on any server process, reaches username_filter_add: after
+// the startup load and while the notification listener is up.
+void username_filter_set_complete(int complete);
+
+void username_filter_get_stats(UsernameFilterStats *stats);
+
+#endif
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <json-c/json.h>
+#include "worker_pool.h"
+#include "qsbr.h"
+
+// A request for the handler, or a task when task is set
+typedef struct {
+    int sock;
+    char client_ip[46];
+    struct json_object *request;
+    void (*task)(void *arg);
+    void *task_arg;
+    unsigned long long enqueued_us;
+} Job;
+
+// Bounded ring buffer shared by the network thread (and workers re-submitting
+// pipelined requests) on one side and the handler threads on the other.
+static Job *queue = NULL;
+static int queue_capacity = 0;
+static int queue_head = 0;
+static int queue_count = 0;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_not_empty = PTHREAD_COND_INITIALIZER;
+
+static RequestHandler job_handler = NULL;
+static WorkerPoolStats stats;
+
+static unsigned long long now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void *worker_main(void *arg) {
+    (void)arg;
+
+    // Handlers read QSBR-protected snapshots (permission_table.h). A worker is
+    // quiescent between jobs and offline while it waits for one.
+    qsbr_register_thread();
+
+    while (1) {
+        pthread_mutex_lock(&queue_lock);
+        if (queue_count == 0) {
+            qsbr_thread_offline();
+            while (queue_count == 0) {
+                pthread_cond_wait(&queue_not_empty, &queue_lock);
+            }
+            qsbr_thread_online();
+        }
+
+        Job job = queue[queue_head];
+        queue_head = (queue_head + 1) % queue_capacity;
+        queue_count--;
+
+        unsigned long long waited = now_us() - job.enqueued_us;
+        stats.total_wait_us += waited;
+        if (waited > stats.max_wait_us) stats.max_wait_us = waited;
+        pthread_mutex_unlock(&queue_lock);
+
+        if (job.task) job.task(job.task_arg);
+        else job_handler(job.sock, job.client_ip, job.request);
+
+        pthread_mutex_lock(&queue_lock);
+        stats.completed++;
+        pthread_mutex_unlock(&queue_lock);
+
+        qsbr_quiescent();
+    }
+
+    return NULL;
+}
+
+int worker_pool_default_size() {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 2) cores = 2;
+    return (int)cores;
+}
+
+int worker_pool_init(int num_workers, int capacity, RequestHandler handler) {
+    queue = calloc(capacity, sizeof(Job));
+    if (!queue) return 0;
+
+    queue_capacity = capacity;
+    job_handler = handler;
+    memset(&stats, 0, sizeof(stats));
+    stats.num_workers = num_workers;
+    stats.queue_capacity = capacity;
+
+    for (int i = 0; i < num_workers; i++) {
+        pthread_t thread_id;
+        if (pthread_create(&thread_id, NULL, worker_main, NULL) != 0) {
+            perror("Worker thread creation failed");
+            return 0;
+        }
+        pthread_detach(thread_id);
+    }
+
+    printf("Started %d worker threads (queue capacity %d)\n", num_workers, capacity);
+    return 1;
+}
+
+int worker_pool_submit(int sock, const char *client_ip, struct json_object *request, int bulk) {
+    pthread_mutex_lock(&queue_lock);
+
+    if (queue_count == queue_capacity) {
+        stats.rejected++;
+        pthread_mutex_unlock(&queue_lock);
+        return -1;
+    }
+    if (bulk && queue_count >= queue_capacity - queue_capacity / 4) {
+        stats.shed++;
+        pthread_mutex_unlock(&queue_lock);
+        return -1;
+    }
+
+    Job *job = &queue[(queue_head + queue_count) % queue_capacity];
+    job->sock = sock;
+    strncpy(job->client_ip, client_ip, 45);
+    job->client_ip[45] = '\0';
+    job->request = request;
+    job->task = NULL;
+    job->task_arg = NULL;
+    job->enqueued_us = now_us();
+
+    queue_count++;
+    stats.submitted++;
+    if (queue_count > stats.queue_high_water) stats.queue_high_water = queue_count;
+
+    pthread_cond_signal(&queue_not_empty);
+    pthread_mutex_unlock(&queue_lock);
+    return 0;
+}
+
+int worker_pool_submit_task(void (*fn)(void *arg), void *arg) {
+    pthread_mutex_lock(&queue_lock);
+
+    if (queue_count == queue_capacity) {
+        stats.rejected++;
+        pthread_mutex_unlock(&queue_lock);
+        return -1;
+    }
+
+    Job *job = &queue[(queue_head + queue_count) % queue_capacity];
+    job->sock = -1;
+    job->client_ip[0] = '\0';
+    job->request = NULL;
+    job->task = fn;
+    job->task_arg = arg;
+    job->enqueued_us = now_us();
+
+    queue_count++;
+    stats.submitted++;
+    if (queue_count > stats.queue_high_water) stats.queue_high_water = queue_count;
+
+    pthread_cond_signal(&queue_not_empty);
+    pthread_mutex_unlock(&queue_lock);
+    return 0;
+}
+
+void worker_pool_get_stats(WorkerPoolStats *out) {
+    pthread_mutex_lock(&queue_lock);
+    *out = stats;
+    out->queue_depth = queue_count;
+    pthread_mutex_unlock(&queue_lock);
+}
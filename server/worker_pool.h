@@ -0,0 +1,40 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <json-c/json.h>
+#include "event_loop.h"
+
+#define WORKER_QUEUE_CAPACITY 1024
+
+typedef struct {
+    int num_workers;
+    int queue_capacity;
+    int queue_depth;                // Jobs waiting right now
+    int queue_high_water;           // Deepest the queue has been
+    unsigned long long submitted;
+    unsigned long long rejected;    // Refused because the queue was full
+    unsigned long long shed;        // Bulk jobs refused to keep headroom for interactive ones
+    unsigned long long completed;
+    unsigned long long total_wait_us;
+    unsigned long long max_wait_us;
+} WorkerPoolStats;
+
+// Starts num_workers threads that pull requests from a bounded queue and run
+// handler on them.
+int worker_pool_init(int num_workers, int queue_capacity, RequestHandler handler);
+
+// Queues a request for the workers. Returns -1 without taking ownership of
+// request when the queue is full. Bulk requests are already refused once the
+// queue is three quarters full so interactive ones keep some headroom.
+int worker_pool_submit(int sock, const char *client_ip, struct json_object *request, int bulk);
+
+// Queues fn(arg) for the workers, e.g. the next part of a streamed response.
+// Returns -1 when the queue is full.
+int worker_pool_submit_task(void (*fn)(void *arg), void *arg);
+
+void worker_pool_get_stats(WorkerPoolStats *stats);
+
+// Number of handler threads suited to this machine.
+int worker_pool_default_size();
+
+#endif